@@ -44,10 +44,26 @@ enum FX_ERRORS
    FX_SoundCardError,
    FX_InvalidCard,
    FX_MultiVocError,
+   FX_JournalError,
    };
 
 #define FX_MUSIC_PRIORITY	0x7fffffffl
 
+enum FX_RESAMPLERS
+   {
+   FX_ResampleNearest,
+   FX_ResampleLinear,
+   FX_ResampleCubic,
+   FX_ResampleSinc
+   };
+
+enum FX_PROFILING
+   {
+   FX_ProfileOff,
+   FX_ProfileByCallback,
+   FX_ProfileBySound
+   };
+
 
 const char *FX_ErrorString( int ErrorNumber );
 int   FX_Init( int SoundCard, int numvoices, int * numchannels, int * samplebits, int * mixrate, void * initdata );
@@ -70,7 +86,34 @@ int FX_VoiceAvailable( int priority );
 int FX_EndLooping( int handle );
 int FX_SetPan( int handle, int vol, int left, int right );
 int FX_SetPitch( int handle, int pitchoffset );
+int FX_SetVoiceResampler( int handle, int resampler );
+int FX_SetDefaultResampler( int resampler );
+int FX_GetDefaultResampler( void );
 int FX_SetFrequency( int handle, int frequency );
+int FX_SetMixRateDivisor( int divisor );
+int FX_GetMixRateDivisor( void );
+int FX_SetVoiceLOD( int threshold, int divisor );
+int FX_GetVoiceLOD( void );
+unsigned int FX_GetMixedFrames( void );
+void FX_GetStats( ASS_MixStats *stats );
+void FX_ResetStats( void );
+void FX_GetLevels( ASS_OutputLevels *levels );
+void FX_ResetLevels( void );
+void FX_GetLatency( ASS_StartLatency *latency );
+void FX_ResetLatency( void );
+int FX_GetRecentStarts( ASS_VoiceStart *starts, int count );
+void FX_GetMemoryUsage( ASS_MemoryUsage *usage );
+void FX_SetMemoryBudget( unsigned int bytes );
+void FX_ResetMemoryPeaks( void );
+int FX_SetVoiceProfiling( int mode );
+int FX_GetVoiceProfiling( void );
+int FX_GetVoiceProfile( ASS_VoiceProfile *top, int count );
+void FX_StartTrace( void );
+void FX_StopTrace( void );
+void FX_TraceMark( const char *name );
+int FX_WriteTrace( const char *filename );
+int FX_StartJournal( const char *filename );
+void FX_StopJournal( void );
 
 int FX_PlayVOC( char *ptr, unsigned int ptrlength, int pitchoffset, int vol, int left, int right,
        int priority, unsigned int callbackval );
@@ -94,6 +137,38 @@ int FX_PlayLoopedAuto( char *ptr, unsigned int ptrlength, int loopstart, int loo
                       unsigned int callbackval );
 int FX_PlayAuto3D( char *ptr, unsigned int ptrlength, int pitchoffset, int angle, int distance,
                   int priority, unsigned int callbackval );
+int FX_PlayLoopedVorbisFrom( char *ptr, unsigned int ptrlength, int startpos,
+                  int loopstart, int loopend, int pitchoffset, int vol, int left, int right,
+                  int priority, unsigned int callbackval );
+int FX_SetVorbisPosition( int handle, int position );
+int FX_PlayFile( const char *filename, int pitchoffset, int vol, int left, int right,
+                int priority, unsigned int callbackval );
+int FX_PlayLoopedFile( const char *filename, int loopstart, int loopend,
+                      int pitchoffset, int vol, int left, int right, int priority,
+                      unsigned int callbackval );
+
+int FX_OpenSoundBank( const char *filename );
+int FX_CloseSoundBank( int bank );
+int FX_SoundBankEntries( int bank );
+int FX_PlayBankSound( int bank, int entry, int pitchoffset, int vol, int left, int right,
+                     int priority, unsigned int callbackval );
+int FX_PlayLoopedBankSound( int bank, int entry, int pitchoffset, int vol, int left,
+                           int right, int priority, unsigned int callbackval );
+int FX_PlayBankSound3D( int bank, int entry, int pitchoffset, int angle, int distance,
+                       int priority, unsigned int callbackval );
+void FX_SetSoundResampling( unsigned int maxbytes );
+unsigned int FX_GetResampledMemory( void );
+void FX_SetSoundTranscoding( unsigned int threshold );
+int FX_SoundIsTranscoded( int id );
+unsigned int FX_GetTranscodeSavings( void );
+int FX_RegisterSound( char *ptr, unsigned int ptrlength );
+int FX_UnregisterSound( int id );
+int FX_PlayID( int id, int pitchoffset, int vol, int left, int right, int priority,
+              unsigned int callbackval );
+int FX_PlayLoopedID( int id, int loopstart, int loopend, int pitchoffset, int vol,
+                    int left, int right, int priority, unsigned int callbackval );
+int FX_PlayID3D( int id, int pitchoffset, int angle, int distance, int priority,
+                unsigned int callbackval );
 
 int FX_PlayRaw( char *ptr, unsigned int length, unsigned rate,
        int pitchoffset, int vol, int left, int right, int priority,
@@ -112,6 +187,7 @@ int FX_StartDemandFeedPlayback( void ( *function )( char **ptr, unsigned int *le
        int priority, unsigned int callbackval );
 int  FX_StartRecording( int MixRate, void ( *function )( char *ptr, int length ) );
 void FX_StopRecord( void );
+int  FX_Render( void *buffer, int frames, int numchannels, int samplebits );
 
 #ifdef HAVE_TIMIDITY
 extern int timidity_status;
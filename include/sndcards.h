@@ -42,8 +42,125 @@ typedef enum
    ASS_WinMM,
    ASS_FluidSynth,
    ASS_ALSA,
+   ASS_FileSink,
    ASS_NumSoundCards,
 	ASS_AutoDetect = -2
    } soundcardnames;
 
+// Pass as the initdata for ASS_FileSink, or NULL to discard the output
+// as fast as it mixes. It must stay valid until the driver shuts down.
+typedef struct
+   {
+   const char *filename;   // WAV file to write, or NULL to discard
+   int         realtime;   // nonzero paces mixing to the wall clock
+   volatile unsigned int frames;   // set by the driver: frames produced
+   } ASS_FileSinkOptions;
+
+// Mixer statistics from FX_GetStats, gathered since playback started or
+// the last FX_ResetStats. Times are in microseconds per mixed block.
+typedef struct
+   {
+   unsigned int blocks;         // blocks mixed
+   unsigned int mintime;
+   unsigned int avgtime;
+   unsigned int maxtime;
+   unsigned int p99time;        // to within a quarter octave
+   unsigned int late;           // blocks asked for more than the whole ring behind
+   int          voicesmixed;    // voices mixed into the last block
+   int          voicespaused;   // voices paused in the last block
+   int          peakvoices;     // most voices mixed into one block
+   unsigned int voicesstolen;   // voices killed for higher priority sounds
+   unsigned int refills[ 8 ];   // GetSound calls while mixing, by sound type:
+                                // raw, VOC, demand feed, WAV, Vorbis,
+                                // Timidity, stream
+   } ASS_MixStats;
+
+// One line of FX_GetVoiceProfile: what mixing cost the voices sharing a
+// key, which is their callback value or registered sound ID depending on
+// the profiling mode. Times are in microseconds over the window.
+typedef struct
+   {
+   unsigned int key;
+   int          wavetype;       // type of the last voice, ordered as refills
+   int          bits;
+   int          channels;
+   unsigned int rate;           // last step through the source, 16.16
+   unsigned int voiceblocks;    // times a voice was mixed into a block
+   unsigned int mixtime;        // in the mixing kernels and resamplers
+   unsigned int refilltime;     // fetching and decoding sound in GetSound
+   } ASS_VoiceProfile;
+
+// Output levels from FX_GetLevels, on a 16-bit scale whatever the mix
+// format. Mono output is reported in both channels. Clipped samples are
+// those sitting at full scale.
+typedef struct
+   {
+   unsigned int blocks;         // blocks metered since the reset
+   int          peak[ 2 ];      // left and right in the last block
+   int          rms[ 2 ];
+   unsigned int clipped;
+   int          maxpeak[ 2 ];   // since the reset
+   int          avgrms[ 2 ];
+   unsigned int totalclipped;
+   unsigned int clippedblocks;  // blocks with any clipped samples
+   } ASS_OutputLevels;
+
+// Voice start latency from FX_GetLatency, gathered since playback started
+// or the last FX_ResetLatency. Times are in microseconds from the play
+// call, to the voice first being mixed and to that block being handed to
+// the driver; buffering inside the driver or device comes on top.
+typedef struct
+   {
+   unsigned int starts;         // voices whose first block has gone out
+   unsigned int dropped;        // starts too many at once to be timed
+   unsigned int minmixed;
+   unsigned int avgmixed;
+   unsigned int p50mixed;       // to within a quarter octave
+   unsigned int p99mixed;
+   unsigned int maxmixed;
+   unsigned int minout;
+   unsigned int avgout;
+   unsigned int p50out;
+   unsigned int p99out;
+   unsigned int maxout;
+   } ASS_StartLatency;
+
+// One voice start from FX_GetRecentStarts
+typedef struct
+   {
+   int          handle;
+   unsigned int calltime;       // microsecond clock at the play call
+   unsigned int callframe;      // FX_GetMixedFrames() at the play call
+   unsigned int frame;          // output frame its first sample landed on
+   unsigned int mixed;          // microseconds from the call to being mixed
+   unsigned int out;            // and to being handed to the driver
+   } ASS_VoiceStart;
+
+// What the library's heap memory is held for, in FX_GetMemoryUsage
+enum ASS_MEMORY
+   {
+   ASS_MemMixer,          // MV_Init's block: voices, mix buffers, tables
+   ASS_MemVolumeTables,   // the static volume lookup tables
+   ASS_MemVorbis,         // Vorbis decoders and seek indexes
+   ASS_MemSounds,         // registered sounds, conversions, ADPCM data
+   ASS_MemStreams,        // streamed files and sound banks
+   ASS_MemTimidity,       // Timidity output blocks
+   ASS_MemMIDI,           // MIDI song tracks and device buffers
+   ASS_MemOther,          // threads, mutexes, mapped files, the journal
+   ASS_NumMemCategories
+   };
+
+// Bytes held by category from FX_GetMemoryUsage, now and at most since
+// the library started or the peaks were reset. The volume tables are
+// static, so they are counted but never charged to the budget.
+typedef struct
+   {
+   unsigned int current[ ASS_NumMemCategories ];
+   unsigned int peak[ ASS_NumMemCategories ];
+   unsigned int total;
+   unsigned int totalpeak;
+   unsigned int budget;          // 0 for none
+   unsigned int refused;         // allocations failed for the budget
+   } ASS_MemoryUsage;
+
 #endif
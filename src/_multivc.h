@@ -31,6 +31,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #ifndef ___MULTIVC_H
 #define ___MULTIVC_H
 
+#include <stdint.h>
+
 #define TRUE  ( 1 == 1 )
 #define FALSE ( !TRUE )
 
@@ -65,6 +67,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
    ( ( max( 0, min( ( volume ), 255 ) ) * ( MV_MaxVolume + 1 ) ) >> 8 )
 //   ( ( max( 0, min( ( volume ), 255 ) ) ) >> 2 )
 
+// Source frames played per mixed frame, in 32.32 fixed point
+#define RATE_SCALE( rate, pitchscale ) \
+   ( ( ( uint64_t )( rate ) * ( pitchscale ) << 16 ) / MV_MixRate )
+
 #define STEREO      1
 #define SIXTEEN_BIT 2
 
@@ -85,6 +91,11 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #define MixBufferSize     256
 
+// Source frames the interpolating resamplers read either side of the
+// current one, at most
+#define MV_ResampleHistory   7
+#define MV_ResampleAhead     4
+
 #define NumberOfBuffers   16
 #define TotalBufferSize   ( MixBufferSize * NumberOfBuffers )
 
@@ -97,7 +108,8 @@ typedef enum
    DemandFeed,
    WAV,
    Vorbis,
-   Timidity
+   Timidity,
+   Stream
    } wavedata;
 
 typedef enum
@@ -106,6 +118,71 @@ typedef enum
    KeepPlaying
    } playbackstatus;
 
+// Frames of 16-bit stereo PCM each voice can decode compressed data into
+#define MV_DecodeFrames     1024
+#define MV_DecodeBufferSize ( MV_DecodeFrames * STEREO_16BIT_SAMPLE_SIZE )
+
+#define MV_MaxADPCMCoefs    16
+
+#define WAVE_FORMAT_ADPCM     0x0002
+#define WAVE_FORMAT_IMA_ADPCM 0x0011
+
+enum
+   {
+   DecodePCM,
+   DecodeIMA,
+   DecodeMS,
+   DecodeCT4,           // Creative 8-bit ADPCM, in VOC pack type order
+   DecodeCT3,
+   DecodeCT2,
+   DecodeCT16,          // Creative 16-bit 4:1 ADPCM
+   DecodeALaw,
+   DecodeMuLaw
+   };
+
+typedef struct
+   {
+   int            format;
+   unsigned int   rate;
+   int            channels;
+   char          *data;          // first compressed block
+   unsigned int   numblocks;
+   unsigned int   blockalign;    // bytes per compressed block
+   unsigned int   blockframes;   // frames per whole block
+   unsigned int   lastblockframes;
+   unsigned int   totalframes;
+   unsigned int   loopstart;
+   unsigned int   loopend;
+   int            looping;
+
+   unsigned int   frame;         // frames decoded so far
+   unsigned int   skip;          // decoded frames to drop after a seek
+   unsigned int   block;         // index of the current block
+   unsigned int   blockframe;    // frames decoded from the current block
+   unsigned char *in;            // next compressed byte
+   unsigned int   remaining;     // compressed bytes left in a VOC block
+   int            reference;     // VOC reference frame still to output
+   int            nibble;
+
+   int            sample1[ 2 ];
+   int            sample2[ 2 ];
+   int            step[ 2 ];
+   int            coef1[ 2 ];
+   int            coef2[ 2 ];
+   int            numcoefs;
+   short          coefs[ MV_MaxADPCMCoefs ][ 2 ];
+
+   char          *buffer;        // MV_DecodeBufferSize bytes of decoded PCM
+   } DecodeState;
+
+
+typedef void ( *MIXFUNC )( unsigned int position, unsigned int rate,
+   char *start, unsigned int length );
+
+typedef struct
+   {
+   int frames[ 2 ][ 3 ];   // last frames of the previous block, per channel
+   } UpsampleState;
 
 typedef struct VoiceNode
    {
@@ -129,13 +206,12 @@ typedef struct VoiceNode
    unsigned int  BlockLength;
 
    unsigned int  PitchScale;
-   unsigned int  FixedPointBufferSize;
 
    char         *sound;
-   unsigned int  length;
+   uint64_t      length;        // 32.32 fixed point, like position
    unsigned int  SamplingRate;
-   unsigned int  RateScale;
-   unsigned int  position;
+   uint64_t      RateScale;
+   uint64_t      position;
    int           Playing;
    int           Paused;
 
@@ -150,6 +226,22 @@ typedef struct VoiceNode
 
    unsigned int  callbackval;
 
+   DecodeState   decode;
+
+   int           resampler;
+   MIXFUNC       mixresampled;  // 16-bit source mixer fed by the resampler
+   uint64_t      carry;         // how far the resampler reads back into history
+   short         history[ MV_ResampleHistory * 2 ];   // end of the last block
+   int           historychannels;   // channels in history, 0 when it is empty
+
+   int           gain;          // louder of the left and right volumes
+
+   int           soundid;       // registered sound playing, or -1
+
+   unsigned int  calltime;      // when the play call was made
+   unsigned int  callframe;     // MV_MixedFrames then
+   int           timing;        // start latency still to be taken
+
    } VoiceNode;
 
 typedef struct
@@ -220,6 +312,7 @@ typedef MONO16 VOLUME16[ 256 ];
 extern Pan MV_PanTable[ MV_NumPanPositions ][ 63 + 1 ];
 extern int MV_ErrorCode;
 extern int MV_Installed;
+extern int MV_Rendering;      // mixing is being pulled by MV_Render
 extern int MV_MaxVolume;
 extern int MV_MixRate;
 typedef char HARSH_CLIP_TABLE_8[ MV_NumVoices * 256 ];
@@ -227,14 +320,66 @@ typedef char HARSH_CLIP_TABLE_8[ MV_NumVoices * 256 ];
 #define MV_SetErrorCode( status ) \
    MV_ErrorCode   = ( status );
 
+#ifdef _MSC_VER
+#define inline _inline
+#endif
+
+// Little-endian fields of file headers, whatever the host byte order
+static inline unsigned int read_le16( const unsigned char *p )
+   {
+   return p[ 0 ] | ( p[ 1 ] << 8 );
+   }
+
+static inline unsigned int read_le32( const unsigned char *p )
+   {
+   return p[ 0 ] | ( p[ 1 ] << 8 ) | ( p[ 2 ] << 16 ) | ( ( unsigned int )p[ 3 ] << 24 );
+   }
+
+void MV_Lock( void );
+void MV_Unlock( void );
+
 void MV_PlayVoice( VoiceNode *voice );
 
+VoiceNode *MV_GetVoice( int handle );
+
 VoiceNode *MV_AllocVoice( int priority );
 
 void MV_SetVoiceMixMode( VoiceNode *voice );
 void MV_SetVoiceVolume ( VoiceNode *voice, int vol, int left, int right );
 
+int  MV_PlayLoopedPCM( char *ptr, unsigned int length, int loopstart, int loopend,
+   unsigned int rate, int bits, int channels, int pitchoffset, int vol, int left,
+   int right, int priority, unsigned int callbackval );
+void MV_KillVoicesInRange( const char *start, const char *end );
+
 void MV_ReleaseVorbisVoice( VoiceNode * voice );
+void MV_FlushVorbisIndexes( void );
+
+// implemented in adpcm.c
+int  MV_ParseADPCMWAV( char *ptr, unsigned int length, DecodeState *format );
+int  MV_PlayLoopedADPCM( const DecodeState *format, int loopstart, int loopend,
+   int pitchoffset, int vol, int left, int right, int priority,
+   unsigned int callbackval );
+void MV_StartVOCDecode( DecodeState *st, int format, int channels, char *data,
+   unsigned int length, int reference );
+unsigned int MV_DecodeVOC( DecodeState *st );
+int  MV_EncodeADPCM( const char *ptr, unsigned int frames, unsigned int rate,
+   int bits, int channels, DecodeState *format );
+
+// implemented in resample.c
+void MV_InitResamplers( void );
+void MV_MixResampled( VoiceNode *voice, int64_t position, uint64_t rate,
+   unsigned int length );
+void MV_MixResampledHistory( VoiceNode *voice, int64_t position, uint64_t rate,
+   unsigned int length );
+void MV_SaveResampleHistory( VoiceNode *voice );
+void MV_ResetUpsampler( UpsampleState *state );
+void MV_UpsampleMix( const char *src, char *dest, int frames, int divisor,
+   int bits, int channels, UpsampleState *state );
+
+// implemented in stream.c
+void MV_ReleaseStreamVoice( VoiceNode * voice );
+void MV_ShutdownStreams( void );
 
 // implemented in mix.c
 void ClearBuffer_DW( void *ptr, unsigned data, int length );
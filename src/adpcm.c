@@ -0,0 +1,891 @@
+/*
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+ */
+
+/**
+ * IMA and Microsoft ADPCM WAV, and compressed VOC block, source
+ * support for MultiVoc, and the IMA encoder for compressing
+ * registered sounds
+ *
+ * The compressed data stays in memory as it is. Each voice decodes
+ * up to MV_DecodeFrames frames at a time into its own decode buffer
+ * as the mixer asks for them.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "pitch.h"
+#include "asssys.h"
+#include "trace.h"
+#include "multivoc.h"
+#include "_multivc.h"
+
+#define min(x,y) ((x) < (y) ? (x) : (y))
+#define max(x,y) ((x) > (y) ? (x) : (y))
+
+#ifdef __POWERPC__
+# define BIGENDIAN
+#endif
+
+// The mixer reads 16-bit sources as little-endian
+#ifdef BIGENDIAN
+# define PUT16(p, v) ( *(p) = (short) ( ( ( (v) & 255 ) << 8 ) | ( ( (v) >> 8 ) & 255 ) ) )
+#else
+# define PUT16(p, v) ( *(p) = (short) (v) )
+#endif
+
+static const int IMAIndexTable[ 16 ] = {
+   -1, -1, -1, -1, 2, 4, 6, 8,
+   -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static const int IMAStepTable[ 89 ] = {
+   7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+   19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+   50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+   130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+   337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+   876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+   2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+   5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+   15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int MSAdaptTable[ 16 ] = {
+   230, 230, 230, 230, 307, 409, 512, 614,
+   768, 614, 512, 409, 307, 230, 230, 230
+};
+
+
+static short ALawTable[ 256 ];
+static short MuLawTable[ 256 ];
+static int   LawTablesBuilt = 0;
+
+
+static unsigned int MV_ADPCMBlockFrames(int format, unsigned int bytes, int channels)
+{
+   unsigned int header = (format == DecodeIMA ? 4 : 7) * channels;
+
+   if (bytes < header) {
+      return 0;
+   }
+
+   if (format == DecodeIMA) {
+      // Stereo data comes in runs of eight samples per channel
+      return channels == 2 ? 1 + (bytes - header) / 8 * 8 : 1 + (bytes - header) * 2;
+   }
+
+   return 2 + (bytes - header) * 2 / channels;
+}
+
+
+static void MV_StartADPCMBlock(DecodeState * st)
+{
+   unsigned char * p = (unsigned char *) st->data + st->block * st->blockalign;
+   int ch, predictor;
+
+   if (st->format == DecodeIMA) {
+      for (ch = 0; ch < st->channels; ch++) {
+         st->sample1[ch] = (short) read_le16(p);
+         st->step[ch] = min(p[2], 88);
+         p += 4;
+      }
+   } else {
+      for (ch = 0; ch < st->channels; ch++) {
+         predictor = min(p[ch], st->numcoefs - 1);
+         st->coef1[ch] = st->coefs[predictor][0];
+         st->coef2[ch] = st->coefs[predictor][1];
+      }
+      p += st->channels;
+      for (ch = 0; ch < st->channels; ch++, p += 2) {
+         st->step[ch] = (short) read_le16(p);
+      }
+      for (ch = 0; ch < st->channels; ch++, p += 2) {
+         st->sample1[ch] = (short) read_le16(p);
+      }
+      for (ch = 0; ch < st->channels; ch++, p += 2) {
+         st->sample2[ch] = (short) read_le16(p);
+      }
+   }
+
+   st->in = p;
+   st->nibble = 0;
+   st->blockframe = 0;
+}
+
+
+static inline int MV_DecodeIMASample(DecodeState * st, int ch, int code)
+{
+   int step = IMAStepTable[st->step[ch]];
+   int diff = step >> 3;
+
+   if (code & 1) diff += step >> 2;
+   if (code & 2) diff += step >> 1;
+   if (code & 4) diff += step;
+
+   if (code & 8) {
+      st->sample1[ch] = max(-32768, st->sample1[ch] - diff);
+   } else {
+      st->sample1[ch] = min(32767, st->sample1[ch] + diff);
+   }
+
+   st->step[ch] = max(0, min(88, st->step[ch] + IMAIndexTable[code]));
+
+   return st->sample1[ch];
+}
+
+
+static inline int MV_DecodeMSSample(DecodeState * st, int ch, int code)
+{
+   int predict;
+
+   predict = (st->sample1[ch] * st->coef1[ch] + st->sample2[ch] * st->coef2[ch]) >> 8;
+   predict += (code >= 8 ? code - 16 : code) * st->step[ch];
+   predict = max(-32768, min(32767, predict));
+
+   st->sample2[ch] = st->sample1[ch];
+   st->sample1[ch] = predict;
+
+   st->step[ch] = max(16, (MSAdaptTable[code] * st->step[ch]) >> 8);
+
+   return predict;
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_DecodeADPCM
+
+Decodes up to the given number of frames from the current block.
+Returns the number of frames decoded.
+---------------------------------------------------------------------*/
+
+static unsigned int MV_DecodeADPCM
+(
+ DecodeState * st,
+ short * out,
+ unsigned int frames
+ )
+
+{
+   unsigned int blockframes;
+   unsigned int done = 0;
+   unsigned char * in;
+   int channels = st->channels;
+   int ch, b;
+
+   blockframes = st->block == st->numblocks - 1 ? st->lastblockframes : st->blockframes;
+   frames = min(frames, blockframes - st->blockframe);
+
+   // The block header holds the first samples
+   if (st->blockframe == 0 && frames > 0) {
+      if (st->format == DecodeMS) {
+         for (ch = 0; ch < channels; ch++) {
+            PUT16(out + ch, st->sample2[ch]);
+         }
+         out += channels;
+         done++;
+      }
+      if (done < frames) {
+         for (ch = 0; ch < channels; ch++) {
+            PUT16(out + ch, st->sample1[ch]);
+         }
+         out += channels;
+         done++;
+      }
+   }
+
+   in = st->in;
+
+   if (st->format == DecodeIMA && channels == 2) {
+      // Four bytes of left, then four of right, for each eight frames
+      frames = done + (frames - done) / 8 * 8;
+      for (; done < frames; done += 8, in += 8, out += 16) {
+         for (ch = 0; ch < 2; ch++) {
+            for (b = 0; b < 4; b++) {
+               PUT16(out + b * 4 + ch, MV_DecodeIMASample(st, ch, in[ch * 4 + b] & 15));
+               PUT16(out + b * 4 + 2 + ch, MV_DecodeIMASample(st, ch, in[ch * 4 + b] >> 4));
+            }
+         }
+      }
+   } else if (st->format == DecodeIMA) {
+      // Low nibble first
+      for (; done < frames; done++, out++) {
+         if (!st->nibble) {
+            PUT16(out, MV_DecodeIMASample(st, 0, *in & 15));
+         } else {
+            PUT16(out, MV_DecodeIMASample(st, 0, *in++ >> 4));
+         }
+         st->nibble ^= 1;
+      }
+   } else if (channels == 2) {
+      // One byte per frame, left in the high nibble
+      for (; done < frames; done++, in++, out += 2) {
+         PUT16(out, MV_DecodeMSSample(st, 0, *in >> 4));
+         PUT16(out + 1, MV_DecodeMSSample(st, 1, *in & 15));
+      }
+   } else {
+      // High nibble first
+      for (; done < frames; done++, out++) {
+         if (!st->nibble) {
+            PUT16(out, MV_DecodeMSSample(st, 0, *in >> 4));
+         } else {
+            PUT16(out, MV_DecodeMSSample(st, 0, *in++ & 15));
+         }
+         st->nibble ^= 1;
+      }
+   }
+
+   st->in = in;
+   st->blockframe += done;
+
+   return done;
+}
+
+
+static void MV_SeekADPCM(DecodeState * st, unsigned int frame)
+{
+   st->block = frame / st->blockframes;
+   st->frame = st->block * st->blockframes;
+   st->skip  = frame - st->frame;
+   MV_StartADPCMBlock(st);
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_GetNextADPCMBlock
+
+Decodes the next run of frames into the voice's decode buffer.
+---------------------------------------------------------------------*/
+
+static playbackstatus MV_GetNextADPCMBlock
+(
+ VoiceNode *voice
+ )
+
+{
+   DecodeState * st = &voice->decode;
+   unsigned int blockframes;
+   unsigned int end;
+   unsigned int frames;
+   unsigned int start;
+   unsigned int stop;
+   TraceSpan span;
+
+   voice->position -= voice->length;
+   end = st->looping ? st->loopend : st->totalframes;
+
+   for (;;) {
+      blockframes = st->block == st->numblocks - 1 ? st->lastblockframes : st->blockframes;
+      if (st->blockframe >= blockframes) {
+         st->block++;
+         if (st->block < st->numblocks) {
+            MV_StartADPCMBlock(st);
+         }
+      }
+
+      if (st->frame >= end || st->block >= st->numblocks) {
+         if (!st->looping) {
+            voice->Playing = FALSE;
+            return( NoMoreData );
+         }
+         MV_SeekADPCM(st, st->loopstart);
+      }
+
+      TRACE_BEGIN(span);
+      frames = MV_DecodeADPCM(st, (short *) st->buffer, MV_DecodeFrames);
+      TRACE_END(span, "ADPCM decode", voice->handle);
+      if (frames == 0) {
+         voice->Playing = FALSE;
+         return( NoMoreData );
+      }
+      st->frame += frames;
+
+      // Drop what comes before a loop start or after a loop end
+      start = min(st->skip, frames);
+      st->skip -= start;
+      stop = frames;
+      if (st->frame > end) {
+         stop -= min(frames, st->frame - end);
+      }
+
+      if (start < stop) {
+         break;
+      }
+   }
+
+   voice->sound  = st->buffer + start * st->channels * 2;
+   voice->length = (uint64_t) (stop - start) << 32;
+
+   return( KeepPlaying );
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_ParseADPCMWAV
+
+Reads the format of an IMA or Microsoft ADPCM WAV file into a decoder
+template for MV_PlayLoopedADPCM.
+---------------------------------------------------------------------*/
+
+int MV_ParseADPCMWAV
+(
+ char *ptr,
+ unsigned int length,
+ DecodeState *format
+ )
+
+{
+   const unsigned char * p = (const unsigned char *) ptr;
+   const unsigned char * fmt = 0;
+   unsigned int pos = 12;
+   unsigned int chunklength;
+   unsigned int fmtlength = 0;
+   unsigned int factframes = 0;
+   unsigned int datalength;
+   unsigned int tag;
+   int i;
+
+   memset(format, 0, sizeof(DecodeState));
+
+   if (length < 12 || memcmp(p, "RIFF", 4) || memcmp(p + 8, "WAVE", 4)) {
+      return MV_InvalidWAVFile;
+   }
+
+   while (pos + 8 <= length) {
+      chunklength = min(read_le32(p + pos + 4), length - pos - 8);
+
+      if (!memcmp(p + pos, "fmt ", 4)) {
+         fmt = p + pos + 8;
+         fmtlength = chunklength;
+      } else if (!memcmp(p + pos, "fact", 4) && chunklength >= 4) {
+         factframes = read_le32(p + pos + 8);
+      } else if (!memcmp(p + pos, "data", 4)) {
+         format->data = ptr + pos + 8;
+         break;
+      }
+
+      pos += 8 + chunklength + (chunklength & 1);
+   }
+
+   if (!fmt || fmtlength < 16 || !format->data) {
+      return MV_InvalidWAVFile;
+   }
+
+   tag                = read_le16(fmt);
+   format->channels   = read_le16(fmt + 2);
+   format->rate       = read_le32(fmt + 4);
+   format->blockalign = read_le16(fmt + 12);
+
+   if (format->channels != 1 && format->channels != 2) {
+      return MV_InvalidWAVFile;
+   }
+
+   if (tag == WAVE_FORMAT_IMA_ADPCM) {
+      format->format = DecodeIMA;
+   } else if (tag == WAVE_FORMAT_ADPCM) {
+      format->format = DecodeMS;
+
+      // cbSize, wSamplesPerBlock, wNumCoef, then the coefficient pairs
+      if (fmtlength < 22) {
+         return MV_InvalidWAVFile;
+      }
+      format->numcoefs = read_le16(fmt + 20);
+      if (format->numcoefs < 1 || format->numcoefs > MV_MaxADPCMCoefs ||
+          fmtlength < 22 + 4 * (unsigned int) format->numcoefs) {
+         return MV_InvalidWAVFile;
+      }
+      for (i = 0; i < format->numcoefs; i++) {
+         format->coefs[i][0] = (short) read_le16(fmt + 22 + i * 4);
+         format->coefs[i][1] = (short) read_le16(fmt + 24 + i * 4);
+      }
+   } else {
+      return MV_InvalidWAVFile;
+   }
+
+   format->blockframes = MV_ADPCMBlockFrames(format->format, format->blockalign, format->channels);
+   if (format->blockframes < 2 || format->rate == 0) {
+      return MV_InvalidWAVFile;
+   }
+
+   datalength = min(read_le32((const unsigned char *) format->data - 4),
+                    length - (unsigned int) (format->data - ptr));
+
+   format->numblocks = datalength / format->blockalign;
+   format->lastblockframes = format->blockframes;
+   format->totalframes = format->numblocks * format->blockframes;
+
+   // A short final block
+   i = MV_ADPCMBlockFrames(format->format, datalength % format->blockalign, format->channels);
+   if (i > 0) {
+      format->numblocks++;
+      format->lastblockframes = i;
+      format->totalframes += i;
+   }
+
+   if (factframes > 0 && factframes < format->totalframes) {
+      format->totalframes = factframes;
+   }
+
+   return format->totalframes > 0 ? MV_Ok : MV_InvalidWAVFile;
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_PlayLoopedADPCM
+
+Begin playback of ADPCM data described by MV_ParseADPCMWAV. Loop
+points are in sample frames.
+---------------------------------------------------------------------*/
+
+int MV_PlayLoopedADPCM
+(
+ const DecodeState *format,
+ int   loopstart,
+ int   loopend,
+ int   pitchoffset,
+ int   vol,
+ int   left,
+ int   right,
+ int   priority,
+ unsigned int callbackval
+ )
+
+{
+   VoiceNode   *voice;
+   DecodeState *st;
+   char        *buffer;
+
+   if ( !MV_Installed )
+   {
+      MV_SetErrorCode( MV_NotInstalled );
+      return( MV_Error );
+   }
+
+   // Request a voice from the voice pool
+   voice = MV_AllocVoice( priority );
+   if ( voice == NULL )
+   {
+      MV_SetErrorCode( MV_NoVoices );
+      return( MV_Error );
+   }
+
+   st = &voice->decode;
+   buffer = st->buffer;
+   *st = *format;
+   st->buffer = buffer;
+
+   st->looping = loopstart >= 0 && (unsigned int) loopstart < st->totalframes;
+   if (st->looping) {
+      st->loopstart = loopstart;
+      st->loopend   = (loopend > loopstart && (unsigned int) loopend <= st->totalframes) ?
+                      (unsigned int) loopend : st->totalframes;
+   }
+
+   st->frame = 0;
+   st->skip  = 0;
+   st->block = 0;
+   MV_StartADPCMBlock(st);
+
+   voice->wavetype    = WAV;
+   voice->bits        = 16;
+   voice->channels    = st->channels;
+   voice->GetSound    = MV_GetNextADPCMBlock;
+   voice->NextBlock   = st->data;
+   voice->sound       = st->buffer;
+   voice->DemandFeed  = NULL;
+   voice->LoopStart   = NULL;
+   voice->LoopEnd     = NULL;
+   voice->LoopSize    = 0;
+   voice->LoopCount   = 0;
+   voice->BlockLength = 0;
+   voice->length      = 0;
+   voice->position    = 0;
+   voice->next        = NULL;
+   voice->prev        = NULL;
+   voice->priority    = priority;
+   voice->callbackval = callbackval;
+   voice->Playing     = TRUE;
+   voice->Paused      = FALSE;
+
+   voice->PitchScale   = PITCH_GetScale( pitchoffset );
+   voice->SamplingRate = st->rate;
+   voice->RateScale    = RATE_SCALE( voice->SamplingRate, voice->PitchScale );
+
+   MV_SetVoiceVolume( voice, vol, left, right );
+   MV_PlayVoice( voice );
+
+   return( voice->handle );
+}
+
+
+static void MV_BuildLawTables(void)
+{
+   int i, t, seg, u;
+
+   for (i = 0; i < 256; i++) {
+      // G.711 A-law
+      u   = i ^ 0x55;
+      t   = (u & 15) << 4;
+      seg = (u & 0x70) >> 4;
+      if (seg == 0) {
+         t += 8;
+      } else {
+         t = (t + 0x108) << (seg - 1);
+      }
+      ALawTable[i] = (u & 0x80) ? t : -t;
+
+      // G.711 mu-law
+      u = ~i;
+      t = (((u & 15) << 3) + 0x84) << ((u & 0x70) >> 4);
+      MuLawTable[i] = (u & 0x80) ? 0x84 - t : t - 0x84;
+   }
+
+   LawTablesBuilt = 1;
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_StartVOCDecode
+
+Prepares to decode a compressed VOC data block. Creative 8-bit ADPCM
+begins with a reference sample per channel in a new sound data block
+but not in a continuation block, which carries on from the state left
+by the previous one.
+---------------------------------------------------------------------*/
+
+void MV_StartVOCDecode
+(
+ DecodeState *st,
+ int format,
+ int channels,
+ char *data,
+ unsigned int length,
+ int reference
+ )
+
+{
+   int ch;
+
+   if ((format == DecodeALaw || format == DecodeMuLaw) && !LawTablesBuilt) {
+      MV_BuildLawTables();
+   }
+
+   st->in        = (unsigned char *) data;
+   st->remaining = length;
+   st->reference = 0;
+
+   if (!reference && st->format == format && st->channels == channels) {
+      return;
+   }
+
+   st->format   = format;
+   st->channels = channels;
+
+   for (ch = 0; ch < channels; ch++) {
+      st->sample1[ch] = 0;
+      st->step[ch]    = format == DecodeCT16 ? 511 : 0;
+   }
+
+   if (format >= DecodeCT4 && format <= DecodeCT2 && reference &&
+       st->remaining >= (unsigned int) channels) {
+      for (ch = 0; ch < channels; ch++) {
+         st->sample1[ch] = *st->in++ - 128;
+      }
+      st->remaining -= channels;
+      st->reference = 1;
+   }
+}
+
+
+static inline int MV_DecodeCTSample(DecodeState * st, int ch, int code, int size, int shift)
+{
+   int sign  = code & (1 << (size - 1));
+   int delta = code & ((1 << (size - 1)) - 1);
+   int diff  = delta << (st->step[ch] + shift);
+
+   st->sample1[ch] = sign ? max(-128, st->sample1[ch] - diff) : min(127, st->sample1[ch] + diff);
+
+   if (delta >= 2 * size - 3 && st->step[ch] < 3) {
+      st->step[ch]++;
+   } else if (delta == 0 && st->step[ch] > 0) {
+      st->step[ch]--;
+   }
+
+   return st->sample1[ch] + 128;
+}
+
+
+static inline int MV_DecodeCT16Sample(DecodeState * st, int ch, int code)
+{
+   int diff = ((2 * (code & 7) + 1) * st->step[ch]) >> 3;
+   int predict;
+
+   // The predictor leaks slightly towards zero
+   predict = ((st->sample1[ch] * 254) >> 8) + ((code & 8) ? -diff : diff);
+   st->sample1[ch] = max(-32768, min(32767, predict));
+
+   st->step[ch] = max(511, min(32767, (MSAdaptTable[code & 7] * st->step[ch]) >> 8));
+
+   return st->sample1[ch];
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_DecodeVOC
+
+Decodes the next run of a compressed VOC block into the decode
+buffer. Creative 8-bit ADPCM decodes to unsigned 8-bit samples, the
+other formats to 16-bit. Returns the number of frames decoded.
+---------------------------------------------------------------------*/
+
+unsigned int MV_DecodeVOC
+(
+ DecodeState *st
+ )
+
+{
+   unsigned char * in = st->in;
+   unsigned char * out8 = (unsigned char *) st->buffer;
+   short * out16 = (short *) st->buffer;
+   unsigned int frames = 0;
+   unsigned int bytes;
+   int ch;
+
+   if (st->reference) {
+      for (ch = 0; ch < st->channels; ch++) {
+         *out8++ = st->sample1[ch] + 128;
+      }
+      st->reference = 0;
+      frames++;
+   }
+
+   switch (st->format) {
+      case DecodeCT4:
+         // High nibble first; stereo has the left channel there
+         bytes = min(st->remaining, (MV_DecodeFrames - frames) / (2 / st->channels));
+         frames += bytes * 2 / st->channels;
+         for (; bytes > 0; bytes--, in++) {
+            *out8++ = MV_DecodeCTSample(st, 0, *in >> 4, 4, 0);
+            *out8++ = MV_DecodeCTSample(st, st->channels - 1, *in & 15, 4, 0);
+         }
+         break;
+
+      case DecodeCT3:
+         bytes = min(st->remaining, (MV_DecodeFrames - frames) / 3);
+         frames += bytes * 3;
+         for (; bytes > 0; bytes--, in++) {
+            *out8++ = MV_DecodeCTSample(st, 0, *in >> 5, 3, 0);
+            *out8++ = MV_DecodeCTSample(st, 0, (*in >> 2) & 7, 3, 0);
+            *out8++ = MV_DecodeCTSample(st, 0, *in & 3, 2, 0);
+         }
+         break;
+
+      case DecodeCT2:
+         bytes = min(st->remaining, (MV_DecodeFrames - frames) / 4);
+         frames += bytes * 4;
+         for (; bytes > 0; bytes--, in++) {
+            *out8++ = MV_DecodeCTSample(st, 0, *in >> 6, 2, 2);
+            *out8++ = MV_DecodeCTSample(st, 0, (*in >> 4) & 3, 2, 2);
+            *out8++ = MV_DecodeCTSample(st, 0, (*in >> 2) & 3, 2, 2);
+            *out8++ = MV_DecodeCTSample(st, 0, *in & 3, 2, 2);
+         }
+         break;
+
+      case DecodeCT16:
+         bytes = min(st->remaining, MV_DecodeFrames / (2 / st->channels));
+         frames = bytes * 2 / st->channels;
+         for (; bytes > 0; bytes--, in++, out16 += 2) {
+            PUT16(out16, MV_DecodeCT16Sample(st, 0, *in >> 4));
+            PUT16(out16 + 1, MV_DecodeCT16Sample(st, st->channels - 1, *in & 15));
+         }
+         break;
+
+      case DecodeALaw:
+      case DecodeMuLaw:
+         bytes = min(st->remaining, MV_DecodeFrames * st->channels);
+         bytes -= bytes % st->channels;
+         frames = bytes / st->channels;
+         for (; bytes > 0; bytes--, in++, out16++) {
+            PUT16(out16, st->format == DecodeALaw ? ALawTable[*in] : MuLawTable[*in]);
+         }
+         break;
+
+      default:
+         break;
+   }
+
+   st->remaining -= in - st->in;
+   st->in = in;
+
+   // Drop a trailing partial frame
+   if (frames == 0) {
+      st->remaining = 0;
+   }
+
+   return frames;
+}
+
+
+/*---------------------------------------------------------------------
+   IMA ADPCM encoding
+---------------------------------------------------------------------*/
+
+// Bytes of compressed data per channel in each encoded block
+#define MV_EncodeBlockAlign 512
+
+static inline int MV_EncodeIMASample(int * predictor, int * index, int sample)
+{
+   int step = IMAStepTable[*index];
+   int delta = sample - *predictor;
+   int diff = step >> 3;
+   int code = 0;
+
+   if (delta < 0) {
+      code = 8;
+      delta = -delta;
+   }
+   if (delta >= step) {
+      code |= 4;
+      delta -= step;
+      diff += step;
+   }
+   step >>= 1;
+   if (delta >= step) {
+      code |= 2;
+      delta -= step;
+      diff += step;
+   }
+   step >>= 1;
+   if (delta >= step) {
+      code |= 1;
+      diff += step;
+   }
+
+   // Track the decoder exactly so that errors do not build up
+   if (code & 8) {
+      *predictor = max(-32768, *predictor - diff);
+   } else {
+      *predictor = min(32767, *predictor + diff);
+   }
+   *index = max(0, min(88, *index + IMAIndexTable[code]));
+
+   return code;
+}
+
+
+static inline int MV_PCMSample(const unsigned char * ptr, unsigned int frame, unsigned int frames,
+                               int bits, int channels, int ch)
+{
+   // Pad the last block by holding the final sample
+   frame = min(frame, frames - 1);
+
+   if (bits == 8) {
+      return (ptr[frame * channels + ch] - 128) << 8;
+   }
+
+   ptr += (frame * channels + ch) * 2;
+   return (short) (ptr[0] | (ptr[1] << 8));
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_EncodeADPCM
+
+Encodes 8- or 16-bit PCM into IMA ADPCM blocks in a new buffer and
+fills in a decoder template for MV_PlayLoopedADPCM. The caller frees
+format->data.
+---------------------------------------------------------------------*/
+
+int MV_EncodeADPCM
+(
+ const char *ptr,
+ unsigned int frames,
+ unsigned int rate,
+ int bits,
+ int channels,
+ DecodeState *format
+ )
+
+{
+   const unsigned char * pcm = (const unsigned char *) ptr;
+   unsigned char * out;
+   unsigned int block, frame, i;
+   int predictor[2] = { 0, 0 };
+   int index[2] = { 0, 0 };
+   int ch, b, code;
+
+   memset(format, 0, sizeof(DecodeState));
+
+   if (frames == 0 || (bits != 8 && bits != 16) || (channels != 1 && channels != 2)) {
+      return MV_InvalidWAVFile;
+   }
+
+   format->format      = DecodeIMA;
+   format->rate        = rate;
+   format->channels    = channels;
+   format->blockalign  = MV_EncodeBlockAlign * channels;
+   format->blockframes = MV_ADPCMBlockFrames(DecodeIMA, format->blockalign, channels);
+   format->numblocks   = (frames + format->blockframes - 1) / format->blockframes;
+   format->lastblockframes = format->blockframes;
+   format->totalframes = frames;
+
+   format->data = (char *) ASS_Alloc(ASS_MemSounds, format->numblocks * format->blockalign);
+   if (!format->data) {
+      return MV_NoMem;
+   }
+
+   out = (unsigned char *) format->data;
+   for (block = 0; block < format->numblocks; block++) {
+      frame = block * format->blockframes;
+
+      // The header holds the first frame exactly
+      for (ch = 0; ch < channels; ch++) {
+         predictor[ch] = MV_PCMSample(pcm, frame, frames, bits, channels, ch);
+         *out++ = predictor[ch] & 255;
+         *out++ = (predictor[ch] >> 8) & 255;
+         *out++ = index[ch];
+         *out++ = 0;
+      }
+      frame++;
+
+      if (channels == 1) {
+         for (i = 0; i < MV_EncodeBlockAlign - 4; i++, frame += 2) {
+            code  = MV_EncodeIMASample(&predictor[0], &index[0],
+                                       MV_PCMSample(pcm, frame, frames, bits, 1, 0));
+            code |= MV_EncodeIMASample(&predictor[0], &index[0],
+                                       MV_PCMSample(pcm, frame + 1, frames, bits, 1, 0)) << 4;
+            *out++ = code;
+         }
+      } else {
+         for (i = 0; i < (MV_EncodeBlockAlign - 4) / 4; i++, frame += 8) {
+            for (ch = 0; ch < 2; ch++) {
+               for (b = 0; b < 8; b += 2) {
+                  code  = MV_EncodeIMASample(&predictor[ch], &index[ch],
+                                             MV_PCMSample(pcm, frame + b, frames, bits, 2, ch));
+                  code |= MV_EncodeIMASample(&predictor[ch], &index[ch],
+                                             MV_PCMSample(pcm, frame + b + 1, frames, bits, 2, ch)) << 4;
+                  *out++ = code;
+               }
+            }
+         }
+      }
+   }
+
+   return MV_Ok;
+}
+
+// vim:ts=3:expandtab:
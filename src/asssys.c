@@ -20,14 +20,65 @@
 
 #include "asssys.h"
 
+#include <stdlib.h>
+
 #ifdef _WIN32
 # define WIN32_LEAN_AND_MEAN
 # include <windows.h>
 #else
 # include <sys/types.h>
 # include <sys/time.h>
+# include <time.h>
 # include <unistd.h>
+# include <pthread.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+#endif
+
+struct ASS_Thread {
+	int (*func)(void *);
+	void * arg;
+	int result;
+#ifdef _WIN32
+	HANDLE thread;
+#else
+	pthread_t thread;
+#endif
+};
+
+struct ASS_MappedFile {
+	void * data;
+	size_t length;
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#endif
+};
+
+// Ahead of each ASS_Alloc block, keeping what follows aligned
+typedef union {
+	struct {
+		size_t size;
+		int category;
+	} h;
+	double align[2];
+} ASS_MemHeader;
+
+static volatile unsigned int MemCurrent[ASS_NumMemCategories];
+static unsigned int MemPeak[ASS_NumMemCategories];
+static volatile unsigned int MemTotal;
+static unsigned int MemTotalPeak;
+static unsigned int MemBudget;
+static volatile unsigned int MemRefused;
+
+struct ASS_Mutex {
+#ifdef _WIN32
+	CRITICAL_SECTION mutex;
+#else
+	pthread_mutex_t mutex;
 #endif
+};
 
 void ASS_Sleep(int msec)
 {
@@ -41,3 +92,426 @@ void ASS_Sleep(int msec)
 	select(0, NULL, NULL, NULL, &tv);
 #endif
 }
+
+unsigned int ASS_GetTicks(void)
+{
+#ifdef _WIN32
+	return (unsigned int) GetTickCount();
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned int) (ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+#endif
+}
+
+unsigned int ASS_GetMicroTicks(void)
+{
+#ifdef _WIN32
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER count;
+
+	if (!freq.QuadPart) {
+		QueryPerformanceFrequency(&freq);
+	}
+	QueryPerformanceCounter(&count);
+	return (unsigned int) (count.QuadPart / freq.QuadPart * 1000000 +
+		count.QuadPart % freq.QuadPart * 1000000 / freq.QuadPart);
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned int) ((unsigned long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+#endif
+}
+
+unsigned int ASS_GetNanoTicks(void)
+{
+#ifdef _WIN32
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER count;
+
+	if (!freq.QuadPart) {
+		QueryPerformanceFrequency(&freq);
+	}
+	QueryPerformanceCounter(&count);
+	return (unsigned int) (count.QuadPart / freq.QuadPart * 1000000000 +
+		count.QuadPart % freq.QuadPart * 1000000000 / freq.QuadPart);
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned int) ((unsigned long long) ts.tv_sec * 1000000000 + ts.tv_nsec);
+#endif
+}
+
+#ifdef _WIN32
+static DWORD WINAPI threadEntry(LPVOID arg)
+{
+	ASS_Thread * thread = (ASS_Thread *) arg;
+
+	thread->result = thread->func(thread->arg);
+	return 0;
+}
+#else
+static void * threadEntry(void * arg)
+{
+	ASS_Thread * thread = (ASS_Thread *) arg;
+
+	thread->result = thread->func(thread->arg);
+	return 0;
+}
+#endif
+
+ASS_Thread * ASS_CreateThread(int (*func)(void *), void * arg)
+{
+	ASS_Thread * thread;
+
+	thread = (ASS_Thread *) ASS_Alloc(ASS_MemOther, sizeof(ASS_Thread));
+	if (!thread) {
+		return 0;
+	}
+
+	thread->func = func;
+	thread->arg = arg;
+	thread->result = 0;
+
+#ifdef _WIN32
+	thread->thread = CreateThread(NULL, 0, threadEntry, thread, 0, 0);
+	if (!thread->thread) {
+		ASS_Free(thread);
+		return 0;
+	}
+#else
+	if (pthread_create(&thread->thread, NULL, threadEntry, thread)) {
+		ASS_Free(thread);
+		return 0;
+	}
+#endif
+
+	return thread;
+}
+
+int ASS_WaitThread(ASS_Thread * thread)
+{
+	int result;
+
+	if (!thread) {
+		return 0;
+	}
+
+#ifdef _WIN32
+	WaitForSingleObject(thread->thread, INFINITE);
+	CloseHandle(thread->thread);
+#else
+	pthread_join(thread->thread, NULL);
+#endif
+
+	result = thread->result;
+	ASS_Free(thread);
+
+	return result;
+}
+
+unsigned int ASS_GetThreadID(void)
+{
+#ifdef _WIN32
+	return (unsigned int) GetCurrentThreadId();
+#else
+	return (unsigned int) (size_t) pthread_self();
+#endif
+}
+
+ASS_Mutex * ASS_CreateMutex(void)
+{
+	ASS_Mutex * mutex;
+#ifndef _WIN32
+	pthread_mutexattr_t attr;
+#endif
+
+	mutex = (ASS_Mutex *) ASS_Alloc(ASS_MemOther, sizeof(ASS_Mutex));
+	if (!mutex) {
+		return 0;
+	}
+
+#ifdef _WIN32
+	InitializeCriticalSection(&mutex->mutex);
+#else
+	// Critical sections are recursive, so make these match
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	if (pthread_mutex_init(&mutex->mutex, &attr)) {
+		pthread_mutexattr_destroy(&attr);
+		ASS_Free(mutex);
+		return 0;
+	}
+	pthread_mutexattr_destroy(&attr);
+#endif
+
+	return mutex;
+}
+
+void ASS_DestroyMutex(ASS_Mutex * mutex)
+{
+	if (!mutex) {
+		return;
+	}
+
+#ifdef _WIN32
+	DeleteCriticalSection(&mutex->mutex);
+#else
+	pthread_mutex_destroy(&mutex->mutex);
+#endif
+	ASS_Free(mutex);
+}
+
+void ASS_LockMutex(ASS_Mutex * mutex)
+{
+#ifdef _WIN32
+	EnterCriticalSection(&mutex->mutex);
+#else
+	pthread_mutex_lock(&mutex->mutex);
+#endif
+}
+
+void ASS_UnlockMutex(ASS_Mutex * mutex)
+{
+#ifdef _WIN32
+	LeaveCriticalSection(&mutex->mutex);
+#else
+	pthread_mutex_unlock(&mutex->mutex);
+#endif
+}
+
+void ASS_MemoryBarrier(void)
+{
+#if defined(_MSC_VER)
+	MemoryBarrier();
+#elif defined(__GNUC__)
+	__sync_synchronize();
+#endif
+}
+
+unsigned int ASS_AtomicIncrement(volatile unsigned int * value)
+{
+#if defined(_WIN32)
+	return (unsigned int) InterlockedIncrement((volatile LONG *) value) - 1;
+#elif defined(__GNUC__)
+	return __sync_fetch_and_add(value, 1);
+#else
+	return (*value)++;
+#endif
+}
+
+unsigned int ASS_AtomicAdd(volatile unsigned int * value, int amount)
+{
+#if defined(_WIN32)
+	return (unsigned int) InterlockedExchangeAdd((volatile LONG *) value, amount);
+#elif defined(__GNUC__)
+	return __sync_fetch_and_add(value, amount);
+#else
+	unsigned int old = *value;
+	*value += amount;
+	return old;
+#endif
+}
+
+// Takes bytes from the budget, or gives them back when negative. The
+// total is raised first and lowered again on failure, so two threads
+// racing for the last of the budget cannot both get it. Peaks are kept
+// without a lock and may miss a simultaneous high.
+static int chargeMemory(int category, int amount)
+{
+	unsigned int total;
+
+	total = ASS_AtomicAdd(&MemTotal, amount) + amount;
+	if (amount > 0 && MemBudget && total > MemBudget) {
+		ASS_AtomicAdd(&MemTotal, -amount);
+		ASS_AtomicIncrement(&MemRefused);
+		return 0;
+	}
+
+	ASS_AtomicAdd(&MemCurrent[category], amount);
+	if (amount > 0) {
+		if (MemCurrent[category] > MemPeak[category]) {
+			MemPeak[category] = MemCurrent[category];
+		}
+		if (total > MemTotalPeak) {
+			MemTotalPeak = total;
+		}
+	}
+	return 1;
+}
+
+void * ASS_Alloc(int category, size_t size)
+{
+	ASS_MemHeader * header;
+
+	if (size > 0x7fffffff - sizeof(ASS_MemHeader) || !chargeMemory(category, (int) size)) {
+		return 0;
+	}
+
+	header = (ASS_MemHeader *) malloc(sizeof(ASS_MemHeader) + size);
+	if (!header) {
+		chargeMemory(category, -(int) size);
+		return 0;
+	}
+
+	header->h.size = size;
+	header->h.category = category;
+	return header + 1;
+}
+
+void * ASS_Realloc(int category, void * ptr, size_t size)
+{
+	ASS_MemHeader * header, * moved;
+	int change;
+
+	if (!ptr) {
+		return ASS_Alloc(category, size);
+	}
+	if (size > 0x7fffffff - sizeof(ASS_MemHeader)) {
+		return 0;
+	}
+
+	header = (ASS_MemHeader *) ptr - 1;
+	change = (int) size - (int) header->h.size;
+	if (change > 0 && !chargeMemory(header->h.category, change)) {
+		return 0;
+	}
+
+	moved = (ASS_MemHeader *) realloc(header, sizeof(ASS_MemHeader) + size);
+	if (!moved) {
+		if (change > 0) {
+			chargeMemory(header->h.category, -change);
+		}
+		return 0;
+	}
+	if (change < 0) {
+		chargeMemory(moved->h.category, change);
+	}
+
+	moved->h.size = size;
+	return moved + 1;
+}
+
+void ASS_Free(void * ptr)
+{
+	ASS_MemHeader * header;
+
+	if (!ptr) {
+		return;
+	}
+
+	header = (ASS_MemHeader *) ptr - 1;
+	chargeMemory(header->h.category, -(int) header->h.size);
+	free(header);
+}
+
+void ASS_SetMemoryBudget(unsigned int bytes)
+{
+	MemBudget = bytes;
+}
+
+void ASS_GetMemoryUsage(ASS_MemoryUsage * usage)
+{
+	int i;
+
+	for (i = 0; i < ASS_NumMemCategories; i++) {
+		usage->current[i] = MemCurrent[i];
+		usage->peak[i] = MemPeak[i];
+	}
+	usage->total = MemTotal;
+	usage->totalpeak = MemTotalPeak;
+	usage->budget = MemBudget;
+	usage->refused = MemRefused;
+}
+
+void ASS_ResetMemoryPeaks(void)
+{
+	int i;
+
+	for (i = 0; i < ASS_NumMemCategories; i++) {
+		MemPeak[i] = MemCurrent[i];
+	}
+	MemTotalPeak = MemTotal;
+	MemRefused = 0;
+}
+
+ASS_MappedFile * ASS_MapFile(const char * filename, const void ** data, size_t * length)
+{
+	ASS_MappedFile * file;
+
+	file = (ASS_MappedFile *) ASS_Alloc(ASS_MemOther, sizeof(ASS_MappedFile));
+	if (!file) {
+		return 0;
+	}
+
+#ifdef _WIN32
+	file->file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file->file == INVALID_HANDLE_VALUE) {
+		ASS_Free(file);
+		return 0;
+	}
+
+	file->length = (size_t) GetFileSize(file->file, NULL);
+	file->mapping = CreateFileMapping(file->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	file->data = file->mapping ? MapViewOfFile(file->mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+	if (!file->data) {
+		if (file->mapping) {
+			CloseHandle(file->mapping);
+		}
+		CloseHandle(file->file);
+		ASS_Free(file);
+		return 0;
+	}
+#else
+	{
+		struct stat st;
+		int fd;
+
+		fd = open(filename, O_RDONLY);
+		if (fd < 0) {
+			ASS_Free(file);
+			return 0;
+		}
+
+		if (fstat(fd, &st) || st.st_size == 0) {
+			close(fd);
+			ASS_Free(file);
+			return 0;
+		}
+
+		file->length = (size_t) st.st_size;
+		file->data = mmap(NULL, file->length, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+
+		if (file->data == MAP_FAILED) {
+			ASS_Free(file);
+			return 0;
+		}
+	}
+#endif
+
+	*data = file->data;
+	*length = file->length;
+
+	return file;
+}
+
+void ASS_UnmapFile(ASS_MappedFile * file)
+{
+	if (!file) {
+		return;
+	}
+
+#ifdef _WIN32
+	UnmapViewOfFile(file->data);
+	CloseHandle(file->mapping);
+	CloseHandle(file->file);
+#else
+	munmap(file->data, file->length);
+#endif
+	ASS_Free(file);
+}
@@ -21,6 +21,61 @@
 #ifndef __ASSSYS_H
 #define __ASSSYS_H
 
+#include <stddef.h>
+#include "sndcards.h"
+
 void ASS_Sleep(int msec);
 
+// Milliseconds from an arbitrary starting point, for pacing.
+unsigned int ASS_GetTicks(void);
+
+// Microseconds from an arbitrary starting point, for timing. Wraps
+// every 71 minutes, so only differences are meaningful.
+unsigned int ASS_GetMicroTicks(void);
+
+// Nanoseconds likewise, for timing short stretches of code. Wraps every
+// four seconds.
+unsigned int ASS_GetNanoTicks(void);
+
+typedef struct ASS_Thread ASS_Thread;
+typedef struct ASS_Mutex ASS_Mutex;
+
+ASS_Thread * ASS_CreateThread(int (*func)(void *), void * arg);
+int  ASS_WaitThread(ASS_Thread * thread);
+
+// A number naming the calling thread, for logs and traces.
+unsigned int ASS_GetThreadID(void);
+
+// Mutexes may be locked again by the thread already holding them.
+ASS_Mutex * ASS_CreateMutex(void);
+void ASS_DestroyMutex(ASS_Mutex * mutex);
+void ASS_LockMutex(ASS_Mutex * mutex);
+void ASS_UnlockMutex(ASS_Mutex * mutex);
+
+// Read-only view of a whole file
+typedef struct ASS_MappedFile ASS_MappedFile;
+
+ASS_MappedFile * ASS_MapFile(const char * filename, const void ** data, size_t * length);
+void ASS_UnmapFile(ASS_MappedFile * file);
+
+// Full memory barrier for lock-free handoffs between threads.
+void ASS_MemoryBarrier(void);
+
+// Adds one to a shared counter and returns what it was before.
+unsigned int ASS_AtomicIncrement(volatile unsigned int * value);
+
+// Adds to a shared counter and returns what it was before.
+unsigned int ASS_AtomicAdd(volatile unsigned int * value, int amount);
+
+// Heap memory charged to one of the ASS_MEMORY categories. With a budget
+// set, allocations that would take the total past it fail as if the heap
+// were exhausted. Blocks from ASS_Alloc must go back through ASS_Free.
+void * ASS_Alloc(int category, size_t size);
+void * ASS_Realloc(int category, void * ptr, size_t size);
+void ASS_Free(void * ptr);
+
+void ASS_SetMemoryBudget(unsigned int bytes);
+void ASS_GetMemoryUsage(ASS_MemoryUsage * usage);
+void ASS_ResetMemoryPeaks(void);
+
 #endif
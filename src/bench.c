@@ -0,0 +1,304 @@
+/*
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+ */
+
+/**
+ * Times the mixing kernels over representative buffers
+ *
+ *   bench [-w warmup] [-n repetitions] [-c] [kernel ...]
+ *
+ * Every kernel is run over each case in turn: unity rate, pitched down,
+ * pitched up, and with the right channel silent. A repetition mixes a
+ * page of blocks the way MV_Mix does and is timed on its own. The table
+ * gives the median, 90th and 99th percentile cost of an output frame and
+ * the median throughput. -c prints CSV instead. Naming kernels runs only
+ * those whose names contain one of the arguments.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+# define WIN32_LEAN_AND_MEAN
+# include <windows.h>
+#else
+# include <time.h>
+#endif
+
+#include "multivoc.h"
+#include "_multivc.h"
+
+#define BLOCKS 16
+#define PAGEFRAMES (BLOCKS * MixBufferSize)
+
+extern char  *MV_HarshClipTable;
+extern char  *MV_MixDestination;
+extern short *MV_LeftVolume;
+extern short *MV_RightVolume;
+extern int    MV_SampleSize;
+extern int    MV_RightChannelOffset;
+
+typedef void (* kernelfunc)(unsigned int position, unsigned int rate,
+                            char * start, unsigned int length);
+
+typedef struct {
+    const char * name;
+    kernelfunc func;
+    int resampler;          // MV_ResampleNearest for the plain kernels
+    int srcbits, srcchannels;
+    int outbits, outchannels;
+} kernel;
+
+static const kernel kernels[] = {
+    { "MV_Mix8BitMono",             MV_Mix8BitMono,             MV_ResampleNearest, 8,  1, 8,  1 },
+    { "MV_Mix8BitStereo",           MV_Mix8BitStereo,           MV_ResampleNearest, 8,  1, 8,  2 },
+    { "MV_Mix16BitMono",            MV_Mix16BitMono,            MV_ResampleNearest, 8,  1, 16, 1 },
+    { "MV_Mix16BitStereo",          MV_Mix16BitStereo,          MV_ResampleNearest, 8,  1, 16, 2 },
+    { "MV_Mix8BitMono16",           MV_Mix8BitMono16,           MV_ResampleNearest, 16, 1, 8,  1 },
+    { "MV_Mix8BitStereo16",         MV_Mix8BitStereo16,         MV_ResampleNearest, 16, 1, 8,  2 },
+    { "MV_Mix16BitMono16",          MV_Mix16BitMono16,          MV_ResampleNearest, 16, 1, 16, 1 },
+    { "MV_Mix16BitStereo16",        MV_Mix16BitStereo16,        MV_ResampleNearest, 16, 1, 16, 2 },
+    { "MV_Mix8BitMono8Stereo",      MV_Mix8BitMono8Stereo,      MV_ResampleNearest, 8,  2, 8,  1 },
+    { "MV_Mix8BitStereo8Stereo",    MV_Mix8BitStereo8Stereo,    MV_ResampleNearest, 8,  2, 8,  2 },
+    { "MV_Mix16BitMono8Stereo",     MV_Mix16BitMono8Stereo,     MV_ResampleNearest, 8,  2, 16, 1 },
+    { "MV_Mix16BitStereo8Stereo",   MV_Mix16BitStereo8Stereo,   MV_ResampleNearest, 8,  2, 16, 2 },
+    { "MV_Mix8BitMono16Stereo",     MV_Mix8BitMono16Stereo,     MV_ResampleNearest, 16, 2, 8,  1 },
+    { "MV_Mix8BitStereo16Stereo",   MV_Mix8BitStereo16Stereo,   MV_ResampleNearest, 16, 2, 8,  2 },
+    { "MV_Mix16BitMono16Stereo",    MV_Mix16BitMono16Stereo,    MV_ResampleNearest, 16, 2, 16, 1 },
+    { "MV_Mix16BitStereo16Stereo",  MV_Mix16BitStereo16Stereo,  MV_ResampleNearest, 16, 2, 16, 2 },
+
+    // the interpolating resamplers feed a 16-bit kernel through MV_MixResampled
+    { "MV_MixResampled/linear",     MV_Mix16BitStereo16,        MV_ResampleLinear,  16, 1, 16, 2 },
+    { "MV_MixResampled/cubic",      MV_Mix16BitStereo16,        MV_ResampleCubic,   16, 1, 16, 2 },
+    { "MV_MixResampled/sinc",       MV_Mix16BitStereo16,        MV_ResampleSinc,    16, 1, 16, 2 },
+    { "MV_MixResampled/sinc-st",    MV_Mix16BitStereo16Stereo,  MV_ResampleSinc,    16, 2, 16, 2 },
+};
+
+typedef struct {
+    const char * name;
+    unsigned int rate;      // 16.16 step through the source
+    int quietright;
+} benchcase;
+
+static const benchcase cases[] = {
+    { "unity",  0x10000, 0 },
+    { "down",   0x0b852, 0 },   // 0.72, e.g. 32kHz source pitched down
+    { "up",     0x1c000, 0 },   // 1.75
+    { "quiet",  0x10000, 1 },
+};
+
+static Volume_LUT tables;
+static char source[(PAGEFRAMES * 2 + 16) * 4];
+static char dest[PAGEFRAMES * 4];
+
+
+static double now(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER freq, count;
+
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (double) count.QuadPart * 1e9 / freq.QuadPart;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+#endif
+}
+
+// Volume and clip tables as MV_CalcVolume builds them for the output size
+static void maketables(int outbits)
+{
+    int level, i;
+
+    for (i = 0; i < 128; i++) {
+        tables.harshclip_table[i] = 0;
+        tables.harshclip_table[i + 384] = (char) 255;
+    }
+    for (i = 0; i < 256; i++) {
+        tables.harshclip_table[i + 128] = i;
+    }
+
+    for (level = 0; level <= MV_MaxVolume; level++) {
+        for (i = 0; i < 256; i++) {
+            if (outbits == 16) {
+                tables.volume_table[level][i] = (i * 256 - 0x8000) * level / MV_MaxVolume;
+            } else {
+                tables.volume_table[level][i] = (i - 0x80) * level / MV_MaxVolume;
+            }
+        }
+    }
+
+    MV_HarshClipTable = tables.harshclip_table;
+}
+
+static void makesource(void)
+{
+    unsigned int seed = 1;
+    int i, v = 0;
+
+    // a bounded random walk, so neither the source nor the clipping is trivial
+    for (i = 0; i < (int) sizeof(source) / 2; i++) {
+        seed = seed * 1103515245 + 12345;
+        v += (int) ((seed >> 16) & 0x7ff) - 0x400;
+        v = v > 24000 ? 24000 : (v < -24000 ? -24000 : v);
+        ((short *) source)[i] = (short) v;
+    }
+}
+
+static void mixpage(const kernel * k, const benchcase * c, VoiceNode * voice)
+{
+    uint64_t position = 0;
+    int framesize = k->srcchannels * k->srcbits / 8;
+    int block;
+
+    MV_MixDestination = dest;
+    for (block = 0; block < BLOCKS; block++) {
+        if (k->resampler == MV_ResampleNearest) {
+            k->func((unsigned int) (position >> 16) & 0xffff, c->rate,
+                    source + (position >> 32) * framesize, MixBufferSize);
+        } else {
+            MV_MixResampled(voice, position, (uint64_t) c->rate << 16, MixBufferSize);
+        }
+        position += (uint64_t) c->rate * MixBufferSize << 16;
+    }
+}
+
+static int comparedoubles(const void * a, const void * b)
+{
+    double da = *(const double *) a, db = *(const double *) b;
+
+    return da < db ? -1 : (da > db ? 1 : 0);
+}
+
+static int wanted(const char * name, char ** filters, int numfilters)
+{
+    int i;
+
+    if (numfilters == 0) {
+        return 1;
+    }
+    for (i = 0; i < numfilters; i++) {
+        if (strstr(name, filters[i])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char ** argv)
+{
+    int warmup = 20, reps = 200, csv = 0;
+    double * times, p50, p90, p99, start;
+    VoiceNode voice;
+    const kernel * k;
+    const benchcase * c;
+    int i, ki, ci, r;
+
+    for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+        if (argv[i][1] == 'c') {
+            csv = 1;
+        } else if (argv[i][1] == 'w' && i + 1 < argc) {
+            warmup = atoi(argv[++i]);
+        } else if (argv[i][1] == 'n' && i + 1 < argc) {
+            reps = atoi(argv[++i]);
+        } else {
+            reps = 0;
+            break;
+        }
+    }
+
+    if (reps < 1 || warmup < 0) {
+        fprintf(stderr, "usage: %s [-w warmup] [-n repetitions] [-c] [kernel ...]\n", argv[0]);
+        return 1;
+    }
+
+    times = (double *) malloc(reps * sizeof(double));
+    if (!times) {
+        return 1;
+    }
+
+    MV_InitResamplers();
+    makesource();
+
+    if (csv) {
+        printf("kernel,case,p50_ns_per_frame,p90_ns_per_frame,p99_ns_per_frame,frames_per_sec\n");
+    } else {
+        printf("%-28s %-6s %10s %10s %10s %12s\n", "kernel", "case",
+               "p50 ns", "p90 ns", "p99 ns", "Mframes/s");
+    }
+
+    for (ki = 0; ki < (int) (sizeof(kernels) / sizeof(kernels[0])); ki++) {
+        k = &kernels[ki];
+        if (!wanted(k->name, argv + i, argc - i)) {
+            continue;
+        }
+
+        maketables(k->outbits);
+        MV_SampleSize = k->outchannels * k->outbits / 8;
+        MV_RightChannelOffset = k->outchannels == 2 ? MV_SampleSize / 2 : 0;
+
+        memset(&voice, 0, sizeof(voice));
+        voice.sound = source;
+        voice.bits = k->srcbits;
+        voice.channels = k->srcchannels;
+        voice.length = (uint64_t) (sizeof(source) / (k->srcchannels * k->srcbits / 8)) << 32;
+        voice.resampler = k->resampler;
+        voice.mix = k->func;
+        voice.mixresampled = k->func;
+
+        for (ci = 0; ci < (int) (sizeof(cases) / sizeof(cases[0])); ci++) {
+            c = &cases[ci];
+
+            // the resamplers take the plain kernel's path at unity rate
+            if (k->resampler != MV_ResampleNearest && c->rate == 0x10000) {
+                continue;
+            }
+
+            MV_LeftVolume = tables.volume_table[MV_MaxVolume];
+            MV_RightVolume = tables.volume_table[c->quietright ? 0 : MV_MaxVolume];
+
+            for (r = -warmup; r < reps; r++) {
+                memset(dest, k->outbits == 8 ? 0x80 : 0, sizeof(dest));
+                start = now();
+                mixpage(k, c, &voice);
+                if (r >= 0) {
+                    times[r] = (now() - start) / PAGEFRAMES;
+                }
+            }
+
+            qsort(times, reps, sizeof(double), comparedoubles);
+            p50 = times[reps / 2];
+            p90 = times[reps * 90 / 100];
+            p99 = times[reps * 99 / 100];
+
+            if (csv) {
+                printf("%s,%s,%.3f,%.3f,%.3f,%.0f\n", k->name, c->name,
+                       p50, p90, p99, 1e9 / p50);
+            } else {
+                printf("%-28s %-6s %10.3f %10.3f %10.3f %12.1f\n", k->name, c->name,
+                       p50, p90, p99, 1e3 / p50);
+            }
+        }
+    }
+
+    free(times);
+    return 0;
+}
@@ -31,6 +31,7 @@
 #include <pthread.h>
 #include "midifuncs.h"
 #include "driver_coreaudio.h"
+#include "trace.h"
 
 enum {
     CAErr_Warning = -2,
@@ -91,9 +92,11 @@ static OSStatus pcmService(
 {
     UInt32 remaining, len, bufn;
     char *ptr, *sptr;
+    TraceSpan span;
     
     if (MixCallBack == 0) return noErr;
 
+    TRACE_BEGIN(span);
     CoreAudioDrv_PCM_Lock();
     for (bufn = 0; bufn < ioData->mNumberBuffers; bufn++) {
         remaining = ioData->mBuffers[bufn].mDataByteSize;
@@ -127,6 +130,7 @@ static OSStatus pcmService(
         }
     }
     CoreAudioDrv_PCM_Unlock();
+    TRACE_END(span, "CoreAudio callback", 0);
 
     return noErr;
 }
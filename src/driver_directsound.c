@@ -31,6 +31,7 @@
 #include <stdio.h>
 
 #include "driver_directsound.h"
+#include "trace.h"
 
 enum {
    DSErr_Warning = -2,
@@ -151,6 +152,7 @@ static DWORD WINAPI fillDataThread(LPVOID lpParameter)
 {
     HANDLE handles[3];
     DWORD waitret, waitret2;
+    TraceSpan span;
     
     handles[0] = notifyPositions[0].hEventNotify;
     handles[1] = notifyPositions[1].hEventNotify;
@@ -161,10 +163,12 @@ static DWORD WINAPI fillDataThread(LPVOID lpParameter)
         switch (waitret) {
             case WAIT_OBJECT_0:
             case WAIT_OBJECT_0+1:
+                TRACE_BEGIN(span);
                 waitret2 = WaitForSingleObject(mutex, INFINITE);
                 if (waitret2 == WAIT_OBJECT_0) {
                     FillBuffer(WAIT_OBJECT_0 + 1 - waitret);
                     ReleaseMutex(mutex);
+                    TRACE_END(span, "DirectSound callback", 0);
                 } else {
                     fprintf(stderr, "DirectSound fillDataThread: wfso err %d\n", (int) waitret2);
                 }
@@ -0,0 +1,348 @@
+/*
+ Copyright (C) 2009 Jonathon Fowler <jf@jonof.id.au>
+ 
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ 
+ See the GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ 
+ */
+ 
+/**
+ * WAV file and null output driver for MultiVoc
+ *
+ * Mixing runs on a thread of its own, either paced to the wall clock
+ * like a sound card would or as fast as the mixer can go. Pass an
+ * ASS_FileSinkOptions as the initdata to choose; without one the output
+ * is counted and discarded as fast as it mixes.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "sndcards.h"
+#include "asssys.h"
+#include "driver_filesink.h"
+#include "trace.h"
+
+#ifdef __POWERPC__
+# define BIGENDIAN
+#endif
+
+enum {
+    FileSinkErr_Warning = -2,
+    FileSinkErr_Error   = -1,
+    FileSinkErr_Ok      = 0,
+    FileSinkErr_Uninitialised,
+    FileSinkErr_BadFormat,
+    FileSinkErr_OpenFile,
+    FileSinkErr_CreateMutex,
+    FileSinkErr_CreateThread
+};
+
+static int ErrorCode = FileSinkErr_Ok;
+static int Initialised = 0;
+static int Playing = 0;
+
+static ASS_FileSinkOptions *Options = 0;
+static FILE *OutFile = 0;
+static unsigned int OutBytes = 0;
+static int MixRate = 0;
+static int FrameSize = 0;
+static int SampleBits = 0;
+
+static ASS_Mutex *Mutex = 0;
+static ASS_Thread *Thread = 0;
+static volatile int StopThread = 0;
+
+static char *MixBuffer = 0;
+static int MixBufferSize = 0;
+static int MixBufferCount = 0;
+static int MixBufferCurrent = 0;
+static void ( *MixCallBack )( void ) = 0;
+
+
+static void writeLE32(unsigned char * p, unsigned int v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static void writeHeader(void)
+{
+    unsigned char header[44];
+
+    memcpy(header, "RIFF", 4);
+    writeLE32(header + 4, 36 + OutBytes);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    writeLE32(header + 16, 16);
+    writeLE32(header + 20, 1 | ((FrameSize * 8 / SampleBits) << 16));
+    writeLE32(header + 24, MixRate);
+    writeLE32(header + 28, MixRate * FrameSize);
+    writeLE32(header + 32, FrameSize | (SampleBits << 16));
+    memcpy(header + 36, "data", 4);
+    writeLE32(header + 40, OutBytes);
+
+    fseek(OutFile, 0, SEEK_SET);
+    fwrite(header, 1, sizeof(header), OutFile);
+    fseek(OutFile, 0, SEEK_END);
+}
+
+static void writeData(const char * ptr, int len)
+{
+#ifdef BIGENDIAN
+    if (SampleBits == 16) {
+        char swapped[1024];
+        int i, n;
+
+        while (len > 0) {
+            n = len < (int) sizeof(swapped) ? len : (int) sizeof(swapped);
+            for (i = 0; i < n; i += 2) {
+                swapped[i] = ptr[i + 1];
+                swapped[i + 1] = ptr[i];
+            }
+            fwrite(swapped, 1, n, OutFile);
+            ptr += n;
+            len -= n;
+        }
+        return;
+    }
+#endif
+    fwrite(ptr, 1, len, OutFile);
+}
+
+static int mixThread(void * arg)
+{
+    unsigned int start = ASS_GetTicks();
+    unsigned int produced = 0, allowed;
+    int frames = MixBufferSize / FrameSize;
+    char *sptr;
+    TraceSpan span;
+
+    while (!StopThread) {
+        if (Options && Options->realtime) {
+            // stay no more than the whole ring ahead of the clock
+            allowed = (unsigned int) ((unsigned long long) (ASS_GetTicks() - start) *
+                MixRate / 1000) + MixBufferCount * frames;
+            if (produced >= allowed) {
+                ASS_Sleep(1);
+                continue;
+            }
+        }
+
+        TRACE_BEGIN(span);
+        ASS_LockMutex(Mutex);
+
+        MixCallBack();
+
+        MixBufferCurrent++;
+        if (MixBufferCurrent >= MixBufferCount) {
+            MixBufferCurrent -= MixBufferCount;
+        }
+        sptr = MixBuffer + (MixBufferCurrent * MixBufferSize);
+
+        ASS_UnlockMutex(Mutex);
+        TRACE_END(span, "FileSink callback", 0);
+
+        // the driver owns this page until the mixer comes back around to it
+        if (OutFile) {
+            writeData(sptr, MixBufferSize);
+            OutBytes += MixBufferSize;
+        }
+
+        produced += frames;
+        if (Options) {
+            Options->frames += frames;
+        }
+    }
+
+    return 0;
+}
+
+
+int FileSinkDrv_GetError(void)
+{
+    return ErrorCode;
+}
+
+const char *FileSinkDrv_ErrorString( int ErrorNumber )
+{
+    const char *ErrorString;
+
+    switch( ErrorNumber ) {
+        case FileSinkErr_Warning :
+        case FileSinkErr_Error :
+            ErrorString = FileSinkDrv_ErrorString( ErrorCode );
+            break;
+
+        case FileSinkErr_Ok :
+            ErrorString = "File sink ok.";
+            break;
+
+        case FileSinkErr_Uninitialised:
+            ErrorString = "File sink uninitialised.";
+            break;
+
+        case FileSinkErr_BadFormat:
+            ErrorString = "File sink: unsupported sample format.";
+            break;
+
+        case FileSinkErr_OpenFile:
+            ErrorString = "File sink: could not create the output file.";
+            break;
+
+        case FileSinkErr_CreateMutex:
+            ErrorString = "File sink: could not create the mix mutex.";
+            break;
+
+        case FileSinkErr_CreateThread:
+            ErrorString = "File sink: could not create the mix thread.";
+            break;
+
+        default:
+            ErrorString = "Unknown file sink error code.";
+            break;
+    }
+
+    return ErrorString;
+}
+
+int FileSinkDrv_PCM_Init(int * mixrate, int * numchannels, int * samplebits, void * initdata)
+{
+    if (Initialised) {
+        FileSinkDrv_PCM_Shutdown();
+    }
+
+    if ((*numchannels != 1 && *numchannels != 2) ||
+        (*samplebits != 8 && *samplebits != 16) || *mixrate <= 0) {
+        ErrorCode = FileSinkErr_BadFormat;
+        return FileSinkErr_Error;
+    }
+
+    Options = (ASS_FileSinkOptions *) initdata;
+    MixRate = *mixrate;
+    SampleBits = *samplebits;
+    FrameSize = *numchannels * *samplebits / 8;
+    OutBytes = 0;
+
+    Mutex = ASS_CreateMutex();
+    if (!Mutex) {
+        ErrorCode = FileSinkErr_CreateMutex;
+        return FileSinkErr_Error;
+    }
+
+    if (Options && Options->filename) {
+        OutFile = fopen(Options->filename, "wb");
+        if (!OutFile) {
+            ASS_DestroyMutex(Mutex);
+            Mutex = 0;
+            ErrorCode = FileSinkErr_OpenFile;
+            return FileSinkErr_Error;
+        }
+        writeHeader();
+    }
+
+    if (Options) {
+        Options->frames = 0;
+    }
+
+    Initialised = 1;
+
+    return FileSinkErr_Ok;
+}
+
+void FileSinkDrv_PCM_Shutdown(void)
+{
+    if (!Initialised) {
+        return;
+    }
+
+    if (Playing) {
+        FileSinkDrv_PCM_StopPlayback();
+    }
+
+    if (OutFile) {
+        writeHeader();
+        fclose(OutFile);
+        OutFile = 0;
+    }
+
+    ASS_DestroyMutex(Mutex);
+    Mutex = 0;
+    Options = 0;
+
+    Initialised = 0;
+}
+
+int FileSinkDrv_PCM_BeginPlayback(char *BufferStart, int BufferSize,
+                        int NumDivisions, void ( *CallBackFunc )( void ) )
+{
+    if (!Initialised) {
+        ErrorCode = FileSinkErr_Uninitialised;
+        return FileSinkErr_Error;
+    }
+
+    if (Playing) {
+        FileSinkDrv_PCM_StopPlayback();
+    }
+
+    MixBuffer = BufferStart;
+    MixBufferSize = BufferSize;
+    MixBufferCount = NumDivisions;
+    MixBufferCurrent = 0;
+    MixCallBack = CallBackFunc;
+
+    // prime the buffer
+    MixCallBack();
+
+    StopThread = 0;
+    Thread = ASS_CreateThread(mixThread, 0);
+    if (!Thread) {
+        ErrorCode = FileSinkErr_CreateThread;
+        return FileSinkErr_Error;
+    }
+
+    Playing = 1;
+
+    return FileSinkErr_Ok;
+}
+
+void FileSinkDrv_PCM_StopPlayback(void)
+{
+    if (!Initialised || !Playing) {
+        return;
+    }
+
+    StopThread = 1;
+    ASS_WaitThread(Thread);
+    Thread = 0;
+
+    if (OutFile) {
+        writeHeader();
+        fflush(OutFile);
+    }
+
+    Playing = 0;
+}
+
+void FileSinkDrv_PCM_Lock(void)
+{
+    ASS_LockMutex(Mutex);
+}
+
+void FileSinkDrv_PCM_Unlock(void)
+{
+    ASS_UnlockMutex(Mutex);
+}
+
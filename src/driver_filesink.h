@@ -0,0 +1,31 @@
+/*
+ Copyright (C) 2009 Jonathon Fowler <jf@jonof.id.au>
+ 
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ 
+ See the GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ 
+ */
+
+
+int FileSinkDrv_GetError(void);
+const char *FileSinkDrv_ErrorString( int ErrorNumber );
+
+int  FileSinkDrv_PCM_Init(int * mixrate, int * numchannels, int * samplebits, void * initdata);
+void FileSinkDrv_PCM_Shutdown(void);
+int  FileSinkDrv_PCM_BeginPlayback(char *BufferStart, int BufferSize,
+                 int NumDivisions, void ( *CallBackFunc )( void ) );
+void FileSinkDrv_PCM_StopPlayback(void);
+void FileSinkDrv_PCM_Lock(void);
+void FileSinkDrv_PCM_Unlock(void);
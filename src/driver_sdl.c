@@ -28,6 +28,7 @@
 # include <SDL.h>
 #endif
 #include "driver_sdl.h"
+#include "trace.h"
 
 enum {
     SDLErr_Warning = -2,
@@ -65,6 +66,9 @@ static void fillData(void * userdata, Uint8 * ptr, int remaining)
 {
     int len;
     char *sptr;
+    TraceSpan span;
+
+    TRACE_BEGIN(span);
 
     while (remaining > 0) {
         if (MixBufferUsed == MixBufferSize) {
@@ -92,6 +96,8 @@ static void fillData(void * userdata, Uint8 * ptr, int remaining)
             remaining -= len;
         }
     }
+
+    TRACE_END(span, "SDL callback", 0);
 }
 
 
@@ -33,6 +33,7 @@
 #include <assert.h>
 
 #include "midifuncs.h"
+#include "asssys.h"
 #include "driver_winmm.h"
 #include "linklist.h"
 
@@ -473,7 +474,7 @@ static void midi_dispose_buffer(MidiBuffer * node, const char * caller)
         //fprintf(stderr, "WinMM %s/midi_dispose_buffer recycling buffer %p\n", caller, node);
     } else {
         // when not, we throw them away
-        free(node);
+        ASS_Free(node);
         //fprintf(stderr, "WinMM %s/midi_dispose_buffer freeing buffer %p\n", caller, node);
     }
 }
@@ -507,7 +508,7 @@ static void midi_free_buffers(void)
     for ( node = spareMidiBuffers.next; node != &spareMidiBuffers; node = next ) {
         next = node->next;
         LL_Remove( node, next, prev );
-        free(node);
+        ASS_Free(node);
         //fprintf(stderr, "WinMM midi_free_buffers freeing buffer %p\n", node);
     }
     
@@ -694,7 +695,7 @@ static BOOL midi_get_buffer(int length, unsigned char ** data)
             size = datalen;
         }
         
-        node = (MidiBuffer *) malloc( sizeof(MidiBuffer) + size );
+        node = (MidiBuffer *) ASS_Alloc( ASS_MemMIDI, sizeof(MidiBuffer) + size );
         if (node == 0) {
             return FALSE;
         }
@@ -26,6 +26,7 @@
 #include "drivers.h"
 
 #include "driver_nosound.h"
+#include "driver_filesink.h"
 
 #ifdef HAVE_SDL
 # include "driver_sdl.h"
@@ -254,6 +255,22 @@ static struct {
     #else
         UNSUPPORTED_COMPLETELY
     #endif
+
+    // WAV file or null output, mixed on a thread of its own
+    {
+        "File Sink",
+        FileSinkDrv_GetError,
+        FileSinkDrv_ErrorString,
+        FileSinkDrv_PCM_Init,
+        FileSinkDrv_PCM_Shutdown,
+        FileSinkDrv_PCM_BeginPlayback,
+        FileSinkDrv_PCM_StopPlayback,
+        FileSinkDrv_PCM_Lock,
+        FileSinkDrv_PCM_Unlock,
+
+        UNSUPPORTED_CD,
+        UNSUPPORTED_MIDI,
+    },
 };
 
 
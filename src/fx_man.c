@@ -42,6 +42,7 @@ MidSongOptions options;
 #include "drivers.h"
 #include "multivoc.h"
 #include "fx_man.h"
+#include "journal.h"
 
 #define TRUE  ( 1 == 1 )
 #define FALSE ( !TRUE )
@@ -49,6 +50,12 @@ MidSongOptions options;
 int FX_ErrorCode = FX_Ok;
 int FX_Installed = FALSE;
 
+// what FX_Init was last given, for a journal started later
+static int FX_InitVoices;
+static int FX_InitChannels;
+static int FX_InitBits;
+static int FX_InitRate;
+
 #define FX_SetErrorCode( status ) \
    FX_ErrorCode = ( status );
 
@@ -97,6 +104,10 @@ const char *FX_ErrorString
          ErrorString = MV_ErrorString( MV_Error );
          break;
 
+      case FX_JournalError :
+         ErrorString = "Unable to open the journal file.";
+         break;
+
       default :
          ErrorString = "Unknown Fx error code.";
          break;
@@ -165,6 +176,13 @@ int FX_Init
    if ( status == FX_Ok )
       {
       FX_Installed = TRUE;
+
+      FX_InitVoices   = numvoices;
+      FX_InitChannels = *numchannels;
+      FX_InitBits     = *samplebits;
+      FX_InitRate     = *mixrate;
+      JOURNAL_Call( JOURNAL_Init, status, 4, numvoices, *numchannels,
+         *samplebits, *mixrate );
       }
 
 #ifdef HAVE_TIMIDITY
@@ -205,6 +223,7 @@ int FX_Shutdown
       }
 
 	status = MV_Shutdown();
+	JOURNAL_Call( JOURNAL_Shutdown, status, 0 );
 	if ( status != MV_Ok )
 		{
 		FX_SetErrorCode( FX_MultiVocError );
@@ -267,6 +286,7 @@ void FX_SetVolume
 
    {
 	MV_SetVolume( volume );
+	JOURNAL_Call( JOURNAL_SetVolume, 0, 1, volume );
    }
 
 
@@ -303,6 +323,7 @@ void FX_SetReverseStereo
 
    {
    MV_SetReverseStereo( setting );
+   JOURNAL_Call( JOURNAL_SetReverseStereo, 0, 1, setting );
    }
 
 
@@ -335,6 +356,7 @@ void FX_SetReverb
 
    {
    MV_SetReverb( reverb );
+   JOURNAL_Call( JOURNAL_SetReverb, 0, 1, reverb );
    }
 
 
@@ -351,6 +373,7 @@ void FX_SetFastReverb
 
    {
    MV_SetFastReverb( reverb );
+   JOURNAL_Call( JOURNAL_SetFastReverb, 0, 1, reverb );
    }
 
 
@@ -399,6 +422,7 @@ void FX_SetReverbDelay
 
    {
    MV_SetReverbDelay( delay );
+   JOURNAL_Call( JOURNAL_SetReverbDelay, 0, 1, delay );
    }
 
 
@@ -433,6 +457,7 @@ int FX_EndLooping
    int status;
 
    status = MV_EndLooping( handle );
+   JOURNAL_Call( JOURNAL_EndLooping, status, 1, handle );
    if ( status == MV_Error )
       {
       FX_SetErrorCode( FX_MultiVocError );
@@ -461,6 +486,7 @@ int FX_SetPan
    int status;
 
    status = MV_SetPan( handle, vol, left, right );
+   JOURNAL_Call( JOURNAL_SetPan, status, 4, handle, vol, left, right );
    if ( status == MV_Error )
       {
       FX_SetErrorCode( FX_MultiVocError );
@@ -487,6 +513,7 @@ int FX_SetPitch
    int status;
 
    status = MV_SetPitch( handle, pitchoffset );
+   JOURNAL_Call( JOURNAL_SetPitch, status, 2, handle, pitchoffset );
    if ( status == MV_Error )
       {
       FX_SetErrorCode( FX_MultiVocError );
@@ -498,21 +525,23 @@ int FX_SetPitch
 
 
 /*---------------------------------------------------------------------
-   Function: FX_SetFrequency
+   Function: FX_SetVoiceResampler
 
-   Sets the frequency of the voice associated with the specified handle.
+   Sets how the voice associated with the specified handle is
+   resampled: one of the FX_Resample values.
 ---------------------------------------------------------------------*/
 
-int FX_SetFrequency
+int FX_SetVoiceResampler
    (
    int handle,
-   int frequency
+   int resampler
    )
 
    {
    int status;
 
-   status = MV_SetFrequency( handle, frequency );
+   status = MV_SetVoiceResampler( handle, resampler );
+   JOURNAL_Call( JOURNAL_SetVoiceResampler, status, 2, handle, resampler );
    if ( status == MV_Error )
       {
       FX_SetErrorCode( FX_MultiVocError );
@@ -524,378 +553,910 @@ int FX_SetFrequency
 
 
 /*---------------------------------------------------------------------
-   Function: FX_PlayVOC
+   Function: FX_SetDefaultResampler
 
-   Begin playback of sound data with the given volume and priority.
+   Sets the resampler voices started from now on will use.
 ---------------------------------------------------------------------*/
 
-int FX_PlayVOC
+int FX_SetDefaultResampler
    (
-   char *ptr,
-   unsigned int ptrlength,
-   int pitchoffset,
-   int vol,
-   int left,
-   int right,
-   int priority,
-   unsigned int callbackval
+   int resampler
    )
 
    {
-   int handle;
+   int status;
 
-   handle = MV_PlayVOC( ptr, ptrlength, pitchoffset, vol, left, right,
-      priority, callbackval );
-   if ( handle < MV_Ok )
+   status = MV_SetDefaultResampler( resampler );
+   JOURNAL_Call( JOURNAL_SetDefaultResampler, status, 1, resampler );
+   if ( status == MV_Error )
       {
       FX_SetErrorCode( FX_MultiVocError );
-      handle = FX_Warning;
+      status = FX_Warning;
       }
 
-   return( handle );
+   return( status );
    }
 
 
 /*---------------------------------------------------------------------
-   Function: FX_PlayLoopedVOC
+   Function: FX_GetDefaultResampler
 
-   Begin playback of sound data with the given volume and priority.
+   Returns the resampler new voices use.
 ---------------------------------------------------------------------*/
 
-int FX_PlayLoopedVOC
+int FX_GetDefaultResampler
    (
-   char *ptr,
-   unsigned int ptrlength,
-   int loopstart,
-   int loopend,
-   int pitchoffset,
-   int vol,
-   int left,
-   int right,
-   int priority,
-   unsigned int callbackval
+   void
    )
 
    {
-   int handle;
-
-   handle = MV_PlayLoopedVOC( ptr, ptrlength, loopstart, loopend, pitchoffset,
-      vol, left, right, priority, callbackval );
-   if ( handle < MV_Ok )
-      {
-      FX_SetErrorCode( FX_MultiVocError );
-      handle = FX_Warning;
-      }
-
-   return( handle );
+   return MV_GetDefaultResampler();
    }
 
 
 /*---------------------------------------------------------------------
-   Function: FX_PlayWAV
+   Function: FX_SetFrequency
 
-   Begin playback of sound data with the given volume and priority.
+   Sets the frequency of the voice associated with the specified handle.
 ---------------------------------------------------------------------*/
 
-int FX_PlayWAV
+int FX_SetFrequency
    (
-   char *ptr,
-   unsigned int ptrlength,
-   int pitchoffset,
-   int vol,
-   int left,
-   int right,
-   int priority,
-   unsigned int callbackval
+   int handle,
+   int frequency
    )
 
    {
-   int handle;
+   int status;
 
-   handle = MV_PlayWAV( ptr, ptrlength, pitchoffset, vol, left, right,
-      priority, callbackval );
-   if ( handle < MV_Ok )
+   status = MV_SetFrequency( handle, frequency );
+   JOURNAL_Call( JOURNAL_SetFrequency, status, 2, handle, frequency );
+   if ( status == MV_Error )
       {
       FX_SetErrorCode( FX_MultiVocError );
-      handle = FX_Warning;
+      status = FX_Warning;
       }
 
-   return( handle );
+   return( status );
    }
 
 
 /*---------------------------------------------------------------------
-   Function: FX_PlayWAV
+   Function: FX_SetMixRateDivisor
 
-   Begin playback of sound data with the given volume and priority.
+   Mixes voices at the device rate divided by 1, 2 or 4.
 ---------------------------------------------------------------------*/
 
-int FX_PlayLoopedWAV
+int FX_SetMixRateDivisor
    (
-   char *ptr,
-   unsigned int ptrlength,
-   int loopstart,
-   int loopend,
-   int pitchoffset,
-   int vol,
-   int left,
-   int right,
-   int priority,
-   unsigned int callbackval
+   int divisor
    )
 
    {
-   int handle;
+   int status;
 
-   handle = MV_PlayLoopedWAV( ptr, ptrlength, loopstart, loopend,
-      pitchoffset, vol, left, right, priority, callbackval );
-   if ( handle < MV_Ok )
+   status = MV_SetMixRateDivisor( divisor );
+   JOURNAL_Call( JOURNAL_SetMixRateDivisor, status, 1, divisor );
+   if ( status == MV_Error )
       {
       FX_SetErrorCode( FX_MultiVocError );
-      handle = FX_Warning;
+      status = FX_Warning;
       }
 
-   return( handle );
+   return( status );
    }
 
 
 /*---------------------------------------------------------------------
-   Function: FX_PlayVOC3D
+   Function: FX_GetMixRateDivisor
 
-   Begin playback of sound data at specified angle and distance
-   from listener.
+   Returns what the device rate is divided by for mixing.
 ---------------------------------------------------------------------*/
 
-int FX_PlayVOC3D
+int FX_GetMixRateDivisor
    (
-   char *ptr,
-   unsigned int ptrlength,
-   int pitchoffset,
-   int angle,
-   int distance,
-   int priority,
-   unsigned int callbackval
+   void
    )
 
    {
-   int handle;
-
-   handle = MV_PlayVOC3D( ptr, ptrlength, pitchoffset, angle, distance,
-      priority, callbackval );
-   if ( handle < MV_Ok )
-      {
-      FX_SetErrorCode( FX_MultiVocError );
-      handle = FX_Warning;
-      }
-
-   return( handle );
+   return MV_GetMixRateDivisor();
    }
 
 
 /*---------------------------------------------------------------------
-   Function: FX_PlayWAV3D
+   Function: FX_SetVoiceLOD
 
-   Begin playback of sound data at specified angle and distance
-   from listener.
+   Mixes voices quieter than the threshold at a reduced rate.
 ---------------------------------------------------------------------*/
 
-int FX_PlayWAV3D
+int FX_SetVoiceLOD
    (
-   char *ptr,
-   unsigned int ptrlength,
-   int pitchoffset,
-   int angle,
-   int distance,
-   int priority,
-   unsigned int callbackval
+   int threshold,
+   int divisor
    )
 
    {
-   int handle;
+   int status;
 
-   handle = MV_PlayWAV3D( ptr, ptrlength, pitchoffset, angle, distance,
-      priority, callbackval );
-   if ( handle < MV_Ok )
+   status = MV_SetVoiceLOD( threshold, divisor );
+   JOURNAL_Call( JOURNAL_SetVoiceLOD, status, 2, threshold, divisor );
+   if ( status == MV_Error )
       {
       FX_SetErrorCode( FX_MultiVocError );
-      handle = FX_Warning;
+      status = FX_Warning;
       }
 
-   return( handle );
+   return( status );
    }
 
 
 /*---------------------------------------------------------------------
-   Function: FX_PlayRaw
+   Function: FX_GetVoiceLOD
 
-   Begin playback of raw sound data with the given volume and priority.
+   Returns the volume below which voices are mixed at a reduced rate.
 ---------------------------------------------------------------------*/
 
-int FX_PlayRaw
+int FX_GetVoiceLOD
    (
-   char *ptr,
-   unsigned int length,
-   unsigned rate,
-   int pitchoffset,
-   int vol,
-   int left,
-   int right,
-   int priority,
-   unsigned int callbackval
+   void
    )
 
    {
-   int handle;
-
-   handle = MV_PlayRaw( ptr, length, rate, pitchoffset,
-      vol, left, right, priority, callbackval );
-   if ( handle < MV_Ok )
-      {
-      FX_SetErrorCode( FX_MultiVocError );
-      handle = FX_Warning;
-      }
-
-   return( handle );
+   return MV_GetVoiceLOD();
    }
 
 
 /*---------------------------------------------------------------------
-   Function: FX_PlayLoopedRaw
+   Function: FX_GetMixedFrames
 
-   Begin playback of raw sound data with the given volume and priority.
+   Returns how many output frames the mixer has produced.
 ---------------------------------------------------------------------*/
 
-int FX_PlayLoopedRaw
+unsigned int FX_GetMixedFrames
    (
-   char *ptr,
-   unsigned int length,
-   char *loopstart,
-   char *loopend,
-   unsigned rate,
-   int pitchoffset,
-   int vol,
-   int left,
-   int right,
-   int priority,
-   unsigned int callbackval
+   void
    )
 
    {
-   int handle;
-
-   handle = MV_PlayLoopedRaw( ptr, length, loopstart, loopend,
-      rate, pitchoffset, vol, left, right, priority, callbackval );
-   if ( handle < MV_Ok )
-      {
-      FX_SetErrorCode( FX_MultiVocError );
-      handle = FX_Warning;
-      }
-
-   return( handle );
+   return MV_GetMixedFrames();
    }
 
 
 /*---------------------------------------------------------------------
-   Function: FX_Pan3D
+   Function: FX_GetStats
 
-   Set the angle and distance from the listener of the voice associated
-   with the specified handle.
+   Fills in the mixer's timing and voice statistics.
 ---------------------------------------------------------------------*/
 
-int FX_Pan3D
+void FX_GetStats
    (
-   int handle,
-   int angle,
-   int distance
+   ASS_MixStats *stats
    )
 
    {
-   int status;
+   MV_GetStats( stats );
+   }
 
-   status = MV_Pan3D( handle, angle, distance );
-   if ( status != MV_Ok )
-      {
-      FX_SetErrorCode( FX_MultiVocError );
-      status = FX_Warning;
-      }
 
-   return( status );
+/*---------------------------------------------------------------------
+   Function: FX_ResetStats
+
+   Clears the mixer's timing and voice statistics.
+---------------------------------------------------------------------*/
+
+void FX_ResetStats
+   (
+   void
+   )
+
+   {
+   MV_ResetStats();
    }
 
 
 /*---------------------------------------------------------------------
-   Function: FX_SoundActive
+   Function: FX_GetLevels
 
-   Tests if the specified sound is currently playing.
+   Fills in the peak, RMS and clipping of the output.
 ---------------------------------------------------------------------*/
 
-int FX_SoundActive
+void FX_GetLevels
    (
-   int handle
+   ASS_OutputLevels *levels
    )
 
    {
-   return( MV_VoicePlaying( handle ) );
+   MV_GetLevels( levels );
    }
 
 
 /*---------------------------------------------------------------------
-   Function: FX_SoundsPlaying
+   Function: FX_ResetLevels
 
-   Reports the number of voices playing.
+   Clears the output levels.
 ---------------------------------------------------------------------*/
 
-int FX_SoundsPlaying
+void FX_ResetLevels
    (
    void
    )
 
    {
-   return( MV_VoicesPlaying() );
+   MV_ResetLevels();
    }
 
 
 /*---------------------------------------------------------------------
-   Function: FX_StopSound
+   Function: FX_GetLatency
 
-   Halts playback of a specific voice
+   Fills in how long voices have taken from the play call to being
+   mixed and to reaching the driver.
 ---------------------------------------------------------------------*/
 
-int FX_StopSound
+void FX_GetLatency
    (
-   int handle
+   ASS_StartLatency *latency
    )
 
    {
-   int status;
-
-   status = MV_Kill( handle );
-   if ( status != MV_Ok )
-      {
-      FX_SetErrorCode( FX_MultiVocError );
-      return( FX_Warning );
-      }
-
-   return( FX_Ok );
+   MV_GetLatency( latency );
    }
 
 
 /*---------------------------------------------------------------------
-   Function: FX_PauseSound
+   Function: FX_ResetLatency
 
-   Pauses or resumes playback of a specific voice
+   Clears the start latency statistics.
 ---------------------------------------------------------------------*/
 
-int FX_PauseSound
+void FX_ResetLatency
    (
-   int handle,
-   int pauseon
+   void
    )
 
    {
-   int status;
-   
-   status = MV_PauseVoice( handle, pauseon );
+   MV_ResetLatency();
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_GetRecentStarts
+
+   Copies out the timings of the last voices to start, newest first.
+---------------------------------------------------------------------*/
+
+int FX_GetRecentStarts
+   (
+   ASS_VoiceStart *starts,
+   int count
+   )
+
+   {
+   return MV_GetRecentStarts( starts, count );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_GetMemoryUsage
+
+   Fills in the memory held by the sound code, now and at its peak, by
+   what it is for.
+---------------------------------------------------------------------*/
+
+void FX_GetMemoryUsage
+   (
+   ASS_MemoryUsage *usage
+   )
+
+   {
+   MV_GetMemoryUsage( usage );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_SetMemoryBudget
+
+   Limits the heap memory the sound code may hold, with 0 for no limit.
+---------------------------------------------------------------------*/
+
+void FX_SetMemoryBudget
+   (
+   unsigned int bytes
+   )
+
+   {
+   MV_SetMemoryBudget( bytes );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_ResetMemoryPeaks
+
+   Brings the peak memory figures down to what is held now.
+---------------------------------------------------------------------*/
+
+void FX_ResetMemoryPeaks
+   (
+   void
+   )
+
+   {
+   MV_ResetMemoryPeaks();
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_SetVoiceProfiling
+
+   Turns the accounting of mixing time to voices on or off, gathered by
+   callback value or registered sound ID.
+---------------------------------------------------------------------*/
+
+int FX_SetVoiceProfiling
+   (
+   int mode
+   )
+
+   {
+   int status;
+
+   status = MV_SetVoiceProfiling( mode );
+   if ( status == MV_Error )
+      {
+      FX_SetErrorCode( FX_MultiVocError );
+      status = FX_Warning;
+      }
+
+   return( status );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_GetVoiceProfiling
+
+   Returns how mixing time is being accounted to voices.
+---------------------------------------------------------------------*/
+
+int FX_GetVoiceProfiling
+   (
+   void
+   )
+
+   {
+   return MV_GetVoiceProfiling();
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_GetVoiceProfile
+
+   Fills in the most expensive voices since the last call, costliest
+   first, and starts a new window.
+---------------------------------------------------------------------*/
+
+int FX_GetVoiceProfile
+   (
+   ASS_VoiceProfile *top,
+   int               count
+   )
+
+   {
+   return MV_GetVoiceProfile( top, count );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_StartTrace
+
+   Begins recording a timeline of the audio code.
+---------------------------------------------------------------------*/
+
+void FX_StartTrace
+   (
+   void
+   )
+
+   {
+   MV_StartTrace();
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_StopTrace
+
+   Stops recording the timeline of the audio code.
+---------------------------------------------------------------------*/
+
+void FX_StopTrace
+   (
+   void
+   )
+
+   {
+   MV_StopTrace();
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_TraceMark
+
+   Puts a named instant on the audio timeline.
+---------------------------------------------------------------------*/
+
+void FX_TraceMark
+   (
+   const char *name
+   )
+
+   {
+   MV_TraceMark( name );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_WriteTrace
+
+   Saves the audio timeline as Chrome trace JSON.
+---------------------------------------------------------------------*/
+
+int FX_WriteTrace
+   (
+   const char *filename
+   )
+
+   {
+   int status;
+
+   status = MV_WriteTrace( filename );
+   if ( status == MV_Error )
+      {
+      FX_SetErrorCode( FX_MultiVocError );
+      status = FX_Error;
+      }
+
+   return( status );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_StartJournal
+
+   Begins writing the calls made into the library to a file that the
+   replay tool can play back.
+---------------------------------------------------------------------*/
+
+int FX_StartJournal
+   (
+   const char *filename
+   )
+
+   {
+   if ( !JOURNAL_Start( filename ) )
+      {
+      FX_SetErrorCode( FX_JournalError );
+      return( FX_Error );
+      }
+
+   // a journal begun mid-session needs the mixer set up before it
+   if ( FX_Installed )
+      {
+      JOURNAL_Call( JOURNAL_Init, FX_Ok, 4, FX_InitVoices, FX_InitChannels,
+         FX_InitBits, FX_InitRate );
+      }
+
+   return( FX_Ok );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_StopJournal
+
+   Finishes the journal file.
+---------------------------------------------------------------------*/
+
+void FX_StopJournal
+   (
+   void
+   )
+
+   {
+   JOURNAL_Stop();
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_PlayVOC
+
+   Begin playback of sound data with the given volume and priority.
+---------------------------------------------------------------------*/
+
+int FX_PlayVOC
+   (
+   char *ptr,
+   unsigned int ptrlength,
+   int pitchoffset,
+   int vol,
+   int left,
+   int right,
+   int priority,
+   unsigned int callbackval
+   )
+
+   {
+   int handle;
+
+   handle = MV_PlayVOC( ptr, ptrlength, pitchoffset, vol, left, right,
+      priority, callbackval );
+   JOURNAL_CallAsset( JOURNAL_PlayVOC, handle, ptr, ptrlength, 6,
+         pitchoffset, vol, left, right, priority, callbackval );
+   if ( handle < MV_Ok )
+      {
+      FX_SetErrorCode( FX_MultiVocError );
+      handle = FX_Warning;
+      }
+
+   return( handle );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_PlayLoopedVOC
+
+   Begin playback of sound data with the given volume and priority.
+---------------------------------------------------------------------*/
+
+int FX_PlayLoopedVOC
+   (
+   char *ptr,
+   unsigned int ptrlength,
+   int loopstart,
+   int loopend,
+   int pitchoffset,
+   int vol,
+   int left,
+   int right,
+   int priority,
+   unsigned int callbackval
+   )
+
+   {
+   int handle;
+
+   handle = MV_PlayLoopedVOC( ptr, ptrlength, loopstart, loopend, pitchoffset,
+      vol, left, right, priority, callbackval );
+   JOURNAL_CallAsset( JOURNAL_PlayLoopedVOC, handle, ptr, ptrlength, 8,
+         loopstart, loopend, pitchoffset, vol, left, right, priority, callbackval );
+   if ( handle < MV_Ok )
+      {
+      FX_SetErrorCode( FX_MultiVocError );
+      handle = FX_Warning;
+      }
+
+   return( handle );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_PlayWAV
+
+   Begin playback of sound data with the given volume and priority.
+---------------------------------------------------------------------*/
+
+int FX_PlayWAV
+   (
+   char *ptr,
+   unsigned int ptrlength,
+   int pitchoffset,
+   int vol,
+   int left,
+   int right,
+   int priority,
+   unsigned int callbackval
+   )
+
+   {
+   int handle;
+
+   handle = MV_PlayWAV( ptr, ptrlength, pitchoffset, vol, left, right,
+      priority, callbackval );
+   JOURNAL_CallAsset( JOURNAL_PlayWAV, handle, ptr, ptrlength, 6,
+         pitchoffset, vol, left, right, priority, callbackval );
+   if ( handle < MV_Ok )
+      {
+      FX_SetErrorCode( FX_MultiVocError );
+      handle = FX_Warning;
+      }
+
+   return( handle );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_PlayWAV
+
+   Begin playback of sound data with the given volume and priority.
+---------------------------------------------------------------------*/
+
+int FX_PlayLoopedWAV
+   (
+   char *ptr,
+   unsigned int ptrlength,
+   int loopstart,
+   int loopend,
+   int pitchoffset,
+   int vol,
+   int left,
+   int right,
+   int priority,
+   unsigned int callbackval
+   )
+
+   {
+   int handle;
+
+   handle = MV_PlayLoopedWAV( ptr, ptrlength, loopstart, loopend,
+      pitchoffset, vol, left, right, priority, callbackval );
+   JOURNAL_CallAsset( JOURNAL_PlayLoopedWAV, handle, ptr, ptrlength, 8,
+         loopstart, loopend, pitchoffset, vol, left, right, priority, callbackval );
+   if ( handle < MV_Ok )
+      {
+      FX_SetErrorCode( FX_MultiVocError );
+      handle = FX_Warning;
+      }
+
+   return( handle );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_PlayVOC3D
+
+   Begin playback of sound data at specified angle and distance
+   from listener.
+---------------------------------------------------------------------*/
+
+int FX_PlayVOC3D
+   (
+   char *ptr,
+   unsigned int ptrlength,
+   int pitchoffset,
+   int angle,
+   int distance,
+   int priority,
+   unsigned int callbackval
+   )
+
+   {
+   int handle;
+
+   handle = MV_PlayVOC3D( ptr, ptrlength, pitchoffset, angle, distance,
+      priority, callbackval );
+   JOURNAL_CallAsset( JOURNAL_PlayVOC3D, handle, ptr, ptrlength, 5,
+         pitchoffset, angle, distance, priority, callbackval );
+   if ( handle < MV_Ok )
+      {
+      FX_SetErrorCode( FX_MultiVocError );
+      handle = FX_Warning;
+      }
+
+   return( handle );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_PlayWAV3D
+
+   Begin playback of sound data at specified angle and distance
+   from listener.
+---------------------------------------------------------------------*/
+
+int FX_PlayWAV3D
+   (
+   char *ptr,
+   unsigned int ptrlength,
+   int pitchoffset,
+   int angle,
+   int distance,
+   int priority,
+   unsigned int callbackval
+   )
+
+   {
+   int handle;
+
+   handle = MV_PlayWAV3D( ptr, ptrlength, pitchoffset, angle, distance,
+      priority, callbackval );
+   JOURNAL_CallAsset( JOURNAL_PlayWAV3D, handle, ptr, ptrlength, 5,
+         pitchoffset, angle, distance, priority, callbackval );
+   if ( handle < MV_Ok )
+      {
+      FX_SetErrorCode( FX_MultiVocError );
+      handle = FX_Warning;
+      }
+
+   return( handle );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_PlayRaw
+
+   Begin playback of raw sound data with the given volume and priority.
+---------------------------------------------------------------------*/
+
+int FX_PlayRaw
+   (
+   char *ptr,
+   unsigned int length,
+   unsigned rate,
+   int pitchoffset,
+   int vol,
+   int left,
+   int right,
+   int priority,
+   unsigned int callbackval
+   )
+
+   {
+   int handle;
+
+   handle = MV_PlayRaw( ptr, length, rate, pitchoffset,
+      vol, left, right, priority, callbackval );
+   JOURNAL_CallAsset( JOURNAL_PlayRaw, handle, ptr, length, 7,
+         rate, pitchoffset, vol, left, right, priority, callbackval );
+   if ( handle < MV_Ok )
+      {
+      FX_SetErrorCode( FX_MultiVocError );
+      handle = FX_Warning;
+      }
+
+   return( handle );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_PlayLoopedRaw
+
+   Begin playback of raw sound data with the given volume and priority.
+---------------------------------------------------------------------*/
+
+int FX_PlayLoopedRaw
+   (
+   char *ptr,
+   unsigned int length,
+   char *loopstart,
+   char *loopend,
+   unsigned rate,
+   int pitchoffset,
+   int vol,
+   int left,
+   int right,
+   int priority,
+   unsigned int callbackval
+   )
+
+   {
+   int handle;
+
+   handle = MV_PlayLoopedRaw( ptr, length, loopstart, loopend,
+      rate, pitchoffset, vol, left, right, priority, callbackval );
+   JOURNAL_CallAsset( JOURNAL_PlayLoopedRaw, handle, ptr, length, 9,
+         ( int )( loopstart - ptr ), ( int )( loopend - ptr ), rate,
+         pitchoffset, vol, left, right, priority, callbackval );
+   if ( handle < MV_Ok )
+      {
+      FX_SetErrorCode( FX_MultiVocError );
+      handle = FX_Warning;
+      }
+
+   return( handle );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_Pan3D
+
+   Set the angle and distance from the listener of the voice associated
+   with the specified handle.
+---------------------------------------------------------------------*/
+
+int FX_Pan3D
+   (
+   int handle,
+   int angle,
+   int distance
+   )
+
+   {
+   int status;
+
+   status = MV_Pan3D( handle, angle, distance );
+   JOURNAL_Call( JOURNAL_Pan3D, status, 3, handle, angle, distance );
+   if ( status != MV_Ok )
+      {
+      FX_SetErrorCode( FX_MultiVocError );
+      status = FX_Warning;
+      }
+
+   return( status );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_SoundActive
+
+   Tests if the specified sound is currently playing.
+---------------------------------------------------------------------*/
+
+int FX_SoundActive
+   (
+   int handle
+   )
+
+   {
+   return( MV_VoicePlaying( handle ) );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_SoundsPlaying
+
+   Reports the number of voices playing.
+---------------------------------------------------------------------*/
+
+int FX_SoundsPlaying
+   (
+   void
+   )
+
+   {
+   return( MV_VoicesPlaying() );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_StopSound
+
+   Halts playback of a specific voice
+---------------------------------------------------------------------*/
+
+int FX_StopSound
+   (
+   int handle
+   )
+
+   {
+   int status;
+
+   status = MV_Kill( handle );
+   JOURNAL_Call( JOURNAL_StopSound, status, 1, handle );
+   if ( status != MV_Ok )
+      {
+      FX_SetErrorCode( FX_MultiVocError );
+      return( FX_Warning );
+      }
+
+   return( FX_Ok );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_PauseSound
+
+   Pauses or resumes playback of a specific voice
+---------------------------------------------------------------------*/
+
+int FX_PauseSound
+   (
+   int handle,
+   int pauseon
+   )
+
+   {
+   int status;
+   
+   status = MV_PauseVoice( handle, pauseon );
+   JOURNAL_Call( JOURNAL_PauseSound, status, 2, handle, pauseon );
    if ( status != MV_Ok )
       {
       FX_SetErrorCode( FX_MultiVocError );
@@ -921,6 +1482,7 @@ int FX_StopAllSounds
    int status;
 
    status = MV_KillAllVoices();
+   JOURNAL_Call( JOURNAL_StopAllSounds, status, 0 );
    if ( status != MV_Ok )
       {
       FX_SetErrorCode( FX_MultiVocError );
@@ -997,7 +1559,36 @@ void FX_StopRecord
    void
    )
 
-   {
+   {
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_Render
+
+   Mixes the next frames of output into the caller's buffer when the
+   host drives the audio device itself.
+---------------------------------------------------------------------*/
+
+int FX_Render
+   (
+   void *buffer,
+   int   frames,
+   int   numchannels,
+   int   samplebits
+   )
+
+   {
+   int status;
+
+   status = MV_Render( buffer, frames, numchannels, samplebits );
+   if ( status == MV_Error )
+      {
+      FX_SetErrorCode( FX_MultiVocError );
+      status = FX_Warning;
+      }
+
+   return( status );
    }
 
 
@@ -1021,6 +1612,9 @@ int FX_PlayAuto( char *ptr, unsigned int length, int pitchoffset, int vol,
    #endif
    }
    
+   JOURNAL_CallAsset( JOURNAL_PlayAuto, handle, ptr, length, 6,
+         pitchoffset, vol, left, right, priority, callbackval );
+
    if ( handle < MV_Ok )
    {
       FX_SetErrorCode( FX_MultiVocError );
@@ -1059,6 +1653,9 @@ int FX_PlayLoopedAuto( char *ptr, unsigned int length, int loopstart, int loopen
 #endif
    }
    
+   JOURNAL_CallAsset( JOURNAL_PlayLoopedAuto, handle, ptr, length, 8,
+         loopstart, loopend, pitchoffset, vol, left, right, priority, callbackval );
+
    if ( handle < MV_Ok )
    {
       FX_SetErrorCode( FX_MultiVocError );
@@ -1088,6 +1685,397 @@ int FX_PlayAuto3D( char *ptr, unsigned int length, int pitchoffset, int angle,
    #endif
    }
    
+   JOURNAL_CallAsset( JOURNAL_PlayAuto3D, handle, ptr, length, 5,
+         pitchoffset, angle, distance, priority, callbackval );
+
+   if ( handle < MV_Ok )
+   {
+      FX_SetErrorCode( FX_MultiVocError );
+      handle = FX_Warning;
+   }
+   
+   return handle;
+}
+
+/*---------------------------------------------------------------------
+   Function: FX_PlayLoopedVorbisFrom
+
+   Play an OggVorbis sound starting at the given sample position.
+---------------------------------------------------------------------*/
+int FX_PlayLoopedVorbisFrom( char *ptr, unsigned int length, int startpos,
+                             int loopstart, int loopend, int pitchoffset, int vol,
+                             int left, int right, int priority, unsigned int callbackval )
+{
+   int handle = -1;
+   
+   #ifdef HAVE_VORBIS
+   handle = MV_PlayLoopedVorbisFrom(ptr, length, startpos, loopstart, loopend,
+                                    pitchoffset, vol, left, right, priority, callbackval);
+   #endif
+   
+   JOURNAL_CallAsset( JOURNAL_PlayLoopedVorbisFrom, handle, ptr, length, 9,
+         startpos, loopstart, loopend, pitchoffset, vol, left, right, priority, callbackval );
+
+   if ( handle < MV_Ok )
+   {
+      FX_SetErrorCode( FX_MultiVocError );
+      handle = FX_Warning;
+   }
+   
+   return handle;
+}
+
+/*---------------------------------------------------------------------
+   Function: FX_SetVorbisPosition
+
+   Moves an OggVorbis sound to the given sample position.
+---------------------------------------------------------------------*/
+int FX_SetVorbisPosition( int handle, int position )
+{
+   int status = MV_Error;
+   
+   #ifdef HAVE_VORBIS
+   status = MV_SetVorbisPosition(handle, position);
+   JOURNAL_Call( JOURNAL_SetVorbisPosition, status, 2, handle, position );
+   #endif
+   
+   if ( status != MV_Ok )
+   {
+      FX_SetErrorCode( FX_MultiVocError );
+      return( FX_Warning );
+   }
+   
+   return( FX_Ok );
+}
+
+/*---------------------------------------------------------------------
+   Function: FX_PlayFile
+
+   Play a WAV, VOC or OggVorbis file, streaming it from disk.
+---------------------------------------------------------------------*/
+int FX_PlayFile( const char *filename, int pitchoffset, int vol, int left,
+                 int right, int priority, unsigned int callbackval )
+{
+   int handle;
+   
+   handle = MV_PlayStream(filename, pitchoffset, vol, left, right, priority, callbackval);
+   JOURNAL_CallString( JOURNAL_PlayFile, handle, filename, 6,
+         pitchoffset, vol, left, right, priority, callbackval );
+   if ( handle < MV_Ok )
+   {
+      FX_SetErrorCode( FX_MultiVocError );
+      handle = FX_Warning;
+   }
+   
+   return handle;
+}
+
+/*---------------------------------------------------------------------
+   Function: FX_PlayLoopedFile
+
+   Play a looped WAV, VOC or OggVorbis file, streaming it from disk.
+---------------------------------------------------------------------*/
+int FX_PlayLoopedFile( const char *filename, int loopstart, int loopend,
+                       int pitchoffset, int vol, int left, int right, int priority,
+                       unsigned int callbackval )
+{
+   int handle;
+   
+   handle = MV_PlayLoopedStream(filename, loopstart, loopend, pitchoffset,
+                                vol, left, right, priority, callbackval);
+   JOURNAL_CallString( JOURNAL_PlayLoopedFile, handle, filename, 8,
+         loopstart, loopend, pitchoffset, vol, left, right, priority, callbackval );
+   if ( handle < MV_Ok )
+   {
+      FX_SetErrorCode( FX_MultiVocError );
+      handle = FX_Warning;
+   }
+   
+   return handle;
+}
+
+/*---------------------------------------------------------------------
+   Function: FX_OpenSoundBank
+
+   Maps a sound bank file, returning its bank number.
+---------------------------------------------------------------------*/
+int FX_OpenSoundBank( const char *filename )
+{
+   int bank;
+   
+   bank = MV_OpenSoundBank(filename);
+   JOURNAL_CallString( JOURNAL_OpenSoundBank, bank, filename, 0 );
+   if ( bank < MV_Ok )
+   {
+      FX_SetErrorCode( FX_MultiVocError );
+      bank = FX_Warning;
+   }
+   
+   return bank;
+}
+
+/*---------------------------------------------------------------------
+   Function: FX_CloseSoundBank
+
+   Stops any sounds playing from a bank and unmaps it.
+---------------------------------------------------------------------*/
+int FX_CloseSoundBank( int bank )
+{
+   int status;
+   
+   status = MV_CloseSoundBank(bank);
+   JOURNAL_Call( JOURNAL_CloseSoundBank, status, 1, bank );
+   if ( status != MV_Ok )
+   {
+      FX_SetErrorCode( FX_MultiVocError );
+      return( FX_Warning );
+   }
+   
+   return( FX_Ok );
+}
+
+/*---------------------------------------------------------------------
+   Function: FX_SoundBankEntries
+
+   Returns the number of sounds in a bank.
+---------------------------------------------------------------------*/
+int FX_SoundBankEntries( int bank )
+{
+   int count;
+   
+   count = MV_SoundBankEntries(bank);
+   if ( count < MV_Ok )
+   {
+      FX_SetErrorCode( FX_MultiVocError );
+      count = FX_Warning;
+   }
+   
+   return count;
+}
+
+/*---------------------------------------------------------------------
+   Function: FX_PlayBankSound
+
+   Play a sound from a bank.
+---------------------------------------------------------------------*/
+int FX_PlayBankSound( int bank, int entry, int pitchoffset, int vol, int left,
+                      int right, int priority, unsigned int callbackval )
+{
+   int handle;
+   
+   handle = MV_PlayBankSound(bank, entry, pitchoffset, vol, left, right, priority,
+                             callbackval);
+   JOURNAL_Call( JOURNAL_PlayBankSound, handle, 8, bank, entry,
+         pitchoffset, vol, left, right, priority, callbackval );
+   if ( handle < MV_Ok )
+   {
+      FX_SetErrorCode( FX_MultiVocError );
+      handle = FX_Warning;
+   }
+   
+   return handle;
+}
+
+/*---------------------------------------------------------------------
+   Function: FX_PlayLoopedBankSound
+
+   Play a sound from a bank, repeating its loop.
+---------------------------------------------------------------------*/
+int FX_PlayLoopedBankSound( int bank, int entry, int pitchoffset, int vol, int left,
+                            int right, int priority, unsigned int callbackval )
+{
+   int handle;
+   
+   handle = MV_PlayLoopedBankSound(bank, entry, pitchoffset, vol, left, right,
+                                   priority, callbackval);
+   JOURNAL_Call( JOURNAL_PlayLoopedBankSound, handle, 8, bank, entry,
+         pitchoffset, vol, left, right, priority, callbackval );
+   if ( handle < MV_Ok )
+   {
+      FX_SetErrorCode( FX_MultiVocError );
+      handle = FX_Warning;
+   }
+   
+   return handle;
+}
+
+/*---------------------------------------------------------------------
+   Function: FX_PlayBankSound3D
+
+   Play a positioned sound from a bank.
+---------------------------------------------------------------------*/
+int FX_PlayBankSound3D( int bank, int entry, int pitchoffset, int angle, int distance,
+                        int priority, unsigned int callbackval )
+{
+   int handle;
+   
+   handle = MV_PlayBankSound3D(bank, entry, pitchoffset, angle, distance, priority,
+                               callbackval);
+   JOURNAL_Call( JOURNAL_PlayBankSound3D, handle, 7, bank, entry,
+         pitchoffset, angle, distance, priority, callbackval );
+   if ( handle < MV_Ok )
+   {
+      FX_SetErrorCode( FX_MultiVocError );
+      handle = FX_Warning;
+   }
+   
+   return handle;
+}
+
+/*---------------------------------------------------------------------
+   Function: FX_SetSoundResampling
+
+   Sets the most memory in bytes a sound's copy at the mixing rate may
+   take when registered sounds are resampled. Zero turns it off.
+---------------------------------------------------------------------*/
+void FX_SetSoundResampling( unsigned int maxbytes )
+{
+   MV_SetSoundResampling( maxbytes );
+   JOURNAL_Call( JOURNAL_SetSoundResampling, 0, 1, maxbytes );
+}
+
+/*---------------------------------------------------------------------
+   Function: FX_GetResampledMemory
+
+   Returns the bytes held by resampled copies of registered sounds.
+---------------------------------------------------------------------*/
+unsigned int FX_GetResampledMemory( void )
+{
+   return MV_GetResampledMemory();
+}
+
+/*---------------------------------------------------------------------
+   Function: FX_SetSoundTranscoding
+
+   Sets the size in bytes above which PCM sounds are encoded to ADPCM
+   as they are registered. Zero turns transcoding off.
+---------------------------------------------------------------------*/
+void FX_SetSoundTranscoding( unsigned int threshold )
+{
+   MV_SetSoundTranscoding( threshold );
+   JOURNAL_Call( JOURNAL_SetSoundTranscoding, 0, 1, threshold );
+}
+
+/*---------------------------------------------------------------------
+   Function: FX_SoundIsTranscoded
+
+   Returns TRUE if a registered sound was resampled or transcoded and
+   no longer uses the memory it was registered from.
+---------------------------------------------------------------------*/
+int FX_SoundIsTranscoded( int id )
+{
+   return MV_SoundIsTranscoded( id );
+}
+
+/*---------------------------------------------------------------------
+   Function: FX_GetTranscodeSavings
+
+   Returns the bytes saved by transcoding registered sounds.
+---------------------------------------------------------------------*/
+unsigned int FX_GetTranscodeSavings( void )
+{
+   return MV_GetTranscodeSavings();
+}
+
+/*---------------------------------------------------------------------
+   Function: FX_RegisterSound
+
+   Checks a sound and parses its headers once, returning an ID to
+   play it by.
+---------------------------------------------------------------------*/
+int FX_RegisterSound( char *ptr, unsigned int length )
+{
+   int id;
+   
+   id = MV_RegisterSound(ptr, length);
+   JOURNAL_CallAsset( JOURNAL_RegisterSound, id, ptr, length, 0 );
+   if ( id < MV_Ok )
+   {
+      FX_SetErrorCode( FX_MultiVocError );
+      id = FX_Warning;
+   }
+   
+   return id;
+}
+
+/*---------------------------------------------------------------------
+   Function: FX_UnregisterSound
+
+   Stops any voices playing a registered sound and forgets it.
+---------------------------------------------------------------------*/
+int FX_UnregisterSound( int id )
+{
+   int status;
+   
+   status = MV_UnregisterSound(id);
+   JOURNAL_Call( JOURNAL_UnregisterSound, status, 1, id );
+   if ( status != MV_Ok )
+   {
+      FX_SetErrorCode( FX_MultiVocError );
+      return( FX_Warning );
+   }
+   
+   return( FX_Ok );
+}
+
+/*---------------------------------------------------------------------
+   Function: FX_PlayID
+
+   Play a registered sound.
+---------------------------------------------------------------------*/
+int FX_PlayID( int id, int pitchoffset, int vol, int left, int right,
+               int priority, unsigned int callbackval )
+{
+   int handle;
+   
+   handle = MV_PlayID(id, pitchoffset, vol, left, right, priority, callbackval);
+   JOURNAL_Call( JOURNAL_PlayID, handle, 7, id,
+         pitchoffset, vol, left, right, priority, callbackval );
+   if ( handle < MV_Ok )
+   {
+      FX_SetErrorCode( FX_MultiVocError );
+      handle = FX_Warning;
+   }
+   
+   return handle;
+}
+
+/*---------------------------------------------------------------------
+   Function: FX_PlayLoopedID
+
+   Play a looped registered sound.
+---------------------------------------------------------------------*/
+int FX_PlayLoopedID( int id, int loopstart, int loopend, int pitchoffset, int vol,
+                     int left, int right, int priority, unsigned int callbackval )
+{
+   int handle;
+   
+   handle = MV_PlayLoopedID(id, loopstart, loopend, pitchoffset, vol, left, right,
+                            priority, callbackval);
+   JOURNAL_Call( JOURNAL_PlayLoopedID, handle, 9, id, loopstart, loopend,
+         pitchoffset, vol, left, right, priority, callbackval );
+   if ( handle < MV_Ok )
+   {
+      FX_SetErrorCode( FX_MultiVocError );
+      handle = FX_Warning;
+   }
+   
+   return handle;
+}
+
+/*---------------------------------------------------------------------
+   Function: FX_PlayID3D
+
+   Play a positioned registered sound.
+---------------------------------------------------------------------*/
+int FX_PlayID3D( int id, int pitchoffset, int angle, int distance,
+                 int priority, unsigned int callbackval )
+{
+   int handle;
+   
+   handle = MV_PlayID3D(id, pitchoffset, angle, distance, priority, callbackval);
+   JOURNAL_Call( JOURNAL_PlayID3D, handle, 6, id,
+         pitchoffset, angle, distance, priority, callbackval );
    if ( handle < MV_Ok )
    {
       FX_SetErrorCode( FX_MultiVocError );
@@ -0,0 +1,408 @@
+/*
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+ */
+
+/**
+ * Checks mixer output against reference renders
+ *
+ *   golden -w refdir                         write the references
+ *   golden [-e maxerror] [-s minsnr] refdir  compare against them
+ *   golden -w -c table                       write a table of CRC-32s
+ *   golden -c table                          compare bit-exactly with it
+ *
+ * A fixed suite of scenarios is rendered headlessly through FX_Render:
+ * every output format against every source format, each plain, pitched
+ * down and up, looped, panned in 3D, through each resampler, and with
+ * normal and fast reverb. Each scenario's PCM goes to its own file in
+ * refdir. Comparison is bit-exact unless a largest allowed sample error
+ * (in 16-bit units) or a least signal-to-noise ratio in dB is given, so
+ * a faster kernel that rounds differently can still be judged. Write
+ * the references from a build known to be good.
+ *
+ * The table of each scenario's CRC-32 in src/golden.crc is kept with
+ * the source, and "make check" compares a build against it. It changes
+ * only along with a change meant to alter the output; judging such a
+ * change by a tolerance needs PCM references from before it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "fx_man.h"
+#include "sndcards.h"
+#include "tools.h"
+
+#define MIXRATE 22050
+#define RENDERFRAMES (MIXRATE / 2)
+#define SOURCERATE 11025
+#define SOURCEFRAMES SOURCERATE
+
+enum {
+    CASE_PLAIN,
+    CASE_PITCHDOWN,
+    CASE_PITCHUP,
+    CASE_LOOP,
+    CASE_3D,
+    CASE_LINEAR,
+    CASE_CUBIC,
+    CASE_SINC,
+    CASE_REVERB,
+    CASE_FASTREVERB,
+    CASE_NUM
+};
+
+static const char * casenames[CASE_NUM] = {
+    "plain", "pitchdown", "pitchup", "loop", "3d",
+    "linear", "cubic", "sinc", "reverb", "fastreverb"
+};
+
+static char * Sources[4];           // 8-bit mono, 16-bit mono, 8-bit stereo, 16-bit stereo
+static unsigned int SourceLengths[4];
+
+static char RenderBuffer[RENDERFRAMES * 4];
+static char RefBuffer[RENDERFRAMES * 4];
+
+typedef struct {
+    char name[64];
+    unsigned int crc;
+} crcentry;
+
+static crcentry Crcs[CASE_NUM * 16];
+static int NumCrcs;
+static unsigned int CrcTable[256];
+
+
+static unsigned int crc32(const char * buf, int bytes)
+{
+    unsigned int crc;
+    int i, k;
+
+    if (!CrcTable[1]) {
+        for (i = 0; i < 256; i++) {
+            crc = i;
+            for (k = 0; k < 8; k++) {
+                crc = crc & 1 ? (crc >> 1) ^ 0xedb88320 : crc >> 1;
+            }
+            CrcTable[i] = crc;
+        }
+    }
+
+    crc = 0xffffffff;
+    for (i = 0; i < bytes; i++) {
+        crc = (crc >> 8) ^ CrcTable[(crc ^ (unsigned char) buf[i]) & 255];
+    }
+    return ~crc;
+}
+
+// Reads "name crc" lines, skipping comments
+static int loadcrcs(const char * path)
+{
+    char line[256];
+    FILE * fp;
+
+    fp = fopen(path, "r");
+    if (!fp) {
+        return 0;
+    }
+
+    while (fgets(line, sizeof(line), fp) && NumCrcs < CASE_NUM * 16) {
+        if (line[0] != '#' &&
+            sscanf(line, "%63s %x", Crcs[NumCrcs].name, &Crcs[NumCrcs].crc) == 2) {
+            NumCrcs++;
+        }
+    }
+
+    fclose(fp);
+    return 1;
+}
+
+static const crcentry * findcrc(const char * name)
+{
+    int i;
+
+    for (i = 0; i < NumCrcs; i++) {
+        if (!strcmp(Crcs[i].name, name)) {
+            return &Crcs[i];
+        }
+    }
+    return 0;
+}
+
+
+// A chord with a slow sweep, different in each channel
+static char * makewav(int bits, int channels, unsigned int * length)
+{
+    int framesize = channels * bits / 8;
+    unsigned int databytes = SOURCEFRAMES * framesize;
+    char * wav, * p;
+    double t;
+    int i, c, v;
+
+    wav = (char *) malloc(WAVHEADER_SIZE + databytes);
+    makewavheader(wav, SOURCERATE, channels, bits, databytes);
+
+    p = wav + WAVHEADER_SIZE;
+    for (i = 0; i < SOURCEFRAMES; i++) {
+        t = (double) i / SOURCERATE;
+        for (c = 0; c < channels; c++) {
+            v = (int) (9000 * sin(2 * M_PI * (220 + 110 * c) * t) +
+                       6000 * sin(2 * M_PI * (1000 + 2000 * t) * t) +
+                       3000 * sin(2 * M_PI * 3100 * t));
+            if (bits == 16) {
+                write_le16(p, v);
+                p += 2;
+            } else {
+                *p++ = (char) ((v >> 8) + 128);
+            }
+        }
+    }
+
+    *length = WAVHEADER_SIZE + databytes;
+    return wav;
+}
+
+static int render(int outbits, int outchannels, int source, int testcase, int * bytes)
+{
+    int channels = outchannels, bits = outbits, rate = MIXRATE;
+    char * p = Sources[source];
+    unsigned int len = SourceLengths[source];
+    int handle;
+
+    if (FX_Init(ASS_NoSound, 8, &channels, &bits, &rate, 0) != FX_Ok) {
+        fprintf(stderr, "FX_Init failed: %s\n", FX_ErrorString(FX_Error));
+        return 0;
+    }
+
+    // these outlast FX_Shutdown, so put them back every time
+    FX_SetDefaultResampler(FX_ResampleNearest);
+    FX_SetMixRateDivisor(1);
+    FX_SetVoiceLOD(0, 2);
+    FX_SetReverb(0);
+    FX_SetVolume(255);
+
+    switch (testcase) {
+        case CASE_LINEAR:
+            FX_SetDefaultResampler(FX_ResampleLinear);
+            break;
+        case CASE_CUBIC:
+            FX_SetDefaultResampler(FX_ResampleCubic);
+            break;
+        case CASE_SINC:
+            FX_SetDefaultResampler(FX_ResampleSinc);
+            break;
+        case CASE_REVERB:
+            FX_SetReverb(96);
+            break;
+        case CASE_FASTREVERB:
+            FX_SetFastReverb(2);
+            break;
+    }
+
+    switch (testcase) {
+        case CASE_PITCHDOWN:
+            handle = FX_PlayWAV(p, len, -700, 255, 255, 200, 1, 0);
+            break;
+        case CASE_PITCHUP:
+        case CASE_LINEAR:
+        case CASE_CUBIC:
+        case CASE_SINC:
+            handle = FX_PlayWAV(p, len, 500, 255, 200, 255, 1, 0);
+            break;
+        case CASE_LOOP:
+            handle = FX_PlayLoopedWAV(p, len, 1000, 2500, 0, 220, 255, 180, 1, 0);
+            break;
+        case CASE_3D:
+            handle = FX_PlayWAV3D(p, len, 0, 5, 40, 1, 0);
+            break;
+        default:
+            handle = FX_PlayWAV(p, len, 0, 255, 255, 255, 1, 0);
+            break;
+    }
+
+    if (handle <= FX_Ok) {
+        fprintf(stderr, "could not start the voice: %s\n", FX_ErrorString(FX_Error));
+        FX_Shutdown();
+        return 0;
+    }
+
+    FX_Render(RenderBuffer, RENDERFRAMES, outchannels, outbits);
+    FX_Shutdown();
+
+    *bytes = RENDERFRAMES * outchannels * outbits / 8;
+    return 1;
+}
+
+static int sampleat(const char * buf, int bits, int i)
+{
+    if (bits == 16) {
+        return ((const short *) buf)[i];
+    }
+    return (((const unsigned char *) buf)[i] - 128) << 8;
+}
+
+int main(int argc, char ** argv)
+{
+    const char * refdir = 0, * crcfile = 0;
+    const crcentry * entry;
+    unsigned int crc;
+    int writing = 0, maxerror = -1;
+    double minsnr = -1, signal, noise, snr;
+    int outbits, outchannels, source, testcase;
+    int bytes, samples, i, diff, worst;
+    int failed = 0, count = 0;
+    char name[64], path[1024];
+    FILE * fp, * table = 0;
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-w")) {
+            writing = 1;
+        } else if (i + 1 < argc && !strcmp(argv[i], "-e")) {
+            maxerror = atoi(argv[++i]);
+        } else if (i + 1 < argc && !strcmp(argv[i], "-s")) {
+            minsnr = atof(argv[++i]);
+        } else if (i + 1 < argc && !strcmp(argv[i], "-c") && !crcfile) {
+            crcfile = argv[++i];
+        } else if (argv[i][0] != '-' && !refdir) {
+            refdir = argv[i];
+        } else {
+            refdir = crcfile = 0;
+            break;
+        }
+    }
+
+    // a CRC either matches or it does not
+    if (!refdir == !crcfile || (crcfile && (maxerror >= 0 || minsnr >= 0))) {
+        fprintf(stderr, "usage: %s -w refdir\n"
+                        "       %s [-e maxerror] [-s minsnr] refdir\n"
+                        "       %s -w -c table\n"
+                        "       %s -c table\n", argv[0], argv[0], argv[0], argv[0]);
+        return 1;
+    }
+
+    if (crcfile && writing) {
+        table = fopen(crcfile, "w");
+        if (!table) {
+            fprintf(stderr, "%s: could not write\n", crcfile);
+            return 1;
+        }
+        fprintf(table, "# CRC-32 of each golden scenario's output, checked by \"golden -c\".\n"
+                       "# Write it again with \"golden -w -c\" only when the output is meant\n"
+                       "# to change.\n");
+    } else if (crcfile && !loadcrcs(crcfile)) {
+        fprintf(stderr, "%s: could not read\n", crcfile);
+        return 1;
+    }
+
+    Sources[0] = makewav(8, 1, &SourceLengths[0]);
+    Sources[1] = makewav(16, 1, &SourceLengths[1]);
+    Sources[2] = makewav(8, 2, &SourceLengths[2]);
+    Sources[3] = makewav(16, 2, &SourceLengths[3]);
+
+    for (outbits = 8; outbits <= 16; outbits += 8)
+    for (outchannels = 1; outchannels <= 2; outchannels++)
+    for (source = 0; source < 4; source++)
+    for (testcase = 0; testcase < CASE_NUM; testcase++) {
+        sprintf(name, "out%d%s-src%d%s-%s", outbits, outchannels == 2 ? "st" : "m",
+                source & 1 ? 16 : 8, source & 2 ? "st" : "m", casenames[testcase]);
+        sprintf(path, "%.900s/%s.pcm", refdir, name);
+
+        if (!render(outbits, outchannels, source, testcase, &bytes)) {
+            return 1;
+        }
+        count++;
+
+        if (crcfile) {
+            crc = crc32(RenderBuffer, bytes);
+            entry = findcrc(name);
+            if (writing) {
+                fprintf(table, "%s %08x\n", name, crc);
+            } else if (!entry) {
+                printf("%-40s MISSING\n", name);
+                failed++;
+            } else if (entry->crc != crc) {
+                printf("%-40s FAILED, CRC %08x, expected %08x\n", name, crc, entry->crc);
+                failed++;
+            }
+            continue;
+        }
+
+        if (writing) {
+            fp = fopen(path, "wb");
+            if (!fp || fwrite(RenderBuffer, 1, bytes, fp) != (size_t) bytes) {
+                fprintf(stderr, "%s: could not write\n", path);
+                return 1;
+            }
+            fclose(fp);
+            continue;
+        }
+
+        fp = fopen(path, "rb");
+        if (!fp || fread(RefBuffer, 1, bytes, fp) != (size_t) bytes) {
+            printf("%-40s MISSING\n", name);
+            if (fp) {
+                fclose(fp);
+            }
+            failed++;
+            continue;
+        }
+        fclose(fp);
+
+        if (!memcmp(RefBuffer, RenderBuffer, bytes)) {
+            continue;
+        }
+
+        samples = bytes / (outbits / 8);
+        signal = noise = 0;
+        worst = 0;
+        for (i = 0; i < samples; i++) {
+            int ref = sampleat(RefBuffer, outbits, i);
+
+            diff = sampleat(RenderBuffer, outbits, i) - ref;
+            signal += (double) ref * ref;
+            noise += (double) diff * diff;
+            if (abs(diff) > worst) {
+                worst = abs(diff);
+            }
+        }
+        snr = 10 * log10((signal + 1) / noise);
+
+        if ((maxerror >= 0 || minsnr >= 0) &&
+            (maxerror < 0 || worst <= maxerror) &&
+            (minsnr < 0 || snr >= minsnr)) {
+            printf("%-40s within tolerance, max error %d, SNR %.1f dB\n", name, worst, snr);
+        } else {
+            printf("%-40s FAILED, max error %d, SNR %.1f dB\n", name, worst, snr);
+            failed++;
+        }
+    }
+
+    if (table) {
+        if (fclose(table)) {
+            fprintf(stderr, "%s: could not write\n", crcfile);
+            return 1;
+        }
+        printf("wrote %d CRCs to %s\n", count, crcfile);
+    } else if (writing) {
+        printf("wrote %d references to %s\n", count, refdir);
+    } else {
+        printf("%d of %d scenarios passed\n", count - failed, count);
+    }
+
+    return failed ? 1 : 0;
+}
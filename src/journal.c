@@ -0,0 +1,342 @@
+/*
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+ */
+
+/**
+ * Journal of calls into the library, for replaying a session offline
+ *
+ * The FX_ and MUSIC_ calls that change what is mixed are written down
+ * with their arguments, their result and how far mixing had got, so
+ * the replay tool can make the same calls at the same points in the
+ * mix. Sound data is identified by its address and length and written
+ * out whole the first time it is played; memory reused for different
+ * data of the same length is taken to be the same sound.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include "asssys.h"
+#include "sndcards.h"
+#include "multivoc.h"
+#include "journal.h"
+
+typedef struct {
+	const void * data;
+	unsigned int length;
+	unsigned int id;
+} JournalAsset;
+
+volatile int JOURNAL_Recording = 0;
+
+static FILE * Journal = 0;
+static ASS_Mutex * Mutex = 0;
+static unsigned int LastFrame;
+static JournalAsset * Assets = 0;
+static unsigned int AssetSlots = 0;     // a power of two
+static unsigned int AssetCount = 0;
+
+
+static void writeUnsigned(unsigned int v)
+{
+	while (v >= 0x80) {
+		putc((v & 0x7f) | 0x80, Journal);
+		v >>= 7;
+	}
+	putc(v, Journal);
+}
+
+static void writeSigned(int v)
+{
+	writeUnsigned(((unsigned int) v << 1) ^ (unsigned int) (v >> 31));
+}
+
+static unsigned int hashAsset(const void * data, unsigned int length)
+{
+	return (unsigned int) (((size_t) data >> 2) * 2654435761u) ^ length;
+}
+
+static int growAssets(void)
+{
+	JournalAsset * old = Assets;
+	unsigned int oldslots = AssetSlots, i, slot;
+
+	AssetSlots = AssetSlots ? AssetSlots * 2 : 256;
+	Assets = (JournalAsset *) ASS_Alloc(ASS_MemOther, AssetSlots * sizeof(JournalAsset));
+	if (!Assets) {
+		Assets = old;
+		AssetSlots = oldslots;
+		return 0;
+	}
+	memset(Assets, 0, AssetSlots * sizeof(JournalAsset));
+
+	for (i = 0; i < oldslots; i++) {
+		if (!old[i].data) {
+			continue;
+		}
+		slot = hashAsset(old[i].data, old[i].length) & (AssetSlots - 1);
+		while (Assets[slot].data) {
+			slot = (slot + 1) & (AssetSlots - 1);
+		}
+		Assets[slot] = old[i];
+	}
+
+	ASS_Free(old);
+	return 1;
+}
+
+// The number for some sound data, writing it out if it is new
+static unsigned int findAsset(const void * data, unsigned int length)
+{
+	unsigned int slot;
+
+	if (AssetCount * 2 >= AssetSlots && !growAssets()) {
+		return 0;
+	}
+
+	slot = hashAsset(data, length) & (AssetSlots - 1);
+	while (Assets[slot].data) {
+		if (Assets[slot].data == data && Assets[slot].length == length) {
+			return Assets[slot].id;
+		}
+		slot = (slot + 1) & (AssetSlots - 1);
+	}
+
+	Assets[slot].data = data;
+	Assets[slot].length = length;
+	Assets[slot].id = ++AssetCount;
+
+	putc(JOURNAL_Asset | JOURNAL_HasString, Journal);
+	writeUnsigned(0);
+	writeSigned(AssetCount);
+	writeUnsigned(length);
+	fwrite(data, 1, length, Journal);
+	writeUnsigned(0);
+
+	return AssetCount;
+}
+
+static void writeCall(int op, int result, unsigned int asset, const char * string,
+		int count, va_list args)
+{
+	unsigned int frame = MV_GetMixedFrames();
+	unsigned int length = 0;
+
+	if (string) {
+		while (string[length]) {
+			length++;
+		}
+	}
+
+	putc(op | (asset ? JOURNAL_HasAsset : 0) | (string ? JOURNAL_HasString : 0), Journal);
+	writeUnsigned(frame - LastFrame);
+	writeSigned(result);
+	if (asset) {
+		writeUnsigned(asset);
+	}
+	if (string) {
+		writeUnsigned(length);
+		fwrite(string, 1, length, Journal);
+	}
+	writeUnsigned(count);
+	while (count-- > 0) {
+		writeSigned(va_arg(args, int));
+	}
+
+	LastFrame = frame;
+}
+
+int JOURNAL_Start(const char * filename)
+{
+	JOURNAL_Stop();
+
+	Mutex = ASS_CreateMutex();
+	if (!Mutex) {
+		return 0;
+	}
+
+	Journal = fopen(filename, "wb");
+	if (!Journal) {
+		ASS_DestroyMutex(Mutex);
+		Mutex = 0;
+		return 0;
+	}
+
+	fwrite("JFAJ", 1, 4, Journal);
+	putc(JOURNAL_Version, Journal);
+
+	LastFrame = MV_GetMixedFrames();
+	JOURNAL_Recording = 1;
+
+	return 1;
+}
+
+void JOURNAL_Stop(void)
+{
+	if (!Journal) {
+		return;
+	}
+
+	ASS_LockMutex(Mutex);
+	JOURNAL_Recording = 0;
+	fclose(Journal);
+	Journal = 0;
+	ASS_UnlockMutex(Mutex);
+
+	ASS_DestroyMutex(Mutex);
+	Mutex = 0;
+
+	ASS_Free(Assets);
+	Assets = 0;
+	AssetSlots = 0;
+	AssetCount = 0;
+}
+
+void JOURNAL_Call(int op, int result, int count, ...)
+{
+	va_list args;
+
+	if (!JOURNAL_Recording) {
+		return;
+	}
+
+	ASS_LockMutex(Mutex);
+	if (Journal) {
+		va_start(args, count);
+		writeCall(op, result, 0, 0, count, args);
+		va_end(args);
+	}
+	ASS_UnlockMutex(Mutex);
+}
+
+void JOURNAL_CallAsset(int op, int result, const void * data, unsigned int length,
+		int count, ...)
+{
+	va_list args;
+	unsigned int asset;
+
+	if (!JOURNAL_Recording || !data) {
+		return;
+	}
+
+	ASS_LockMutex(Mutex);
+	if (Journal) {
+		asset = findAsset(data, length);
+		va_start(args, count);
+		writeCall(op, result, asset, 0, count, args);
+		va_end(args);
+	}
+	ASS_UnlockMutex(Mutex);
+}
+
+void JOURNAL_CallString(int op, int result, const char * string, int count, ...)
+{
+	va_list args;
+
+	if (!JOURNAL_Recording || !string) {
+		return;
+	}
+
+	ASS_LockMutex(Mutex);
+	if (Journal) {
+		va_start(args, count);
+		writeCall(op, result, 0, string, count, args);
+		va_end(args);
+	}
+	ASS_UnlockMutex(Mutex);
+}
+
+static const unsigned char * readUnsigned(const unsigned char * p, const unsigned char * end,
+		unsigned int * v)
+{
+	int shift = 0;
+
+	*v = 0;
+	while (p && p < end && shift < 35) {
+		*v |= (unsigned int) (*p & 0x7f) << shift;
+		if (!(*p++ & 0x80)) {
+			return p;
+		}
+		shift += 7;
+	}
+	return 0;
+}
+
+static const unsigned char * readSigned(const unsigned char * p, const unsigned char * end,
+		int * v)
+{
+	unsigned int u;
+
+	p = readUnsigned(p, end, &u);
+	*v = (int) (u >> 1) ^ -(int) (u & 1);
+	return p;
+}
+
+const unsigned char * JOURNAL_ReadHeader(const unsigned char * p, const unsigned char * end)
+{
+	if (end - p < 5 || p[0] != 'J' || p[1] != 'F' || p[2] != 'A' || p[3] != 'J' ||
+			p[4] != JOURNAL_Version) {
+		return 0;
+	}
+	return p + 5;
+}
+
+// Returns where the next record starts, or 0 at the end or if the
+// record is damaged
+const unsigned char * JOURNAL_Read(const unsigned char * p, const unsigned char * end,
+		JournalRecord * record)
+{
+	unsigned int count, i;
+	int op, skipped;
+
+	if (!p || p >= end) {
+		return 0;
+	}
+
+	op = *p++;
+	record->op = op & JOURNAL_OpMask;
+	record->asset = 0;
+	record->string = 0;
+	record->length = 0;
+
+	p = readUnsigned(p, end, &record->frame);
+	p = readSigned(p, end, &record->result);
+	if (op & JOURNAL_HasAsset) {
+		p = readUnsigned(p, end, &record->asset);
+	}
+	if (op & JOURNAL_HasString) {
+		p = readUnsigned(p, end, &record->length);
+		if (!p || record->length > (unsigned int) (end - p)) {
+			return 0;
+		}
+		record->string = (const char *) p;
+		p += record->length;
+	}
+	p = readUnsigned(p, end, &count);
+
+	record->count = 0;
+	for (i = 0; p && i < count; i++) {
+		if (i < JOURNAL_MaxArgs) {
+			p = readSigned(p, end, &record->args[record->count++]);
+		} else {
+			p = readSigned(p, end, &skipped);
+		}
+	}
+
+	return p;
+}
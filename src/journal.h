@@ -0,0 +1,135 @@
+/*
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+ */
+
+#ifndef __JOURNAL_H
+#define __JOURNAL_H
+
+/*
+ A journal starts with "JFAJ" and a version byte, then holds records:
+
+   op            byte; JOURNAL_HasAsset and JOURNAL_HasString flag
+                 what follows the result
+   frame         unsigned, output frames mixed since the last record
+   result        signed, what the call returned
+   asset         unsigned, if flagged
+   string        unsigned length then the bytes, if flagged
+   count         unsigned, then that many signed arguments
+
+ Unsigned numbers are written seven bits a byte, low first, with the
+ top bit set on all but the last byte. Signed numbers are zigzagged
+ first. A JOURNAL_Asset record carries the bytes of sound data as its
+ string the first time a call uses them, numbered by its result.
+*/
+
+#define JOURNAL_Version   1
+#define JOURNAL_HasAsset  0x80
+#define JOURNAL_HasString 0x40
+#define JOURNAL_OpMask    0x3f
+#define JOURNAL_MaxArgs   16
+
+enum JOURNAL_OPS
+   {
+   JOURNAL_Asset,
+   JOURNAL_Init,
+   JOURNAL_Shutdown,
+   JOURNAL_SetVolume,
+   JOURNAL_SetReverseStereo,
+   JOURNAL_SetReverb,
+   JOURNAL_SetFastReverb,
+   JOURNAL_SetReverbDelay,
+   JOURNAL_SetDefaultResampler,
+   JOURNAL_SetMixRateDivisor,
+   JOURNAL_SetVoiceLOD,
+   JOURNAL_SetSoundResampling,
+   JOURNAL_SetSoundTranscoding,
+   JOURNAL_EndLooping,
+   JOURNAL_SetPan,
+   JOURNAL_SetPitch,
+   JOURNAL_SetVoiceResampler,
+   JOURNAL_SetFrequency,
+   JOURNAL_SetVorbisPosition,
+   JOURNAL_Pan3D,
+   JOURNAL_StopSound,
+   JOURNAL_PauseSound,
+   JOURNAL_StopAllSounds,
+   JOURNAL_PlayVOC,
+   JOURNAL_PlayLoopedVOC,
+   JOURNAL_PlayWAV,
+   JOURNAL_PlayLoopedWAV,
+   JOURNAL_PlayVOC3D,
+   JOURNAL_PlayWAV3D,
+   JOURNAL_PlayAuto,
+   JOURNAL_PlayLoopedAuto,
+   JOURNAL_PlayAuto3D,
+   JOURNAL_PlayLoopedVorbisFrom,
+   JOURNAL_PlayRaw,
+   JOURNAL_PlayLoopedRaw,
+   JOURNAL_PlayFile,
+   JOURNAL_PlayLoopedFile,
+   JOURNAL_OpenSoundBank,
+   JOURNAL_CloseSoundBank,
+   JOURNAL_PlayBankSound,
+   JOURNAL_PlayLoopedBankSound,
+   JOURNAL_PlayBankSound3D,
+   JOURNAL_RegisterSound,
+   JOURNAL_UnregisterSound,
+   JOURNAL_PlayID,
+   JOURNAL_PlayLoopedID,
+   JOURNAL_PlayID3D,
+   JOURNAL_MusicPlaySong,
+   JOURNAL_MusicStopSong,
+   JOURNAL_MusicPause,
+   JOURNAL_MusicContinue,
+   JOURNAL_MusicSetVolume,
+   JOURNAL_MusicSetLoopFlag,
+   JOURNAL_MusicSetContext,
+   JOURNAL_MusicSetSongTick,
+   JOURNAL_MusicSetSongTime,
+   JOURNAL_MusicSetSongPosition,
+   JOURNAL_MusicSetChannelVolume,
+   JOURNAL_MusicResetChannelVolumes,
+   JOURNAL_NumOps
+   };
+
+typedef struct
+   {
+   int           op;
+   unsigned int  frame;      // since the previous record
+   int           result;
+   unsigned int  asset;
+   const char   *string;     // not terminated
+   unsigned int  length;
+   int           count;
+   int           args[ JOURNAL_MaxArgs ];
+   } JournalRecord;
+
+extern volatile int JOURNAL_Recording;
+
+int  JOURNAL_Start( const char *filename );
+void JOURNAL_Stop( void );
+
+void JOURNAL_Call( int op, int result, int count, ... );
+void JOURNAL_CallAsset( int op, int result, const void *data, unsigned int length,
+   int count, ... );
+void JOURNAL_CallString( int op, int result, const char *string, int count, ... );
+
+const unsigned char *JOURNAL_ReadHeader( const unsigned char *p, const unsigned char *end );
+const unsigned char *JOURNAL_Read( const unsigned char *p, const unsigned char *end,
+   JournalRecord *record );
+
+#endif
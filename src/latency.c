@@ -0,0 +1,206 @@
+/*
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+ */
+
+/**
+ * Measures how long sounds take from the play call to the driver
+ *
+ *   latency [-n starts] [-v]
+ *
+ * Short sounds are started at random intervals under a series of driver
+ * configurations and FX_GetLatency is read after each: FX_Render pulled
+ * a block at a time, the FileSink driver paced to the clock at several
+ * mix rates, the same with another thread contending for the mixer lock,
+ * and then each sound device driver built in, skipping any that cannot
+ * be opened. The CSV printed gives the time in microseconds to a start
+ * being mixed and to its block being handed to the driver. With -v the
+ * output frame each recent start landed on is listed too.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "fx_man.h"
+#include "sndcards.h"
+#include "asssys.h"
+
+#define BLOCKFRAMES 256     // one MultiVoc mix block at a time
+#define SOUNDFRAMES 1102    // a tenth of a second at 11025 Hz
+
+typedef struct {
+    const char * name;
+    int card;
+    int rate;
+    int contend;
+} config;
+
+static const config configs[] = {
+    { "render",          ASS_NoSound,     44100, 0 },
+    { "filesink",        ASS_FileSink,    11025, 0 },
+    { "filesink",        ASS_FileSink,    22050, 0 },
+    { "filesink",        ASS_FileSink,    44100, 0 },
+    { "filesink",        ASS_FileSink,    48000, 0 },
+    { "filesink+lock",   ASS_FileSink,    44100, 1 },
+    { "sdl",             ASS_SDL,         44100, 0 },
+    { "coreaudio",       ASS_CoreAudio,   44100, 0 },
+    { "directsound",     ASS_DirectSound, 44100, 0 },
+};
+
+static unsigned char Sound[SOUNDFRAMES];
+static volatile int StopContending;
+static volatile int ContendHandle;
+
+
+static int contend(void * arg)
+{
+    int pan = 0;
+
+    (void) arg;
+
+    // keep taking the lock, as a game updating many voices would
+    while (!StopContending) {
+        FX_SetPan(ContendHandle, 255, pan & 255, 255 - (pan & 255));
+        pan++;
+    }
+
+    return 0;
+}
+
+static void startsound(void)
+{
+    FX_PlayRaw((char *) Sound, SOUNDFRAMES, 11025, 0, 255, 255, 255, 1, 0);
+}
+
+static int measure(const config * c, int starts, int verbose)
+{
+    ASS_FileSinkOptions options;
+    ASS_StartLatency lat;
+    ASS_VoiceStart recent[64];
+    ASS_Thread * thread = 0;
+    short buf[BLOCKFRAMES * 2];
+    int channels = 2, bits = 16, rate = c->rate;
+    int i, n;
+
+    memset(&options, 0, sizeof(options));
+    options.realtime = 1;
+
+    if (FX_Init(c->card, 32, &channels, &bits, &rate,
+                c->card == ASS_FileSink ? &options : 0) != FX_Ok) {
+        return 0;
+    }
+    // FX_Init falls back to no sound for drivers not built in
+    if (FX_GetCurrentDriver() != c->card) {
+        FX_Shutdown();
+        return 0;
+    }
+
+    if (c->contend) {
+        ContendHandle = FX_PlayLoopedRaw((char *) Sound, SOUNDFRAMES, (char *) Sound,
+                                         (char *) Sound + SOUNDFRAMES - 1, 11025, 0,
+                                         0, 0, 0, 1, 0);
+        StopContending = 0;
+        thread = ASS_CreateThread(contend, 0);
+
+        // not to be counted with the starts
+        ASS_Sleep(100);
+    }
+
+    FX_ResetLatency();
+
+    for (i = 0; i < starts; i++) {
+        startsound();
+        if (c->card == ASS_NoSound) {
+            for (n = 1 + rand() % 8; n > 0; n--) {
+                FX_Render(buf, BLOCKFRAMES, channels, bits);
+            }
+        } else {
+            ASS_Sleep(5 + rand() % 25);
+        }
+    }
+
+    // let the last of them reach the driver
+    if (c->card == ASS_NoSound) {
+        FX_Render(buf, BLOCKFRAMES, channels, bits);
+    } else {
+        ASS_Sleep(200);
+    }
+
+    if (thread) {
+        StopContending = 1;
+        ASS_WaitThread(thread);
+    }
+
+    FX_GetLatency(&lat);
+    n = verbose ? FX_GetRecentStarts(recent, 64) : 0;
+    FX_Shutdown();
+
+    printf("%s,%d,%.0f,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u\n",
+           c->name, rate, BLOCKFRAMES * 1e6 / rate, lat.starts, lat.dropped,
+           lat.minmixed, lat.avgmixed, lat.p50mixed, lat.p99mixed, lat.maxmixed,
+           lat.minout, lat.avgout, lat.p50out, lat.p99out, lat.maxout);
+
+    for (i = n - 1; i >= 0; i--) {
+        printf("#   handle %d called at frame %u, landed on frame %u, mixed after %u us, "
+               "out after %u us\n", recent[i].handle, recent[i].callframe, recent[i].frame,
+               recent[i].mixed, recent[i].out);
+    }
+    fflush(stdout);
+
+    return 1;
+}
+
+int main(int argc, char ** argv)
+{
+    int starts = 100, verbose = 0;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (i + 1 < argc && !strcmp(argv[i], "-n")) {
+            starts = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-v")) {
+            verbose = 1;
+        } else {
+            starts = 0;
+            break;
+        }
+    }
+
+    if (starts < 1) {
+        fprintf(stderr, "usage: %s [-n starts] [-v]\n", argv[0]);
+        return 1;
+    }
+
+    for (i = 0; i < SOUNDFRAMES; i++) {
+        Sound[i] = (unsigned char) (128 + 60 * sin(i * 2 * M_PI * 440 / 11025));
+    }
+
+    srand(1);
+    printf("config,rate,block_us,starts,dropped,"
+           "mixed_min,mixed_avg,mixed_p50,mixed_p99,mixed_max,"
+           "out_min,out_avg,out_p50,out_p99,out_max\n");
+
+    for (i = 0; i < (int) (sizeof(configs) / sizeof(configs[0])); i++) {
+        if (!measure(&configs[i], starts, verbose)) {
+            fprintf(stderr, "%s at %d Hz: not available, skipped\n",
+                    configs[i].name, configs[i].rate);
+        }
+    }
+
+    return 0;
+}
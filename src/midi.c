@@ -1290,7 +1290,7 @@ void MIDI_StopSong
          _MIDI_Funcs->ReleasePatches();
          }
 
-      free( _MIDI_TrackPtr );
+      ASS_Free( _MIDI_TrackPtr );
 
       _MIDI_TrackPtr     = NULL;
       _MIDI_NumTracks    = 0;
@@ -1367,7 +1367,7 @@ int MIDI_PlaySong
       }
 
    _MIDI_TrackMemSize = _MIDI_NumTracks  * sizeof( track );
-   _MIDI_TrackPtr = (track *) malloc(_MIDI_TrackMemSize);
+   _MIDI_TrackPtr = (track *) ASS_Alloc(ASS_MemMIDI, _MIDI_TrackMemSize);
    if ( !_MIDI_TrackPtr )
       {
       return( MIDI_NoMemory );
@@ -1379,7 +1379,7 @@ int MIDI_PlaySong
       {
       if ( *( unsigned int * )ptr != LITTLE32(MIDI_TRACK_SIGNATURE) )
          {
-         free( _MIDI_TrackPtr );
+         ASS_Free( _MIDI_TrackPtr );
 
          _MIDI_TrackPtr = NULL;
          _MIDI_TrackMemSize = 0;
@@ -0,0 +1,304 @@
+/*
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+ */
+
+/**
+ * Builds a sound bank from PCM WAV and VOC files
+ *
+ *   mkbank out.bnk sound1.wav sound2.voc@1000 sound3.wav@0,22050 ...
+ *
+ * Entries are numbered in argument order. An optional @loopstart or
+ * @loopstart,loopend suffix gives loop points in sample frames.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "soundbank.h"
+#include "tools.h"
+
+typedef struct {
+    const char * filename;
+    unsigned char * data;
+    unsigned int length;     // bytes
+    unsigned int rate;
+    int bits;
+    int channels;
+    unsigned int loopstart;
+    unsigned int loopend;
+} bankentry;
+
+static int appendpcm(bankentry * e, const unsigned char * p, unsigned int length,
+                     unsigned int rate, int bits, int channels)
+{
+    unsigned char * data;
+
+    if (e->bits == 0) {
+        e->rate = rate;
+        e->bits = bits;
+        e->channels = channels;
+    } else if (e->rate != rate || e->bits != bits || e->channels != channels) {
+        fprintf(stderr, "%s: format changes part way, ignoring the rest\n", e->filename);
+        return 0;
+    }
+
+    length -= length % (channels * bits / 8);
+
+    data = (unsigned char *) realloc(e->data, e->length + length + 1);
+    if (!data) {
+        return 0;
+    }
+    memcpy(data + e->length, p, length);
+    e->data = data;
+    e->length += length;
+
+    return 1;
+}
+
+static int parsewav(bankentry * e, const unsigned char * file, unsigned int size)
+{
+    unsigned int pos = 12, chunklength;
+    unsigned int rate = 0;
+    int bits = 0, channels = 0;
+
+    while (pos + 8 <= size) {
+        chunklength = read_le32(file + pos + 4);
+        if (chunklength > size - pos - 8) {
+            chunklength = size - pos - 8;
+        }
+
+        if (!memcmp(file + pos, "fmt ", 4) && chunklength >= 16) {
+            const unsigned char * f = file + pos + 8;
+
+            if (read_le16(f) != 1) {
+                fprintf(stderr, "%s: only PCM WAV files are supported\n", e->filename);
+                return 0;
+            }
+            channels = read_le16(f + 2);
+            rate = read_le32(f + 4);
+            bits = read_le16(f + 14);
+        } else if (!memcmp(file + pos, "data", 4)) {
+            if ((bits != 8 && bits != 16) || (channels != 1 && channels != 2)) {
+                break;
+            }
+            return appendpcm(e, file + pos + 8, chunklength, rate, bits, channels);
+        }
+
+        pos += 8 + chunklength + (chunklength & 1);
+    }
+
+    fprintf(stderr, "%s: invalid WAV file\n", e->filename);
+    return 0;
+}
+
+static int parsevoc(bankentry * e, const unsigned char * file, unsigned int size)
+{
+    unsigned int pos, blocklength;
+    unsigned int tc = 0, packtype = 0, voicemode = 0;
+    int lastblocktype = 0, blocktype;
+
+    pos = read_le16(file + 20);
+
+    while (pos + 4 <= size && file[pos] != 0) {
+        blocktype = file[pos];
+        blocklength = file[pos + 1] | (file[pos + 2] << 8) | (file[pos + 3] << 16);
+        pos += 4;
+        if (blocklength > size - pos) {
+            blocklength = size - pos;
+        }
+
+        switch (blocktype) {
+            case 1:
+                if (blocklength < 2) {
+                    break;
+                }
+                if (lastblocktype != 8) {
+                    tc = file[pos] << 8;
+                    packtype = file[pos + 1];
+                    voicemode = 0;
+                }
+                if (packtype == 0 && voicemode <= 1) {
+                    if (!appendpcm(e, file + pos + 2, blocklength - 2,
+                                   256000000L / ((voicemode + 1) * (65536 - tc)),
+                                   8, voicemode + 1)) {
+                        return e->length > 0;
+                    }
+                }
+                break;
+
+            case 2:
+                if (e->bits) {
+                    appendpcm(e, file + pos, blocklength, e->rate, e->bits, e->channels);
+                }
+                break;
+
+            case 8:
+                if (blocklength >= 4) {
+                    tc = read_le16(file + pos);
+                    packtype = file[pos + 2];
+                    voicemode = file[pos + 3];
+                }
+                break;
+
+            case 9:
+                if (blocklength >= 12 && (file[pos + 5] == 1 || file[pos + 5] == 2) &&
+                    ((file[pos + 4] == 8 && read_le16(file + pos + 6) == 0) ||
+                     (file[pos + 4] == 16 && read_le16(file + pos + 6) == 4))) {
+                    if (!appendpcm(e, file + pos + 12, blocklength - 12,
+                                   read_le32(file + pos), file[pos + 4], file[pos + 5])) {
+                        return e->length > 0;
+                    }
+                }
+                break;
+
+            default:
+                // silence, markers, text and repeats are not kept
+                break;
+        }
+
+        lastblocktype = blocktype;
+        pos += blocklength;
+    }
+
+    if (e->length == 0) {
+        fprintf(stderr, "%s: no PCM data found in VOC file\n", e->filename);
+        return 0;
+    }
+
+    return 1;
+}
+
+static int loadentry(bankentry * e, char * arg)
+{
+    unsigned char * file;
+    unsigned int size;
+    char * loop;
+    int ok;
+
+    memset(e, 0, sizeof(bankentry));
+    e->loopstart = SOUNDBANK_NOLOOP;
+
+    loop = strrchr(arg, '@');
+    if (loop) {
+        *loop++ = 0;
+        e->loopstart = strtoul(loop, &loop, 10);
+        if (*loop == ',') {
+            e->loopend = strtoul(loop + 1, 0, 10);
+        }
+    }
+    e->filename = arg;
+
+    file = (unsigned char *) loadfile(arg, &size);
+    if (!file) {
+        fprintf(stderr, "%s: could not read\n", arg);
+        return 0;
+    }
+
+    if (size >= 22 && !memcmp("Creative Voice File\x1a", file, 20)) {
+        ok = parsevoc(e, file, size);
+    } else if (size >= 12 && !memcmp("RIFF", file, 4) && !memcmp("WAVE", file + 8, 4)) {
+        ok = parsewav(e, file, size);
+    } else {
+        fprintf(stderr, "%s: not a WAV or VOC file\n", arg);
+        ok = 0;
+    }
+
+    free(file);
+    return ok;
+}
+
+int main(int argc, char ** argv)
+{
+    bankentry * entries;
+    unsigned char header[SOUNDBANK_HEADER_SIZE];
+    unsigned char entry[SOUNDBANK_ENTRY_SIZE];
+    static const unsigned char pad[SOUNDBANK_ALIGN];
+    unsigned int offset;
+    int numentries, i;
+    FILE * fp;
+
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s bankfile sound[@loopstart[,loopend]] ...\n", argv[0]);
+        return 1;
+    }
+
+    numentries = argc - 2;
+    entries = (bankentry *) calloc(numentries, sizeof(bankentry));
+    if (!entries) {
+        return 1;
+    }
+
+    for (i = 0; i < numentries; i++) {
+        if (!loadentry(&entries[i], argv[i + 2])) {
+            return 1;
+        }
+    }
+
+    fp = fopen(argv[1], "wb");
+    if (!fp) {
+        fprintf(stderr, "%s: could not create\n", argv[1]);
+        return 1;
+    }
+
+    memset(header, 0, sizeof(header));
+    memcpy(header, SOUNDBANK_MAGIC, 4);
+    write_le32(header + 4, SOUNDBANK_VERSION);
+    write_le32(header + 8, numentries);
+    fwrite(header, 1, sizeof(header), fp);
+
+    offset = SOUNDBANK_HEADER_SIZE + numentries * SOUNDBANK_ENTRY_SIZE;
+    for (i = 0; i < numentries; i++) {
+        bankentry * e = &entries[i];
+
+        offset = (offset + SOUNDBANK_ALIGN - 1) & ~(SOUNDBANK_ALIGN - 1);
+
+        memset(entry, 0, sizeof(entry));
+        write_le32(entry + SOUNDBANK_OFFSET, offset);
+        write_le32(entry + SOUNDBANK_LENGTH, e->length / (e->channels * e->bits / 8));
+        write_le32(entry + SOUNDBANK_RATE, e->rate);
+        write_le32(entry + SOUNDBANK_LOOPSTART, e->loopstart);
+        write_le32(entry + SOUNDBANK_LOOPEND, e->loopend);
+        entry[SOUNDBANK_BITS] = e->bits;
+        entry[SOUNDBANK_CHANNELS] = e->channels;
+        fwrite(entry, 1, sizeof(entry), fp);
+
+        offset += e->length;
+    }
+
+    offset = SOUNDBANK_HEADER_SIZE + numentries * SOUNDBANK_ENTRY_SIZE;
+    for (i = 0; i < numentries; i++) {
+        bankentry * e = &entries[i];
+
+        fwrite(pad, 1, -offset & (SOUNDBANK_ALIGN - 1), fp);
+        offset = (offset + SOUNDBANK_ALIGN - 1) & ~(SOUNDBANK_ALIGN - 1);
+
+        fwrite(e->data, 1, e->length, fp);
+        offset += e->length;
+
+        printf("%3d  %s  %uHz %d-bit %s, %u frames\n", i, e->filename, e->rate,
+               e->bits, e->channels == 2 ? "stereo" : "mono",
+               e->length / (e->channels * e->bits / 8));
+    }
+
+    if (fclose(fp)) {
+        fprintf(stderr, "%s: write failed\n", argv[1]);
+        return 1;
+    }
+
+    return 0;
+}
@@ -34,10 +34,13 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <string.h>
 #include <time.h>
 #include <stdio.h>
+#include <math.h>
 #include "linklist.h"
 #include "sndcards.h"
+#include "asssys.h"
 #include "drivers.h"
 #include "pitch.h"
+#include "trace.h"
 #include "multivoc.h"
 #include "_multivc.h"
 
@@ -89,6 +92,7 @@ static signed short MV_VolumeTable[ 63 + 1 ][ 256 ];
 Pan MV_PanTable[ MV_NumPanPositions ][ 63 + 1 ];
 
 int MV_Installed   = FALSE;
+int MV_Rendering   = FALSE;
 static int MV_TotalVolume = MV_MaxTotalVolume;
 static int MV_MaxVoices   = 1;
 static int MV_Recording;
@@ -104,10 +108,78 @@ static int MV_Bits       = 8;
 
 static int MV_Silence    = SILENCE_8BIT;
 static int MV_SwapLeftRight = FALSE;
+static int MV_DefaultResampler = MV_ResampleNearest;
 
 static int MV_RequestedMixRate;
 int MV_MixRate;
 
+static int  MV_MixDivisor = 1;
+static int  MV_MixLength  = MixBufferSize;
+static char MV_LowRateBuffer[ MixBufferSize * STEREO_16BIT_SAMPLE_SIZE ];
+static UpsampleState MV_LowRateUpsample;
+
+static int  MV_LODThreshold = 0;
+static int  MV_LODDivisor   = 2;
+static int  MV_LODMixed;
+static int  MV_LODPending;
+static char MV_LODBuffer[ MixBufferSize * STEREO_16BIT_SAMPLE_SIZE ];
+static UpsampleState MV_LODUpsample;
+
+// Four histogram buckets per octave of block mixing time
+#define MV_StatsBuckets 128
+
+static ASS_MixStats MV_Stats;
+static uint64_t     MV_StatsTotalTime;
+static unsigned int MV_StatsHistogram[ MV_StatsBuckets ];
+static unsigned int MV_BlockTime;          // microseconds a block plays for
+static int          MV_StatsClockRunning;
+static unsigned int MV_StatsClockStart;
+static unsigned int MV_StatsClockBlocks;
+
+// Per-voice costs, accumulated by key until the next query
+#define MV_ProfileEntries 64
+
+typedef struct
+   {
+   int              used;
+   ASS_VoiceProfile profile;
+   uint64_t         mixtime;        // nanoseconds
+   uint64_t         refilltime;
+   } MV_ProfileEntry;
+
+static volatile unsigned int MV_MixedFrames;    // never reset
+static unsigned int          MV_ServiceCount;
+
+// Voice starts are timed when first mixed and again when that block goes
+// to the driver. The drivers prime a block before playing page 0, while
+// MV_StartPlayback leaves MV_MixPage at 1, so a block is handed over just
+// after the second service following the one that mixed it.
+#define MV_HandoffLag     2
+#define MV_PendingStarts  64
+#define MV_RecentStarts   64     // a power of two
+
+typedef struct
+   {
+   ASS_VoiceStart start;
+   unsigned int   service;      // MV_ServiceCount when first mixed
+   } MV_PendingStart;
+
+static ASS_StartLatency MV_Latency;
+static uint64_t         MV_LatencyTotal[ 2 ];     // mixed, out
+static unsigned int     MV_LatencyHistogram[ 2 ][ MV_StatsBuckets ];
+static MV_PendingStart  MV_Pending[ MV_PendingStarts ];
+static int              MV_NumPending;
+static ASS_VoiceStart   MV_Recent[ MV_RecentStarts ];
+static unsigned int     MV_NumRecent;
+
+static ASS_OutputLevels MV_Levels;
+static uint64_t         MV_LevelsSquares[ 2 ];    // summed since the reset
+static uint64_t         MV_LevelsSamples;         // per channel
+
+static int             MV_ProfileMode = MV_ProfileOff;
+static MV_ProfileEntry MV_Profile[ MV_ProfileEntries ];
+static unsigned int    MV_ProfileRefillTime;
+
 static int MV_BuffShift;
 
 static int MV_TotalMemory;
@@ -121,6 +193,7 @@ static volatile VoiceNode VoiceList;
 static volatile VoiceNode VoicePool;
 
 static int MV_MixPage      = 0;
+static int MV_RenderLeft   = 0;
 static int MV_VoiceHandle  = MV_MinVoiceHandle;
 
 static void ( *MV_CallBackFunc )( unsigned int ) = NULL;
@@ -143,10 +216,14 @@ int MV_ErrorCode = MV_Ok;
 static int lockdepth = 0;
 static int DisableInterrupts(void)
 {
+	TraceSpan span;
+
 	if (lockdepth++ > 0) {
 		return 0;
 	}
+	TRACE_BEGIN(span);
 	SoundDriver_PCM_Lock();
+	TRACE_END(span, "lock wait", 0);
 	return 0;
 }
 
@@ -158,6 +235,18 @@ static void RestoreInterrupts(int a)
 	SoundDriver_PCM_Unlock();
 }
 
+// Entry points for the other MultiVoc source modules to take the
+// same nested lock as the functions in this file.
+void MV_Lock(void)
+{
+	DisableInterrupts();
+}
+
+void MV_Unlock(void)
+{
+	RestoreInterrupts(0);
+}
+
 
 /*---------------------------------------------------------------------
    Function: MV_ErrorString
@@ -229,6 +318,22 @@ const char *MV_ErrorString
          ErrorString = "Null record function passed to MV_StartRecording.";
          break;
 
+      case MV_FileError :
+         ErrorString = "Unable to open sound file in Multivoc.";
+         break;
+
+      case MV_InvalidBank :
+         ErrorString = "Invalid sound bank passed in to Multivoc.";
+         break;
+
+      case MV_UnknownFormat :
+         ErrorString = "Unrecognised sound format passed in to Multivoc.";
+         break;
+
+      case MV_InvalidSoundID :
+         ErrorString = "Invalid sound ID passed in to Multivoc.";
+         break;
+
       default :
          ErrorString = "Unknown Multivoc error code.";
          break;
@@ -238,6 +343,126 @@ const char *MV_ErrorString
    }
 
 
+/*---------------------------------------------------------------------
+   Function: MV_GetSound
+
+   Asks a voice for its next block of sound, counting the refill.
+---------------------------------------------------------------------*/
+
+static playbackstatus MV_GetSound
+   (
+   VoiceNode *voice
+   )
+
+   {
+   playbackstatus status;
+   unsigned int   start;
+   TraceSpan      span;
+
+   MV_Stats.refills[ voice->wavetype & 7 ]++;
+
+   TRACE_BEGIN( span );
+
+   if ( MV_ProfileMode == MV_ProfileOff )
+      {
+      status = voice->GetSound( voice );
+      }
+   else
+      {
+      start  = ASS_GetNanoTicks();
+      status = voice->GetSound( voice );
+      MV_ProfileRefillTime += ASS_GetNanoTicks() - start;
+      }
+
+   TRACE_END( span, "GetSound", voice->handle );
+
+   return( status );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: MV_MixInterpolated
+
+   Mixes a voice through its interpolating resampler. The filters look
+   a few frames ahead, so the last output frames of a block wait for
+   the next block and read back into what is kept of this one.
+---------------------------------------------------------------------*/
+
+static void MV_MixInterpolated
+   (
+   VoiceNode   *voice,
+   int          length,
+   unsigned int scale
+   )
+
+   {
+   int      voclength;
+   int64_t  position;
+   int64_t  limit;
+   int64_t  rate;
+
+   while( length > 0 )
+      {
+      rate     = ( int64_t )( voice->RateScale * scale );
+      position = ( int64_t )voice->position - ( int64_t )voice->carry;
+      limit    = ( int64_t )voice->length - ( ( int64_t )MV_ResampleAhead << 32 );
+
+      if ( position < limit )
+         {
+         voclength = length;
+         if ( ( position + rate * ( length - 1 ) ) >= limit )
+            {
+            voclength = ( int )( ( limit - position + rate - 1 ) / rate );
+            }
+
+         MV_MixResampled( voice, position, rate, voclength );
+
+         position += rate * voclength;
+         length   -= voclength;
+         }
+      else
+         {
+         // Get the next block of sound, with the position carried
+         // over as the block's own GetSound would leave it
+         MV_SaveResampleHistory( voice );
+         position       -= ( int64_t )voice->length;
+         voice->position = voice->length;
+         voice->carry    = 0;
+
+         if ( MV_GetSound( voice ) != KeepPlaying )
+            {
+            if ( position < 0 )
+               {
+               voclength = ( int )( ( -position + rate - 1 ) / rate );
+               MV_MixResampledHistory( voice, position, rate,
+                  min( voclength, length ) );
+               }
+            return;
+            }
+
+         position += ( int64_t )voice->position;
+         }
+
+      if ( position < 0 )
+         {
+         voice->position = 0;
+         voice->carry    = ( uint64_t )-position;
+         }
+      else
+         {
+         voice->position = ( uint64_t )position;
+         voice->carry    = 0;
+         }
+
+      if ( voice->length == 0 )
+         {
+         // Nothing came yet, try again next time
+         return;
+         }
+      }
+   }
+
+
 /*---------------------------------------------------------------------
    Function: MV_Mix
 
@@ -254,19 +479,38 @@ static void MV_Mix
    char          *start;
    int            length;
    int            voclength;
-   unsigned int   position;
-   unsigned int   rate;
-   unsigned int   FixedPointBufferSize;
+   uint64_t       position;
+   uint64_t       rate;
+   unsigned int   scale;
 
-   if ( ( voice->length == 0 ) && ( voice->GetSound( voice ) != KeepPlaying ) )
+   if ( ( voice->length == 0 ) && ( MV_GetSound( voice ) != KeepPlaying ) )
       {
       return;
       }
 
-   length               = MixBufferSize;
-   FixedPointBufferSize = voice->FixedPointBufferSize;
+   length               = MV_MixLength;
+   scale                = 1;
 
    MV_MixDestination    = MV_MixBuffer[ buffer ];
+   if ( voice->gain < MV_LODThreshold )
+      {
+      // Quiet voices share a side buffer at an even lower rate
+      if ( !MV_LODMixed )
+         {
+         ClearBuffer_DW( MV_LODBuffer, MV_Silence,
+            ( MV_MixLength / MV_LODDivisor * MV_SampleSize ) >> 2 );
+         MV_LODMixed = TRUE;
+         }
+
+      length               = MV_MixLength / MV_LODDivisor;
+      scale                = MV_LODDivisor;
+      MV_MixDestination    = MV_LODBuffer;
+      }
+   else if ( MV_MixDivisor > 1 )
+      {
+      // Voices are mixed at the lower rate and upsampled afterwards
+      MV_MixDestination    = MV_LowRateBuffer;
+      }
    MV_LeftVolume        = voice->LeftVolume;
    MV_RightVolume       = voice->RightVolume;
 
@@ -276,24 +520,29 @@ static void MV_Mix
       MV_MixDestination += MV_RightChannelOffset;
       }
 
+   if ( voice->resampler != MV_ResampleNearest )
+      {
+      MV_MixInterpolated( voice, length, scale );
+      return;
+      }
+
    // Add this voice to the mix
    while( length > 0 )
       {
-      start    = voice->sound;
-      rate     = voice->RateScale;
+      rate     = voice->RateScale * scale;
       position = voice->position;
 
       // Check if the last sample in this buffer would be
       // beyond the length of the sample block
-      if ( ( position + FixedPointBufferSize ) >= voice->length )
+      if ( ( position + rate * ( length - 1 ) ) >= voice->length )
          {
          if ( position < voice->length )
             {
-            voclength = ( voice->length - position + rate - voice->channels ) / rate;
+            voclength = ( voice->length - position + rate - 1 ) / rate;
             }
          else
             {
-            voice->GetSound( voice );
+            MV_GetSound( voice );
             return;
             }
          }
@@ -301,30 +550,25 @@ static void MV_Mix
          {
          voclength = length;
          }
-
-
-
       if (voice->mix) {
-         voice->mix( position, rate, start, voclength );
+         // The mixers step a 16.16 position from the current frame
+         start = voice->sound + ( position >> 32 ) *
+            ( voice->channels * voice->bits / 8 );
+         voice->mix( ( unsigned int )position >> 16, ( unsigned int )( rate >> 16 ),
+            start, voclength );
       }
 
-      voice->position = MV_MixPosition;
+      voice->position = position + rate * voclength;
 
       length -= voclength;
 
       if ( voice->position >= voice->length )
          {
          // Get the next block of sound
-         if ( voice->GetSound( voice ) != KeepPlaying )
+         if ( MV_GetSound( voice ) != KeepPlaying )
             {
             return;
             }
-
-         if ( length > (voice->channels - 1) )
-            {
-            // Get the position of the last sample in the buffer
-            FixedPointBufferSize = voice->RateScale * ( length - voice->channels );
-            }
          }
       }
    }
@@ -351,6 +595,37 @@ void MV_PlayVoice
    }
 
 
+/*---------------------------------------------------------------------
+   Function: MV_ReleaseVoice
+
+   Frees any decoder or stream attached to a voice that has stopped.
+   Called with interrupts disabled or from within MV_ServiceVoc.
+---------------------------------------------------------------------*/
+
+static void MV_ReleaseVoice
+   (
+   VoiceNode *voice
+   )
+
+   {
+   switch( voice->wavetype )
+      {
+      #ifdef HAVE_VORBIS
+      case Vorbis :
+         MV_ReleaseVorbisVoice( voice );
+         break;
+      #endif
+
+      case Stream :
+         MV_ReleaseStreamVoice( voice );
+         break;
+
+      default :
+         break;
+      }
+   }
+
+
 /*---------------------------------------------------------------------
    Function: MV_StopVoice
 
@@ -371,1491 +646,2643 @@ static void MV_StopVoice
    LL_Remove( voice, next, prev );
    LL_Add( (VoiceNode*) &VoicePool, voice, next, prev );
 
+   MV_ReleaseVoice( voice );
+
    RestoreInterrupts( flags );
-   
-   #ifdef HAVE_VORBIS
-   if (voice->wavetype == Vorbis)
-      {
-      MV_ReleaseVorbisVoice(voice);
-      }
-   #endif
    }
 
 
 /*---------------------------------------------------------------------
-   Function: MV_ServiceVoc
-
-   Starts playback of the waiting buffer and mixes the next one.
+   Function: MV_StatsBucket
 
-   JBF: no synchronisation happens inside MV_ServiceVoc nor the
-        supporting functions it calls. This would cause a deadlock
-        between the mixer thread in the driver vs the nested
-        locking in the user-space functions of MultiVoc. The call
-        to MV_ServiceVoc is synchronised in the driver.
-
-        Known functions called by MV_ServiceVoc and its helpers:
-           MV_Mix (and its MV_Mix*bit* workers)
-           MV_GetNextVOCBlock
-           MV_GetNextWAVBlock
-           MV_SetVoiceMixMode
+   Returns the histogram bucket for a block mixing time, or the upper
+   bound of a bucket's times when asked in reverse.
 ---------------------------------------------------------------------*/
-static void MV_ServiceVoc
+
+static int MV_StatsBucket
    (
-   void
+   unsigned int usec
    )
 
    {
-   VoiceNode *voice;
-   VoiceNode *next;
-	//int        flags;
+   int octave;
 
-   // Toggle which buffer we'll mix next
-   MV_MixPage++;
-   if ( MV_MixPage >= MV_NumberOfBuffers )
+   if ( usec < 4 )
       {
-      MV_MixPage -= MV_NumberOfBuffers;
+      return( usec );
       }
 
-   if ( MV_ReverbLevel == 0 )
+   for( octave = 0; ( usec >> octave ) >= 8; octave++ )
+      ;
+
+   return( 4 + octave * 4 + ( usec >> octave ) - 4 );
+   }
+
+static unsigned int MV_StatsBucketLimit
+   (
+   int bucket
+   )
+
+   {
+   if ( bucket < 4 )
       {
-      // Initialize buffer
-      //Commented out so that the buffer is always cleared.
-      //This is so the guys at Echo Speech can mix into the
-      //buffer even when no sounds are playing.
-      //if ( !MV_BufferEmpty[ MV_MixPage ] )
-         {
-         ClearBuffer_DW( MV_MixBuffer[ MV_MixPage ], MV_Silence, MV_BufferSize >> 2 );
-         MV_BufferEmpty[ MV_MixPage ] = TRUE;
-         }
+      return( bucket );
       }
-   else
-      {
-      char *end;
-      char *source;
-      char *dest;
-      int   count;
-      int   length;
-
-      end = MV_MixBuffer[ 0 ] + MV_BufferLength;;
-      dest = MV_MixBuffer[ MV_MixPage ];
-      source = MV_MixBuffer[ MV_MixPage ] - MV_ReverbDelay;
-      if ( source < MV_MixBuffer[ 0 ] )
-         {
-         source += MV_BufferLength;
-         }
 
-      length = MV_BufferSize;
-      while( length > 0 )
-         {
-         count = length;
-         if ( source + count > end )
-            {
-            count = end - source;
-            }
+   return( ( ( ( bucket - 4 ) % 4 + 5 ) << ( ( bucket - 4 ) / 4 ) ) - 1 );
+   }
 
-         if ( MV_Bits == 16 )
-            {
-            if ( MV_ReverbTable != NULL )
-               {
-               MV_16BitReverb( source, dest, MV_ReverbTable, count / 2 );
-               }
-            else
-               {
-               MV_16BitReverbFast( source, dest, count / 2, MV_ReverbLevel );
-               }
-            }
-         else
-            {
-            if ( MV_ReverbTable != NULL )
-               {
-               MV_8BitReverb( (signed char *) source, (signed char *) dest, MV_ReverbTable, count );
-               }
-            else
-               {
-               MV_8BitReverbFast( (signed char *) source, (signed char *) dest, count, MV_ReverbLevel );
-               }
-            }
 
-         // if we go through the loop again, it means that we've wrapped around the buffer
-         source  = MV_MixBuffer[ 0 ];
-         dest   += count;
-         length -= count;
-         }
-      }
+/*---------------------------------------------------------------------
+   Function: MV_RecordBlockStats
 
-   // Play any waiting voices
-   //flags = DisableInterrupts();
-	
-   for( voice = VoiceList.next; voice != &VoiceList; voice = next )
-      {
-      if ( voice->Paused )
-         {
-         next = voice->next;
-         continue;
-         }
-      
-      MV_BufferEmpty[ MV_MixPage ] = FALSE;
+   Adds a mixed block's timing and voice counts to the statistics.
+---------------------------------------------------------------------*/
 
-      MV_MixFunction( voice, MV_MixPage );
+static void MV_RecordBlockStats
+   (
+   unsigned int start,
+   int          mixed,
+   int          paused
+   )
 
-      next = voice->next;
+   {
+   unsigned int elapsed;
 
-      // Is this voice done?
-      if ( !voice->Playing )
-         {
-         //JBF: prevent a deadlock caused by MV_StopVoice grabbing the mutex again
-			//MV_StopVoice( voice );
-         LL_Remove( voice, next, prev );
-         LL_Add( (VoiceNode*) &VoicePool, voice, next, prev );
+   elapsed = ASS_GetMicroTicks() - start;
 
-         if ( MV_CallBackFunc )
-            {
-            MV_CallBackFunc( voice->callbackval );
-            }
-         }
+   if ( MV_Stats.blocks == 0 || elapsed < MV_Stats.mintime )
+      {
+      MV_Stats.mintime = elapsed;
       }
-	
-   //RestoreInterrupts(flags);
+   if ( elapsed > MV_Stats.maxtime )
+      {
+      MV_Stats.maxtime = elapsed;
+      }
+   MV_StatsTotalTime += elapsed;
+   MV_StatsHistogram[ MV_StatsBucket( elapsed ) ]++;
+   MV_Stats.blocks++;
+
+   MV_Stats.voicesmixed  = mixed;
+   MV_Stats.voicespaused = paused;
+   MV_Stats.peakvoices   = max( MV_Stats.peakvoices, mixed );
    }
 
 
 /*---------------------------------------------------------------------
-   Function: MV_GetNextVOCBlock
+   Function: MV_StartLanded
 
-   Interperate the information of a VOC format sound file.
+   Notes the block a starting voice was first mixed into.
 ---------------------------------------------------------------------*/
 
-static playbackstatus MV_GetNextVOCBlock
+static void MV_StartLanded
    (
    VoiceNode *voice
    )
 
    {
-   unsigned char *ptr;
-   int            blocktype;
-   int            lastblocktype;
-   unsigned int   blocklength = 0;
-   unsigned int   samplespeed = 0;
-   unsigned int   tc = 0;
-   int            packtype;
-   int            voicemode;
-   int            done;
-   unsigned       BitsPerSample;
-   unsigned       Channels;
-   unsigned       Format;
+   MV_PendingStart *pending;
+
+   voice->timing = FALSE;
 
-   if ( voice->BlockLength > 0 )
+   if ( MV_NumPending >= MV_PendingStarts )
       {
-      voice->position    -= voice->length;
-      voice->sound       += (voice->length >> 16) * (voice->channels * voice->bits / 8);
-      voice->length       = min( voice->BlockLength, 0x8000 );
-      voice->BlockLength -= voice->length;
-      voice->length     <<= 16;
-      return( KeepPlaying );
+      MV_Latency.dropped++;
+      return;
       }
 
-   ptr = ( unsigned char * )voice->NextBlock;
+   pending = &MV_Pending[ MV_NumPending++ ];
+   pending->start.handle    = voice->handle;
+   pending->start.calltime  = voice->calltime;
+   pending->start.callframe = voice->callframe;
+   pending->start.frame     = MV_MixedFrames - MixBufferSize;
+   pending->start.mixed     = ASS_GetMicroTicks() - voice->calltime;
+   pending->start.out       = 0;
+   pending->service         = MV_ServiceCount;
+   }
 
-   voice->Playing = TRUE;
 
-   voicemode = 0;
-   lastblocktype = 0;
-   packtype = 0;
+/*---------------------------------------------------------------------
+   Function: MV_HandOffStarts
 
-   done = FALSE;
-   while( !done )
+   Adds the starts in blocks now going to the driver to the latency
+   statistics. The lag is how many services ago such blocks were mixed.
+---------------------------------------------------------------------*/
+
+static void MV_HandOffStarts
+   (
+   unsigned int lag
+   )
+
+   {
+   ASS_VoiceStart *start;
+   unsigned int    now;
+   int             i;
+   int             kept;
+
+   if ( MV_NumPending == 0 )
       {
-      // Stop playing if we get a NULL pointer
-      if ( ptr == NULL )
+      return;
+      }
+
+   now  = ASS_GetMicroTicks();
+   kept = 0;
+   for( i = 0; i < MV_NumPending; i++ )
+      {
+      if ( MV_ServiceCount - MV_Pending[ i ].service < lag )
          {
-         voice->Playing = FALSE;
-         done = TRUE;
-         break;
+         MV_Pending[ kept++ ] = MV_Pending[ i ];
+         continue;
          }
 
-      blocktype = ( int )*ptr;
-      blocklength = LITTLE32( *( unsigned int * )( ptr + 1 ) ) & 0x00ffffff;
-      ptr += 4;
+      start = &MV_Pending[ i ].start;
+      start->out = now - start->calltime;
 
-      switch( blocktype )
+      if ( MV_Latency.starts == 0 || start->mixed < MV_Latency.minmixed )
          {
-         case 0 :
-            // End of data
-            if ( ( voice->LoopStart == NULL ) ||
-               ( (intptr_t) voice->LoopStart >= ( (intptr_t) ptr - 4 ) ) )
-               {
-               voice->Playing = FALSE;
-               done = TRUE;
-               }
-            else
-               {
-               voice->NextBlock    = voice->LoopStart;
-               voice->BlockLength  = 0;
-               voice->position     = 0;
-               return MV_GetNextVOCBlock(voice);
-               }
-            break;
-
-         case 1 :
-            // Sound data block
-            voice->bits  = 8;
-            voice->channels = voicemode + 1;
-            if ( lastblocktype != 8 )
-               {
-               tc = ( unsigned int )*ptr << 8;
-               packtype = *( ptr + 1 );
-               }
+         MV_Latency.minmixed = start->mixed;
+         }
+      if ( MV_Latency.starts == 0 || start->out < MV_Latency.minout )
+         {
+         MV_Latency.minout = start->out;
+         }
+      MV_Latency.maxmixed = max( MV_Latency.maxmixed, start->mixed );
+      MV_Latency.maxout   = max( MV_Latency.maxout, start->out );
+      MV_Latency.starts++;
 
-            ptr += 2;
-            blocklength -= 2;
+      MV_LatencyTotal[ 0 ] += start->mixed;
+      MV_LatencyTotal[ 1 ] += start->out;
+      MV_LatencyHistogram[ 0 ][ MV_StatsBucket( start->mixed ) ]++;
+      MV_LatencyHistogram[ 1 ][ MV_StatsBucket( start->out ) ]++;
 
-            samplespeed = 256000000L / ( voice->channels * ( 65536 - tc ) );
- 
-            // Skip packed or stereo data
-            if ( ( packtype != 0 ) || ( voicemode != 0 && voicemode != 1 ) )
-               {
-               ptr += blocklength;
-               }
-            else
-               {
-               done = TRUE;
-               }
-            voicemode = 0;
-            break;
+      MV_Recent[ MV_NumRecent++ & ( MV_RecentStarts - 1 ) ] = *start;
+      }
+   MV_NumPending = kept;
+   }
 
-         case 2 :
-            // Sound continuation block
-            samplespeed = voice->SamplingRate;
-            done = TRUE;
-            break;
 
-         case 3 :
-            // Silence
-            // Not implimented.
-            ptr += blocklength;
-            break;
+/*---------------------------------------------------------------------
+   Function: MV_ProfileVoice
 
-         case 4 :
-            // Marker
-            // Not implimented.
-            ptr += blocklength;
-            break;
+   Mixes a voice, charging the time taken to its profile entry.
+---------------------------------------------------------------------*/
 
-         case 5 :
-            // ASCII string
-            // Not implimented.
-            ptr += blocklength;
-            break;
+static void MV_ProfileVoice
+   (
+   VoiceNode *voice,
+   int        buffer
+   )
 
-         case 6 :
-            // Repeat begin
-            if ( voice->LoopEnd == NULL )
-               {
-               voice->LoopCount = LITTLE16(*( unsigned short * )ptr);
-               voice->LoopStart = (char *)((intptr_t) ptr + blocklength);
-               }
-            ptr += blocklength;
-            break;
+   {
+   MV_ProfileEntry *entry;
+   unsigned int     key;
+   unsigned int     start;
+   unsigned int     elapsed;
+   int              slot;
+   int              probe;
 
-         case 7 :
-            // Repeat end
-            ptr += blocklength;
-            if ( lastblocktype == 6 )
-               {
-               voice->LoopCount = 0;
-               }
-            else
-               {
-               if ( ( voice->LoopCount > 0 ) && ( voice->LoopStart != NULL ) )
-                  {
-                  ptr = (unsigned char *) voice->LoopStart;
-                  if ( voice->LoopCount < 0xffff )
-                     {
-                     voice->LoopCount--;
-                     if ( voice->LoopCount == 0 )
-                        {
-                        voice->LoopStart = NULL;
-                        }
-                     }
-                  }
-               }
-            break;
+   MV_ProfileRefillTime = 0;
+   start = ASS_GetNanoTicks();
 
-         case 8 :
-            // Extended block
-            voice->bits  = 8;
-            voice->channels = 1;
-            tc = LITTLE16( *( unsigned short * )ptr );
-            packtype = *( ptr + 2 );
-            voicemode = *( ptr + 3 );
-            ptr += blocklength;
-            break;
+   MV_MixFunction( voice, buffer );
 
-         case 9 :
-            // New sound data block
-            samplespeed = LITTLE32( *( unsigned int * )ptr );
-            BitsPerSample = ( unsigned )*( ptr + 4 );
-            Channels = ( unsigned )*( ptr + 5 );
-            Format = ( unsigned )LITTLE16( *( unsigned short * )( ptr + 6 ) );
+   elapsed = ASS_GetNanoTicks() - start;
 
-            if ( ( BitsPerSample == 8 ) && ( Channels == 1 || Channels == 2 ) &&
-               ( Format == VOC_8BIT ) )
-               {
-               ptr         += 12;
-               blocklength -= 12;
-               voice->bits  = 8;
-               voice->channels = Channels;
-               done         = TRUE;
-               }
-            else if ( ( BitsPerSample == 16 ) && ( Channels == 1 || Channels == 2 ) &&
-               ( Format == VOC_16BIT ) )
-               {
-               ptr         += 12;
-               blocklength -= 12;
-               voice->bits  = 16;
-               voice->channels = Channels;
-               done         = TRUE;
-               }
-            else
-               {
-               ptr += blocklength;
-               }
-            break;
+   if ( MV_ProfileMode == MV_ProfileBySound )
+      {
+      key = ( unsigned int )voice->soundid;
+      }
+   else
+      {
+      key = voice->callbackval;
+      }
 
-         default :
-            // Unknown data.  Probably not a VOC file.
-            voice->Playing = FALSE;
-            done = TRUE;
-            break;
+   // Open addressing; keys beyond the table's size in one window go
+   // unrecorded.
+   slot = ( int )( ( key * 2654435761u ) >> 26 );
+   for( probe = 0; probe < MV_ProfileEntries; probe++ )
+      {
+      entry = &MV_Profile[ ( slot + probe ) % MV_ProfileEntries ];
+      if ( !entry->used )
+         {
+         entry->used = TRUE;
+         entry->profile.key = key;
+         break;
+         }
+      if ( entry->profile.key == key )
+         {
+         break;
          }
-
-      lastblocktype = blocktype;
       }
 
-   if ( voice->Playing )
+   if ( probe == MV_ProfileEntries )
       {
-      voice->NextBlock    = (char *)ptr + blocklength;
-      voice->sound        = (char *)ptr;
+      return;
+      }
 
-      voice->SamplingRate = samplespeed;
-      voice->RateScale    = ( voice->SamplingRate * voice->PitchScale ) / MV_MixRate;
+   entry->profile.wavetype = voice->wavetype;
+   entry->profile.bits     = voice->bits;
+   entry->profile.channels = voice->channels;
+   entry->profile.rate     = ( unsigned int )( voice->RateScale >> 16 );
+   entry->profile.voiceblocks++;
+   entry->mixtime    += elapsed - min( elapsed, MV_ProfileRefillTime );
+   entry->refilltime += MV_ProfileRefillTime;
+   }
 
-      // Multiply by MixBufferSize - 1
-      voice->FixedPointBufferSize = ( voice->RateScale * MixBufferSize ) -
-         voice->RateScale;
 
-      if ( voice->LoopEnd != NULL )
+/*---------------------------------------------------------------------
+   Function: MV_MeterBlock
+
+   Measures the peak, RMS and clipping of the block just mixed. The
+   loops are kept free of branches so the compiler can vectorise them.
+---------------------------------------------------------------------*/
+
+static void MV_MeterBlock
+   (
+   void
+   )
+
+   {
+   short         *samples16;
+   unsigned char *samples8;
+   uint64_t       squares;
+   unsigned int   clipped;
+   int            count;
+   int            channel;
+   int            peak;
+   int            i;
+   int            v;
+   int            a;
+
+   count = MV_BufferSize / ( MV_Bits / 8 );
+
+   clipped = 0;
+   for( channel = 0; channel < MV_Channels; channel++ )
+      {
+      peak    = 0;
+      squares = 0;
+
+      if ( MV_Bits == 16 )
          {
-         if ( blocklength > (intptr_t)voice->LoopEnd )
+         samples16 = ( short * )MV_MixBuffer[ MV_MixPage ];
+         for( i = channel; i < count; i += MV_Channels )
             {
-            blocklength = (intptr_t)voice->LoopEnd;
+            v = samples16[ i ];
+            a = v < 0 ? -v : v;
+            peak = a > peak ? a : peak;
+            squares += ( uint64_t )( v * v );
+            clipped += ( v == 32767 ) | ( v == -32768 );
             }
-         else
+         }
+      else
+         {
+         samples8 = ( unsigned char * )MV_MixBuffer[ MV_MixPage ];
+         for( i = channel; i < count; i += MV_Channels )
             {
-            voice->LoopEnd = (char *)(intptr_t)blocklength;
+            v = ( samples8[ i ] - 0x80 ) << 8;
+            a = v < 0 ? -v : v;
+            peak = a > peak ? a : peak;
+            squares += ( uint64_t )( v * v );
+            clipped += ( samples8[ i ] == 0 ) | ( samples8[ i ] == 255 );
             }
-
-         voice->LoopStart = voice->sound + (intptr_t)voice->LoopStart;
-         voice->LoopEnd   = voice->sound + (intptr_t)voice->LoopEnd;
-         voice->LoopSize  = voice->LoopEnd - voice->LoopStart;
          }
 
-      if ( voice->bits == 16 )
-         {
-         blocklength /= 2;
-         }
-      if ( voice->channels == 2 )
-         {
-         blocklength /= 2;
-         }
+      MV_Levels.peak[ channel ] = peak;
+      MV_Levels.rms[ channel ]  = ( int )sqrt( ( double )squares * MV_Channels / count );
+      MV_Levels.maxpeak[ channel ] = max( MV_Levels.maxpeak[ channel ], peak );
+      MV_LevelsSquares[ channel ] += squares;
+      }
 
-      voice->position     = 0;
-      voice->length       = min( blocklength, 0x8000 );
-      voice->BlockLength  = blocklength - voice->length;
-      voice->length     <<= 16;
+   if ( MV_Channels == 1 )
+      {
+      MV_Levels.peak[ 1 ]    = MV_Levels.peak[ 0 ];
+      MV_Levels.rms[ 1 ]     = MV_Levels.rms[ 0 ];
+      MV_Levels.maxpeak[ 1 ] = MV_Levels.maxpeak[ 0 ];
+      MV_LevelsSquares[ 1 ]  = MV_LevelsSquares[ 0 ];
+      }
 
-      MV_SetVoiceMixMode( voice );
+   MV_LevelsSamples += count / MV_Channels;
 
-      return( KeepPlaying );
+   MV_Levels.clipped       = clipped;
+   MV_Levels.totalclipped += clipped;
+   MV_Levels.clippedblocks += ( clipped > 0 );
+   MV_Levels.blocks++;
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: MV_ServiceVoc
+
+   Starts playback of the waiting buffer and mixes the next one.
+
+   JBF: no synchronisation happens inside MV_ServiceVoc nor the
+        supporting functions it calls. This would cause a deadlock
+        between the mixer thread in the driver vs the nested
+        locking in the user-space functions of MultiVoc. The call
+        to MV_ServiceVoc is synchronised in the driver.
+
+        Known functions called by MV_ServiceVoc and its helpers:
+           MV_Mix (and its MV_Mix*bit* workers)
+           MV_GetNextVOCBlock
+           MV_GetNextWAVBlock
+           MV_SetVoiceMixMode
+---------------------------------------------------------------------*/
+static void MV_ServiceVoc
+   (
+   void
+   )
+
+   {
+   VoiceNode *voice;
+   VoiceNode *next;
+   unsigned int start;
+   int        mixed;
+   int        paused;
+   TraceSpan  span;
+   TraceSpan  voicespan;
+	//int        flags;
+
+   TRACE_BEGIN( span );
+
+   MV_MixedFrames += MixBufferSize;
+   MV_ServiceCount++;
+
+   // Mixing is late once it falls a whole ring of blocks behind the
+   // clock. Count it once, then measure from here again.
+   start = ASS_GetMicroTicks();
+   if ( !MV_StatsClockRunning )
+      {
+      MV_StatsClockRunning = TRUE;
+      MV_StatsClockStart   = start;
+      MV_StatsClockBlocks  = 0;
+      }
+   else if ( start - MV_StatsClockStart >
+      ( MV_StatsClockBlocks + MV_NumberOfBuffers ) * MV_BlockTime )
+      {
+      MV_Stats.late++;
+      MV_StatsClockStart  = start;
+      MV_StatsClockBlocks = 0;
+      }
+   MV_StatsClockBlocks++;
+   if ( MV_StatsClockBlocks >= 4096 )
+      {
+      MV_StatsClockStart  += MV_StatsClockBlocks * MV_BlockTime;
+      MV_StatsClockBlocks  = 0;
+      }
+
+   // Toggle which buffer we'll mix next
+   MV_MixPage++;
+   if ( MV_MixPage >= MV_NumberOfBuffers )
+      {
+      MV_MixPage -= MV_NumberOfBuffers;
+      }
+
+   if ( MV_ReverbLevel == 0 )
+      {
+      // Initialize buffer
+      //Commented out so that the buffer is always cleared.
+      //This is so the guys at Echo Speech can mix into the
+      //buffer even when no sounds are playing.
+      //if ( !MV_BufferEmpty[ MV_MixPage ] )
+         {
+         ClearBuffer_DW( MV_MixBuffer[ MV_MixPage ], MV_Silence, MV_BufferSize >> 2 );
+         MV_BufferEmpty[ MV_MixPage ] = TRUE;
+         }
+      }
+   else
+      {
+      char *end;
+      char *source;
+      char *dest;
+      int   count;
+      int   length;
+
+      end = MV_MixBuffer[ 0 ] + MV_BufferLength;;
+      dest = MV_MixBuffer[ MV_MixPage ];
+      source = MV_MixBuffer[ MV_MixPage ] - MV_ReverbDelay;
+      if ( source < MV_MixBuffer[ 0 ] )
+         {
+         source += MV_BufferLength;
+         }
+
+      length = MV_BufferSize;
+      while( length > 0 )
+         {
+         count = length;
+         if ( source + count > end )
+            {
+            count = end - source;
+            }
+
+         if ( MV_Bits == 16 )
+            {
+            if ( MV_ReverbTable != NULL )
+               {
+               MV_16BitReverb( source, dest, MV_ReverbTable, count / 2 );
+               }
+            else
+               {
+               MV_16BitReverbFast( source, dest, count / 2, MV_ReverbLevel );
+               }
+            }
+         else
+            {
+            if ( MV_ReverbTable != NULL )
+               {
+               MV_8BitReverb( (signed char *) source, (signed char *) dest, MV_ReverbTable, count );
+               }
+            else
+               {
+               MV_8BitReverbFast( (signed char *) source, (signed char *) dest, count, MV_ReverbLevel );
+               }
+            }
+
+         // if we go through the loop again, it means that we've wrapped around the buffer
+         source  = MV_MixBuffer[ 0 ];
+         dest   += count;
+         length -= count;
+         }
+      }
+
+   if ( MV_MixDivisor > 1 )
+      {
+      ClearBuffer_DW( MV_LowRateBuffer, MV_Silence,
+         ( MV_MixLength * MV_SampleSize ) >> 2 );
+      }
+
+   MV_LODMixed = FALSE;
+
+   // Play any waiting voices
+   //flags = DisableInterrupts();
+   mixed  = 0;
+   paused = 0;
+	
+   for( voice = VoiceList.next; voice != &VoiceList; voice = next )
+      {
+      if ( voice->Paused )
+         {
+         paused++;
+         next = voice->next;
+         continue;
+         }
+      
+      MV_BufferEmpty[ MV_MixPage ] = FALSE;
+      mixed++;
+
+      TRACE_BEGIN( voicespan );
+      if ( MV_ProfileMode != MV_ProfileOff )
+         {
+         MV_ProfileVoice( voice, MV_MixPage );
+         }
+      else
+         {
+         MV_MixFunction( voice, MV_MixPage );
+         }
+      TRACE_END( voicespan, "mix voice", voice->handle );
+
+      if ( voice->timing )
+         {
+         MV_StartLanded( voice );
+         }
+
+      next = voice->next;
+
+      // Is this voice done?
+      if ( !voice->Playing )
+         {
+         //JBF: prevent a deadlock caused by MV_StopVoice grabbing the mutex again
+			//MV_StopVoice( voice );
+         LL_Remove( voice, next, prev );
+         LL_Add( (VoiceNode*) &VoicePool, voice, next, prev );
+
+         MV_ReleaseVoice( voice );
+
+         if ( MV_CallBackFunc )
+            {
+            MV_CallBackFunc( voice->callbackval );
+            }
+         }
+      }
+
+   // The side buffer is upsampled until its held back frames drain
+   if ( MV_LODMixed || MV_LODPending )
+      {
+      if ( !MV_LODMixed )
+         {
+         ClearBuffer_DW( MV_LODBuffer, MV_Silence,
+            ( MV_MixLength / MV_LODDivisor * MV_SampleSize ) >> 2 );
+         }
+
+      MV_UpsampleMix( MV_LODBuffer, ( MV_MixDivisor > 1 ) ?
+         MV_LowRateBuffer : MV_MixBuffer[ MV_MixPage ],
+         MV_MixLength / MV_LODDivisor, MV_LODDivisor, MV_Bits, MV_Channels,
+         &MV_LODUpsample );
+      MV_LODPending = MV_LODMixed;
+      }
+
+   if ( MV_MixDivisor > 1 )
+      {
+      MV_UpsampleMix( MV_LowRateBuffer, MV_MixBuffer[ MV_MixPage ],
+         MV_MixLength, MV_MixDivisor, MV_Bits, MV_Channels,
+         &MV_LowRateUpsample );
+      }
+
+   MV_MeterBlock();
+   MV_HandOffStarts( MV_HandoffLag );
+
+   MV_RecordBlockStats( start, mixed, paused );
+
+   TRACE_END( span, "MV_ServiceVoc", mixed );
+	
+   //RestoreInterrupts(flags);
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: MV_GetNextVOCBlock
+
+   Interperate the information of a VOC format sound file.
+---------------------------------------------------------------------*/
+
+static playbackstatus MV_GetNextVOCBlock
+   (
+   VoiceNode *voice
+   )
+
+   {
+   unsigned char *ptr;
+   int            blocktype;
+   int            lastblocktype;
+   unsigned int   blocklength = 0;
+   unsigned int   samplespeed = 0;
+   unsigned int   tc = 0;
+   int            packtype;
+   int            voicemode;
+   int            done;
+   unsigned       BitsPerSample;
+   unsigned       Channels;
+   unsigned       Format;
+   int            codec;
+   int            reference;
+   unsigned int   frames;
+
+   // Decode more of a compressed block
+   if ( voice->decode.remaining > 0 )
+      {
+      frames = MV_DecodeVOC( &voice->decode );
+      if ( frames > 0 )
+         {
+         voice->position -= voice->length;
+         voice->sound     = voice->decode.buffer;
+         voice->length    = ( uint64_t )frames << 32;
+         return( KeepPlaying );
+         }
+      }
+
+   ptr = ( unsigned char * )voice->NextBlock;
+
+   voice->Playing = TRUE;
+
+   voicemode = 0;
+   lastblocktype = 0;
+   packtype = 0;
+   codec = DecodePCM;
+   reference = FALSE;
+
+   done = FALSE;
+   while( !done )
+      {
+      // Stop playing if we get a NULL pointer
+      if ( ptr == NULL )
+         {
+         voice->Playing = FALSE;
+         done = TRUE;
+         break;
+         }
+
+      blocktype = ( int )*ptr;
+      blocklength = LITTLE32( *( unsigned int * )( ptr + 1 ) ) & 0x00ffffff;
+      ptr += 4;
+
+      switch( blocktype )
+         {
+         case 0 :
+            // End of data
+            if ( ( voice->LoopStart == NULL ) ||
+               ( (intptr_t) voice->LoopStart >= ( (intptr_t) ptr - 4 ) ) )
+               {
+               voice->Playing = FALSE;
+               done = TRUE;
+               }
+            else
+               {
+               voice->NextBlock    = voice->LoopStart;
+               voice->BlockLength  = 0;
+               voice->position     = 0;
+               return MV_GetNextVOCBlock(voice);
+               }
+            break;
+
+         case 1 :
+            // Sound data block
+            voice->bits  = 8;
+            voice->channels = voicemode + 1;
+            if ( lastblocktype != 8 )
+               {
+               tc = ( unsigned int )*ptr << 8;
+               packtype = *( ptr + 1 );
+               }
+
+            ptr += 2;
+            blocklength -= 2;
+
+            samplespeed = 256000000L / ( voice->channels * ( 65536 - tc ) );
+ 
+            // Skip unknown packing or stereo packed data
+            if ( ( packtype > 3 ) || ( voicemode != 0 && voicemode != 1 ) ||
+               ( packtype != 0 && voicemode != 0 ) )
+               {
+               ptr += blocklength;
+               }
+            else
+               {
+               if ( packtype != 0 )
+                  {
+                  codec     = DecodeCT4 + packtype - 1;
+                  reference = TRUE;
+                  }
+               done = TRUE;
+               }
+            voicemode = 0;
+            break;
+
+         case 2 :
+            // Sound continuation block
+            samplespeed = voice->SamplingRate;
+            codec = voice->decode.format;
+            done = TRUE;
+            break;
+
+         case 3 :
+            // Silence
+            // Not implimented.
+            ptr += blocklength;
+            break;
+
+         case 4 :
+            // Marker
+            // Not implimented.
+            ptr += blocklength;
+            break;
+
+         case 5 :
+            // ASCII string
+            // Not implimented.
+            ptr += blocklength;
+            break;
+
+         case 6 :
+            // Repeat begin
+            if ( voice->LoopEnd == NULL )
+               {
+               voice->LoopCount = LITTLE16(*( unsigned short * )ptr);
+               voice->LoopStart = (char *)((intptr_t) ptr + blocklength);
+               }
+            ptr += blocklength;
+            break;
+
+         case 7 :
+            // Repeat end
+            ptr += blocklength;
+            if ( lastblocktype == 6 )
+               {
+               voice->LoopCount = 0;
+               }
+            else
+               {
+               if ( ( voice->LoopCount > 0 ) && ( voice->LoopStart != NULL ) )
+                  {
+                  ptr = (unsigned char *) voice->LoopStart;
+                  if ( voice->LoopCount < 0xffff )
+                     {
+                     voice->LoopCount--;
+                     if ( voice->LoopCount == 0 )
+                        {
+                        voice->LoopStart = NULL;
+                        }
+                     }
+                  }
+               }
+            break;
+
+         case 8 :
+            // Extended block
+            voice->bits  = 8;
+            voice->channels = 1;
+            tc = LITTLE16( *( unsigned short * )ptr );
+            packtype = *( ptr + 2 );
+            voicemode = *( ptr + 3 );
+            ptr += blocklength;
+            break;
+
+         case 9 :
+            // New sound data block
+            samplespeed = LITTLE32( *( unsigned int * )ptr );
+            BitsPerSample = ( unsigned )*( ptr + 4 );
+            Channels = ( unsigned )*( ptr + 5 );
+            Format = ( unsigned )LITTLE16( *( unsigned short * )( ptr + 6 ) );
+
+            if ( ( BitsPerSample == 8 ) && ( Channels == 1 || Channels == 2 ) &&
+               ( Format == VOC_8BIT ) )
+               {
+               ptr         += 12;
+               blocklength -= 12;
+               voice->bits  = 8;
+               voice->channels = Channels;
+               done         = TRUE;
+               }
+            else if ( ( BitsPerSample == 16 ) && ( Channels == 1 || Channels == 2 ) &&
+               ( Format == VOC_16BIT ) )
+               {
+               ptr         += 12;
+               blocklength -= 12;
+               voice->bits  = 16;
+               voice->channels = Channels;
+               done         = TRUE;
+               }
+            else if ( ( Channels == 1 && ( Format == VOC_CT4_ADPCM ||
+               Format == VOC_CT3_ADPCM || Format == VOC_CT2_ADPCM ) ) ||
+               ( ( Channels == 1 || Channels == 2 ) && ( Format == VOC_ALAW ||
+               Format == VOC_MULAW || Format == VOC_CREATIVE_ADPCM ) ) )
+               {
+               ptr         += 12;
+               blocklength -= 12;
+               voice->channels = Channels;
+               switch( Format )
+                  {
+                  case VOC_CT4_ADPCM : codec = DecodeCT4; break;
+                  case VOC_CT3_ADPCM : codec = DecodeCT3; break;
+                  case VOC_CT2_ADPCM : codec = DecodeCT2; break;
+                  case VOC_ALAW :      codec = DecodeALaw; break;
+                  case VOC_MULAW :     codec = DecodeMuLaw; break;
+                  default :            codec = DecodeCT16; break;
+                  }
+               reference = TRUE;
+               done      = TRUE;
+               }
+            else
+               {
+               ptr += blocklength;
+               }
+            break;
+
+         default :
+            // Unknown data.  Probably not a VOC file.
+            voice->Playing = FALSE;
+            done = TRUE;
+            break;
+         }
+
+      lastblocktype = blocktype;
+      }
+
+   if ( voice->Playing )
+      {
+      voice->NextBlock    = (char *)ptr + blocklength;
+      voice->sound        = (char *)ptr;
+
+      voice->SamplingRate = samplespeed;
+      voice->RateScale    = RATE_SCALE( voice->SamplingRate, voice->PitchScale );
+
+      if ( codec != DecodePCM )
+         {
+         // Compressed data is decoded a run at a time as it plays
+         MV_StartVOCDecode( &voice->decode, codec, voice->channels,
+            (char *)ptr, blocklength, reference );
+         voice->bits     = ( codec == DecodeCT4 || codec == DecodeCT3 ||
+            codec == DecodeCT2 ) ? 8 : 16;
+         voice->sound    = voice->decode.buffer;
+         voice->position = 0;
+         voice->length   = ( uint64_t )MV_DecodeVOC( &voice->decode ) << 32;
+         voice->BlockLength = 0;
+
+         MV_SetVoiceMixMode( voice );
+
+         return( KeepPlaying );
+         }
+
+      voice->decode.format    = DecodePCM;
+      voice->decode.remaining = 0;
+
+      if ( voice->LoopEnd != NULL )
+         {
+         if ( blocklength > (intptr_t)voice->LoopEnd )
+            {
+            blocklength = (intptr_t)voice->LoopEnd;
+            }
+         else
+            {
+            voice->LoopEnd = (char *)(intptr_t)blocklength;
+            }
+
+         voice->LoopStart = voice->sound + (intptr_t)voice->LoopStart;
+         voice->LoopEnd   = voice->sound + (intptr_t)voice->LoopEnd;
+         voice->LoopSize  = voice->LoopEnd - voice->LoopStart;
+         }
+
+      if ( voice->bits == 16 )
+         {
+         blocklength /= 2;
+         }
+      if ( voice->channels == 2 )
+         {
+         blocklength /= 2;
+         }
+
+      voice->position     = 0;
+      voice->length       = ( uint64_t )blocklength << 32;
+      voice->BlockLength  = 0;
+
+      MV_SetVoiceMixMode( voice );
+
+      return( KeepPlaying );
+      }
+
+   return( NoMoreData );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: MV_GetNextDemandFeedBlock
+
+   Controls playback of demand fed data.
+---------------------------------------------------------------------*/
+
+static playbackstatus MV_GetNextDemandFeedBlock
+   (
+   VoiceNode *voice
+   )
+
+   {
+   if ( voice->DemandFeed == NULL )
+      {
+      return( NoMoreData );
+      }
+
+   voice->position     = 0;
+   ( voice->DemandFeed )( &voice->sound, &voice->BlockLength );
+   voice->length       = ( uint64_t )voice->BlockLength << 32;
+   voice->BlockLength  = 0;
+
+   if ( ( voice->length > 0 ) && ( voice->sound != NULL ) )
+      {
+      return( KeepPlaying );
+      }
+   return( NoMoreData );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: MV_GetNextRawBlock
+
+   Controls playback of demand fed data.
+---------------------------------------------------------------------*/
+
+static playbackstatus MV_GetNextRawBlock
+   (
+   VoiceNode *voice
+   )
+
+   {
+   if ( voice->BlockLength <= 0 )
+      {
+      if ( voice->LoopStart == NULL )
+         {
+         voice->Playing = FALSE;
+         return( NoMoreData );
+         }
+
+      voice->BlockLength = voice->LoopSize;
+      voice->NextBlock   = voice->LoopStart;
+      voice->length = 0;
+      voice->position = 0;
+      }
+
+   voice->sound        = voice->NextBlock;
+   voice->position    -= voice->length;
+   voice->length       = ( uint64_t )voice->BlockLength << 32;
+   voice->NextBlock   += voice->BlockLength * (voice->channels * voice->bits / 8);
+   voice->BlockLength  = 0;
+
+   return( KeepPlaying );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: MV_GetNextWAVBlock
+
+   Controls playback of demand fed data.
+---------------------------------------------------------------------*/
+
+static playbackstatus MV_GetNextWAVBlock
+   (
+   VoiceNode *voice
+   )
+
+   {
+   if ( voice->BlockLength <= 0 )
+      {
+      if ( voice->LoopStart == NULL )
+         {
+         voice->Playing = FALSE;
+         return( NoMoreData );
+         }
+
+      voice->BlockLength = voice->LoopSize;
+      voice->NextBlock   = voice->LoopStart;
+      voice->length      = 0;
+      voice->position    = 0;
+      }
+
+   voice->sound        = voice->NextBlock;
+   voice->position    -= voice->length;
+   voice->length       = ( uint64_t )voice->BlockLength << 32;
+   voice->NextBlock   += voice->BlockLength * (voice->channels * voice->bits / 8);
+   voice->BlockLength  = 0;
+
+   return( KeepPlaying );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: MV_ServiceRecord
+
+   Starts recording of the waiting buffer.
+---------------------------------------------------------------------*/
+
+/*static void MV_ServiceRecord
+   (
+   void
+   )
+
+   {
+   if ( MV_RecordFunc )
+      {
+      MV_RecordFunc( MV_MixBuffer[ 0 ] + MV_MixPage * MixBufferSize,
+         MixBufferSize );
+      }
+
+   // Toggle which buffer we'll mix next
+   MV_MixPage++;
+   if ( MV_MixPage >= NumberOfBuffers )
+      {
+      MV_MixPage = 0;
+      }
+   }*/
+
+
+/*---------------------------------------------------------------------
+   Function: MV_GetVoice
+
+   Locates the voice with the specified handle.
+---------------------------------------------------------------------*/
+
+VoiceNode *MV_GetVoice
+   (
+   int handle
+   )
+
+   {
+   VoiceNode *voice;
+   int        flags;
+
+   flags = DisableInterrupts();
+
+   for( voice = VoiceList.next; voice != &VoiceList; voice = voice->next )
+      {
+      if ( handle == voice->handle )
+         {
+         break;
+         }
+      }
+
+   RestoreInterrupts( flags );
+
+   if ( voice == &VoiceList )
+      {
+      MV_SetErrorCode( MV_VoiceNotFound );
+      voice = 0;
+      }
+
+   return( voice );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: MV_VoicePlaying
+
+   Checks if the voice associated with the specified handle is
+   playing.
+---------------------------------------------------------------------*/
+
+int MV_VoicePlaying
+   (
+   int handle
+   )
+
+   {
+   VoiceNode *voice;
+
+   if ( !MV_Installed )
+      {
+      MV_SetErrorCode( MV_NotInstalled );
+      return( FALSE );
+      }
+
+   voice = MV_GetVoice( handle );
+
+   if ( voice == NULL )
+      {
+      return( FALSE );
+      }
+
+   return( TRUE );
+   }
+
+
+/*---------------------------------------------------------------------
+Function: MV_VoicePaused
+
+Checks if the voice associated with the specified handle is
+paused.
+---------------------------------------------------------------------*/
+
+int MV_VoicePaused
+   (
+   int handle
+   )
+
+   {
+   VoiceNode *voice;
+   
+   if ( !MV_Installed )
+      {
+      MV_SetErrorCode( MV_NotInstalled );
+      return( FALSE );
+      }
+   
+   voice = MV_GetVoice( handle );
+   
+   if ( voice == NULL )
+      {
+      return( FALSE );
+      }
+   
+   return voice->Paused;
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: MV_KillAllVoices
+
+   Stops output of all currently active voices.
+---------------------------------------------------------------------*/
+
+int MV_KillAllVoices
+   (
+   void
+   )
+
+   {
+   VoiceNode * voice, * next;
+   int        flags;
+
+   if ( !MV_Installed )
+      {
+      MV_SetErrorCode( MV_NotInstalled );
+      return( MV_Error );
+      }
+
+   flags = DisableInterrupts();
+       
+   // Remove all the voices from the list
+   for( voice = VoiceList.next; voice != &VoiceList; voice = next )
+      {
+      next = voice->next;
+      if (voice->priority < MV_MUSIC_PRIORITY)
+         {
+         MV_Kill( voice->handle );
+         }
+      }
+
+   RestoreInterrupts(flags);
+
+   return( MV_Ok );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: MV_Kill
+
+   Stops output of the voice associated with the specified handle.
+---------------------------------------------------------------------*/
+
+int MV_Kill
+   (
+   int handle
+   )
+
+   {
+   VoiceNode *voice;
+   int        flags;
+   unsigned int callbackval;
+
+   if ( !MV_Installed )
+      {
+      MV_SetErrorCode( MV_NotInstalled );
+      return( MV_Error );
+      }
+
+   flags = DisableInterrupts();
+
+   voice = MV_GetVoice( handle );
+   if ( voice == NULL )
+      {
+      RestoreInterrupts( flags );
+      MV_SetErrorCode( MV_VoiceNotFound );
+      return( MV_Error );
+      }
+
+   callbackval = voice->callbackval;
+
+   MV_StopVoice( voice );
+
+   RestoreInterrupts( flags );
+
+   if ( MV_CallBackFunc )
+      {
+      MV_CallBackFunc( callbackval );
+      }
+
+   return( MV_Ok );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: MV_PauseVoice
+
+   Pauses or resumes output of the voice associated with the specified handle.
+---------------------------------------------------------------------*/
+
+int MV_PauseVoice
+(
+ int handle,
+ int pauseon
+ )
+
+{
+   VoiceNode *voice;
+   int        flags;
+   
+   if ( !MV_Installed )
+   {
+      MV_SetErrorCode( MV_NotInstalled );
+      return( MV_Error );
+   }
+   
+   flags = DisableInterrupts();
+   
+   voice = MV_GetVoice( handle );
+   if ( voice == NULL )
+   {
+      RestoreInterrupts( flags );
+      MV_SetErrorCode( MV_VoiceNotFound );
+      return( MV_Error );
+   }
+   
+   voice->Paused = pauseon;
+   
+   RestoreInterrupts( flags );
+   
+   return( MV_Ok );
+}
+
+
+/*---------------------------------------------------------------------
+   Function: MV_VoicesPlaying
+
+   Determines the number of currently active voices.
+---------------------------------------------------------------------*/
+
+int MV_VoicesPlaying
+   (
+   void
+   )
+
+   {
+   VoiceNode   *voice;
+   int         NumVoices = 0;
+   int         flags;
+
+   if ( !MV_Installed )
+      {
+      MV_SetErrorCode( MV_NotInstalled );
+      return( 0 );
+      }
+
+   flags = DisableInterrupts();
+
+   for( voice = VoiceList.next; voice != &VoiceList; voice = voice->next )
+      {
+      NumVoices++;
+      }
+
+   RestoreInterrupts( flags );
+
+   return( NumVoices );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: MV_AllocVoice
+
+   Retrieve an inactive or lower priority voice for output.
+---------------------------------------------------------------------*/
+
+VoiceNode *MV_AllocVoice
+   (
+   int priority
+   )
+
+   {
+   VoiceNode   *voice;
+   VoiceNode   *node;
+   int          flags;
+   unsigned int calltime;
+
+//return( NULL );
+   if ( MV_Recording )
+      {
+      return( NULL );
+      }
+
+   // timed from before any wait for the mixer
+   calltime = ASS_GetMicroTicks();
+
+   flags = DisableInterrupts();
+
+   // Check if we have any free voices
+   if ( LL_Empty( &VoicePool, next, prev ) )
+      {
+      // check if we have a higher priority than a voice that is playing.
+      voice = VoiceList.next;
+      for( node = voice->next; node != &VoiceList; node = node->next )
+         {
+         if ( node->priority < voice->priority )
+            {
+            voice = node;
+            }
+         }
+
+      if ( priority >= voice->priority )
+         {
+         MV_Kill( voice->handle );
+         MV_Stats.voicesstolen++;
+         }
+      }
+
+   // Check if any voices are in the voice pool
+   if ( LL_Empty( &VoicePool, next, prev ) )
+      {
+      // No free voices
+      RestoreInterrupts( flags );
+      return( NULL );
+      }
+
+   voice = VoicePool.next;
+   LL_Remove( voice, next, prev );
+   RestoreInterrupts( flags );
+
+   // Find a free voice handle
+   do
+      {
+      MV_VoiceHandle++;
+      if ( MV_VoiceHandle < MV_MinVoiceHandle )
+         {
+         MV_VoiceHandle = MV_MinVoiceHandle;
+         }
+      }
+   while( MV_VoicePlaying( MV_VoiceHandle ) );
+
+   voice->handle = MV_VoiceHandle;
+   voice->resampler = MV_DefaultResampler;
+   voice->carry = 0;
+   voice->historychannels = 0;
+   voice->gain = 255;
+   voice->soundid = -1;
+   voice->calltime = calltime;
+   voice->callframe = MV_MixedFrames;
+   voice->timing = TRUE;
+
+   return( voice );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: MV_VoiceAvailable
+
+   Checks if a voice can be play at the specified priority.
+---------------------------------------------------------------------*/
+
+int MV_VoiceAvailable
+   (
+   int priority
+   )
+
+   {
+   VoiceNode   *voice;
+   VoiceNode   *node;
+   int          flags;
+
+   // Check if we have any free voices
+   if ( !LL_Empty( &VoicePool, next, prev ) )
+      {
+      return( TRUE );
+      }
+
+   flags = DisableInterrupts();
+
+   // check if we have a higher priority than a voice that is playing.
+   voice = VoiceList.next;
+   for( node = VoiceList.next; node != &VoiceList; node = node->next )
+      {
+      if ( node->priority < voice->priority )
+         {
+         voice = node;
+         }
+      }
+
+   RestoreInterrupts( flags );
+
+   if ( ( voice != &VoiceList ) && ( priority >= voice->priority ) )
+      {
+      return( TRUE );
+      }
+
+   return( FALSE );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: MV_SetVoicePitch
+
+   Sets the pitch for the specified voice.
+---------------------------------------------------------------------*/
+
+static void MV_SetVoicePitch
+   (
+   VoiceNode *voice,
+   unsigned int rate,
+   int pitchoffset
+   )
+
+   {
+   voice->SamplingRate = rate;
+   voice->PitchScale   = PITCH_GetScale( pitchoffset );
+   voice->RateScale    = RATE_SCALE( rate, voice->PitchScale );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: MV_SetPitch
+
+   Sets the pitch for the voice associated with the specified handle.
+---------------------------------------------------------------------*/
+
+int MV_SetPitch
+   (
+   int handle,
+   int pitchoffset
+   )
+
+   {
+   VoiceNode *voice;
+
+   if ( !MV_Installed )
+      {
+      MV_SetErrorCode( MV_NotInstalled );
+      return( MV_Error );
+      }
+
+   voice = MV_GetVoice( handle );
+   if ( voice == NULL )
+      {
+      MV_SetErrorCode( MV_VoiceNotFound );
+      return( MV_Error );
+      }
+
+   MV_SetVoicePitch( voice, voice->SamplingRate, pitchoffset );
+
+   return( MV_Ok );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: MV_SetVoiceResampler
+
+   Sets how the voice associated with the specified handle is
+   resampled to the mixing rate.
+---------------------------------------------------------------------*/
+
+int MV_SetVoiceResampler
+   (
+   int handle,
+   int resampler
+   )
+
+   {
+   VoiceNode *voice;
+
+   if ( !MV_Installed )
+      {
+      MV_SetErrorCode( MV_NotInstalled );
+      return( MV_Error );
+      }
+
+   if ( resampler < MV_ResampleNearest || resampler >= MV_NumResamplers )
+      {
+      MV_SetErrorCode( MV_InvalidMixMode );
+      return( MV_Error );
+      }
+
+   MV_Lock();
+
+   voice = MV_GetVoice( handle );
+   if ( voice == NULL )
+      {
+      MV_Unlock();
+      MV_SetErrorCode( MV_VoiceNotFound );
+      return( MV_Error );
+      }
+
+   voice->resampler = resampler;
+   voice->carry = 0;
+   voice->historychannels = 0;
+   MV_SetVoiceMixMode( voice );
+
+   MV_Unlock();
+
+   return( MV_Ok );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: MV_SetDefaultResampler
+
+   Sets the resampler voices started from now on will use.
+---------------------------------------------------------------------*/
+
+int MV_SetDefaultResampler
+   (
+   int resampler
+   )
+
+   {
+   if ( resampler < MV_ResampleNearest || resampler >= MV_NumResamplers )
+      {
+      MV_SetErrorCode( MV_InvalidMixMode );
+      return( MV_Error );
+      }
+
+   MV_DefaultResampler = resampler;
+
+   return( MV_Ok );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: MV_GetDefaultResampler
+
+   Returns the resampler new voices use.
+---------------------------------------------------------------------*/
+
+int MV_GetDefaultResampler
+   (
+   void
+   )
+
+   {
+   return( MV_DefaultResampler );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: MV_SetFrequency
+
+   Sets the frequency for the voice associated with the specified handle.
+---------------------------------------------------------------------*/
+
+int MV_SetFrequency
+   (
+   int handle,
+   int frequency
+   )
+
+   {
+   VoiceNode *voice;
+
+   if ( !MV_Installed )
+      {
+      MV_SetErrorCode( MV_NotInstalled );
+      return( MV_Error );
+      }
+
+   voice = MV_GetVoice( handle );
+   if ( voice == NULL )
+      {
+      MV_SetErrorCode( MV_VoiceNotFound );
+      return( MV_Error );
+      }
+
+   MV_SetVoicePitch( voice, frequency, 0 );
+
+   return( MV_Ok );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: MV_GetVolumeTable
+
+   Returns a pointer to the volume table associated with the specified
+   volume.
+---------------------------------------------------------------------*/
+
+static short *MV_GetVolumeTable
+   (
+   int vol,
+   int is_bgm
+   )
+
+   {
+   int volume;
+   short *table;
+
+   volume = MIX_VOLUME( vol );
+
+   if (is_bgm)
+	  table = (short *) &volume_bgm.volume_table[ volume ];
+   else
+      table = (short *) &volume_sfx.volume_table[ volume ];
+
+   return( table );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: MV_GetMixFunction
+
+   Selects which method should be used to mix a voice.
+
+ 8Bit  16Bit  8Bit  16Bit |  8Bit  16Bit  8Bit  16Bit |
+ Mono  Mono   Ster  Ster  |  Mono  Mono   Ster  Ster  |  Mixer
+ Out   Out    Out   Out   |  In    In     In    In    |
+--------------------------+---------------------------+-------------
+  X                       |         X                 | Mix8BitMono16
+  X                       |   X                       | Mix8BitMono
+               X          |         X                 | Mix8BitStereo16
+               X          |   X                       | Mix8BitStereo
+        X                 |         X                 | Mix16BitMono16
+        X                 |   X                       | Mix16BitMono
+                     X    |         X                 | Mix16BitStereo16
+                     X    |   X                       | Mix16BitStereo
+--------------------------+---------------------------+-------------
+                     X    |                      X    | Mix16BitStereo16Stereo
+                     X    |                X          | Mix16BitStereo8Stereo
+					X          |                      X    | Mix8BitStereo16Stereo
+               X          |                X          | Mix8BitStereo8Stereo
+		  X                 |                      X    | Mix16BitMono16Stereo
+        X                 |                X          | Mix16BitMono8Stereo
+  X                       |                      X    | Mix8BitMono16Stereo
+  X                       |                X          | Mix8BitMono8Stereo
+
+---------------------------------------------------------------------*/
+
+static MIXFUNC MV_GetMixFunction
+   (
+   int test
+   )
+
+   {
+   switch( test )
+      {
+      case T_8BITS | T_MONO | T_16BITSOURCE :
+         return( MV_Mix8BitMono16 );
+
+      case T_8BITS | T_MONO :
+         return( MV_Mix8BitMono );
+
+      case T_8BITS | T_16BITSOURCE | T_LEFTQUIET :
+         MV_LeftVolume = MV_RightVolume;
+         return( MV_Mix8BitMono16 );
+
+      case T_8BITS | T_LEFTQUIET :
+         MV_LeftVolume = MV_RightVolume;
+         return( MV_Mix8BitMono );
+
+      case T_8BITS | T_16BITSOURCE | T_RIGHTQUIET :
+         return( MV_Mix8BitMono16 );
+
+      case T_8BITS | T_RIGHTQUIET :
+         return( MV_Mix8BitMono );
+
+      case T_8BITS | T_16BITSOURCE :
+         return( MV_Mix8BitStereo16 );
+
+      case T_8BITS :
+         return( MV_Mix8BitStereo );
+
+      case T_MONO | T_16BITSOURCE :
+         return( MV_Mix16BitMono16 );
+
+      case T_MONO :
+         return( MV_Mix16BitMono );
+
+      case T_16BITSOURCE | T_LEFTQUIET :
+         MV_LeftVolume = MV_RightVolume;
+         return( MV_Mix16BitMono16 );
+
+      case T_LEFTQUIET :
+         MV_LeftVolume = MV_RightVolume;
+         return( MV_Mix16BitMono );
+
+      case T_16BITSOURCE | T_RIGHTQUIET :
+         return( MV_Mix16BitMono16 );
+
+      case T_RIGHTQUIET :
+         return( MV_Mix16BitMono );
+
+      case T_16BITSOURCE :
+         return( MV_Mix16BitStereo16 );
+
+      case T_SIXTEENBIT_STEREO :
+         return( MV_Mix16BitStereo );
+			
+		case T_16BITSOURCE | T_STEREOSOURCE:
+			return( MV_Mix16BitStereo16Stereo );
+
+		case T_16BITSOURCE | T_STEREOSOURCE | T_8BITS:
+			return( MV_Mix8BitStereo16Stereo );
+			
+		case T_16BITSOURCE | T_STEREOSOURCE | T_MONO:
+			return( MV_Mix16BitMono16Stereo );
+			
+		case T_16BITSOURCE | T_STEREOSOURCE | T_8BITS | T_MONO:
+			return( MV_Mix8BitMono16Stereo );
+			
+		case T_STEREOSOURCE:
+			return( MV_Mix16BitStereo8Stereo );
+         
+		case T_STEREOSOURCE | T_8BITS:
+			return( MV_Mix8BitStereo8Stereo );
+			
+		case T_STEREOSOURCE | T_MONO:
+			return( MV_Mix16BitMono8Stereo );
+			
+		case T_STEREOSOURCE | T_8BITS | T_MONO:
+			return( MV_Mix8BitMono8Stereo );
+			
+      default :
+         return( NULL );
+      }
+
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: MV_SetVoiceMixMode
+
+   Selects which method should be used to mix the voice. Voices using
+   an interpolating resampler also get the mixer for 16-bit source of
+   the same layout, which MV_MixResampled feeds.
+---------------------------------------------------------------------*/
+
+void MV_SetVoiceMixMode
+   (
+   VoiceNode *voice
+   )
+
+   {
+   //int flags;
+   int test;
+
+   //flags = DisableInterrupts();
+
+   test = T_DEFAULT;
+   if ( MV_Bits == 8 )
+      {
+      test |= T_8BITS;
+      }
+
+   if ( MV_Channels == 1 )
+      {
+      test |= T_MONO;
+      }
+   else
+      {
+      if ( IS_QUIET( voice->RightVolume ) )
+         {
+         test |= T_RIGHTQUIET;
+         }
+      else if ( IS_QUIET( voice->LeftVolume ) )
+         {
+         test |= T_LEFTQUIET;
+         }
+      }
+	
+   if ( voice->bits == 16 )
+      {
+      test |= T_16BITSOURCE;
+      }
+	
+	if ( voice->channels == 2 )
+      {
+      test |= T_STEREOSOURCE;
+		test &= ~(T_RIGHTQUIET | T_LEFTQUIET);
+      }
+
+   voice->mix = MV_GetMixFunction( test );
+
+   voice->mixresampled = NULL;
+   if ( voice->resampler != MV_ResampleNearest )
+      {
+      voice->mixresampled = MV_GetMixFunction( test | T_16BITSOURCE );
       }
 
-   return( NoMoreData );
+   //RestoreInterrupts( flags );
    }
 
 
 /*---------------------------------------------------------------------
-   Function: MV_GetNextDemandFeedBlock
+   Function: MV_SetVoiceVolume
 
-   Controls playback of demand fed data.
+   Sets the stereo and mono volume level of the voice associated
+   with the specified handle.
 ---------------------------------------------------------------------*/
 
-static playbackstatus MV_GetNextDemandFeedBlock
+void MV_SetVoiceVolume
    (
-   VoiceNode *voice
+   VoiceNode *voice,
+   int vol,
+   int left,
+   int right
    )
 
    {
-   if ( voice->BlockLength > 0 )
+   if ( MV_Channels == 1 )
       {
-      voice->position    -= voice->length;
-      voice->sound       += voice->length >> 16;
-      voice->length       = min( voice->BlockLength, 0x8000 );
-      voice->BlockLength -= voice->length;
-      voice->length     <<= 16;
-
-      return( KeepPlaying );
+      left  = vol;
+      right = vol;
       }
 
-   if ( voice->DemandFeed == NULL )
-      {
-      return( NoMoreData );
-      }
+   voice->gain = max( left, right );
 
-   voice->position     = 0;
-   ( voice->DemandFeed )( &voice->sound, &voice->BlockLength );
-   voice->length       = min( voice->BlockLength, 0x8000 );
-   voice->BlockLength -= voice->length;
-   voice->length     <<= 16;
+   int bgm = ( voice->callbackval == -65536 );
 
-   if ( ( voice->length > 0 ) && ( voice->sound != NULL ) )
+   if ( MV_SwapLeftRight )
       {
-      return( KeepPlaying );
+      // SBPro uses reversed panning
+      voice->LeftVolume  = MV_GetVolumeTable( right, bgm );
+      voice->RightVolume = MV_GetVolumeTable( left, bgm );
       }
-   return( NoMoreData );
+   else
+      {
+      voice->LeftVolume  = MV_GetVolumeTable( left, bgm );
+      voice->RightVolume = MV_GetVolumeTable( right, bgm );
+      }
+
+   MV_SetVoiceMixMode( voice );
    }
 
 
 /*---------------------------------------------------------------------
-   Function: MV_GetNextRawBlock
+   Function: MV_EndLooping
 
-   Controls playback of demand fed data.
+   Stops the voice associated with the specified handle from looping
+   without stoping the sound.
 ---------------------------------------------------------------------*/
 
-static playbackstatus MV_GetNextRawBlock
+int MV_EndLooping
    (
-   VoiceNode *voice
+   int handle
    )
 
    {
-   if ( voice->BlockLength <= 0 )
+   VoiceNode *voice;
+   int        flags;
+
+   if ( !MV_Installed )
       {
-      if ( voice->LoopStart == NULL )
-         {
-         voice->Playing = FALSE;
-         return( NoMoreData );
-         }
+      MV_SetErrorCode( MV_NotInstalled );
+      return( MV_Error );
+      }
 
-      voice->BlockLength = voice->LoopSize;
-      voice->NextBlock   = voice->LoopStart;
-      voice->length = 0;
-      voice->position = 0;
+   flags = DisableInterrupts();
+
+   voice = MV_GetVoice( handle );
+   if ( voice == NULL )
+      {
+      RestoreInterrupts( flags );
+      MV_SetErrorCode( MV_VoiceNotFound );
+      return( MV_Warning );
       }
 
-   voice->sound        = voice->NextBlock;
-   voice->position    -= voice->length;
-   voice->length       = min( voice->BlockLength, 0x8000 );
-   voice->NextBlock   += voice->length * (voice->channels * voice->bits / 8);
-   voice->BlockLength -= voice->length;
-   voice->length     <<= 16;
+   voice->LoopCount = 0;
+   voice->LoopStart = NULL;
+   voice->LoopEnd   = NULL;
 
-   return( KeepPlaying );
+   RestoreInterrupts( flags );
+
+   return( MV_Ok );
    }
 
 
 /*---------------------------------------------------------------------
-   Function: MV_GetNextWAVBlock
+   Function: MV_SetPan
 
-   Controls playback of demand fed data.
+   Sets the stereo and mono volume level of the voice associated
+   with the specified handle.
 ---------------------------------------------------------------------*/
 
-static playbackstatus MV_GetNextWAVBlock
+int MV_SetPan
    (
-   VoiceNode *voice
+   int handle,
+   int vol,
+   int left,
+   int right
    )
 
    {
-   if ( voice->BlockLength <= 0 )
+   VoiceNode *voice;
+
+   if ( !MV_Installed )
       {
-      if ( voice->LoopStart == NULL )
-         {
-         voice->Playing = FALSE;
-         return( NoMoreData );
-         }
+      MV_SetErrorCode( MV_NotInstalled );
+      return( MV_Error );
+      }
 
-      voice->BlockLength = voice->LoopSize;
-      voice->NextBlock   = voice->LoopStart;
-      voice->length      = 0;
-      voice->position    = 0;
+   voice = MV_GetVoice( handle );
+   if ( voice == NULL )
+      {
+      MV_SetErrorCode( MV_VoiceNotFound );
+      return( MV_Warning );
       }
 
-   voice->sound        = voice->NextBlock;
-   voice->position    -= voice->length;
-   voice->length       = min( voice->BlockLength, 0x8000 );
-   voice->NextBlock   += voice->length * (voice->channels * voice->bits / 8);
-   voice->BlockLength -= voice->length;
-   voice->length     <<= 16;
+   MV_SetVoiceVolume( voice, vol, left, right );
 
-   return( KeepPlaying );
+   return( MV_Ok );
    }
 
 
 /*---------------------------------------------------------------------
-   Function: MV_ServiceRecord
+   Function: MV_Pan3D
 
-   Starts recording of the waiting buffer.
+   Set the angle and distance from the listener of the voice associated
+   with the specified handle.
 ---------------------------------------------------------------------*/
 
-/*static void MV_ServiceRecord
+int MV_Pan3D
    (
-   void
+   int handle,
+   int angle,
+   int distance
    )
 
    {
-   if ( MV_RecordFunc )
-      {
-      MV_RecordFunc( MV_MixBuffer[ 0 ] + MV_MixPage * MixBufferSize,
-         MixBufferSize );
-      }
+   int left;
+   int right;
+   int mid;
+   int volume;
+   int status;
 
-   // Toggle which buffer we'll mix next
-   MV_MixPage++;
-   if ( MV_MixPage >= NumberOfBuffers )
+   if ( distance < 0 )
       {
-      MV_MixPage = 0;
+      distance  = -distance;
+      angle    += MV_NumPanPositions / 2;
       }
-   }*/
+
+   volume = MIX_VOLUME( distance );
+
+   // Ensure angle is within 0 - 31
+   angle &= MV_MaxPanPosition;
+
+   left  = MV_PanTable[ angle ][ volume ].left;
+   right = MV_PanTable[ angle ][ volume ].right;
+   mid   = max( 0, 255 - distance );
+
+   status = MV_SetPan( handle, mid, left, right );
+
+   return( status );
+   }
 
 
 /*---------------------------------------------------------------------
-   Function: MV_GetVoice
+   Function: MV_SetReverb
 
-   Locates the voice with the specified handle.
+   Sets the level of reverb to add to mix.
 ---------------------------------------------------------------------*/
 
-static VoiceNode *MV_GetVoice
+void MV_SetReverb
    (
-   int handle
+   int reverb
    )
 
    {
-   VoiceNode *voice;
-   int        flags;
+   MV_ReverbLevel = MIX_VOLUME( reverb );
+   MV_ReverbTable = &volume_sfx.volume_table[ MV_ReverbLevel ];
+   }
 
-   flags = DisableInterrupts();
 
-   for( voice = VoiceList.next; voice != &VoiceList; voice = voice->next )
-      {
-      if ( handle == voice->handle )
-         {
-         break;
-         }
-      }
+/*---------------------------------------------------------------------
+   Function: MV_SetFastReverb
 
-   RestoreInterrupts( flags );
+   Sets the level of reverb to add to mix.
+---------------------------------------------------------------------*/
 
-   if ( voice == &VoiceList )
-      {
-      MV_SetErrorCode( MV_VoiceNotFound );
-      voice = 0;
-      }
+void MV_SetFastReverb
+   (
+   int reverb
+   )
 
-   return( voice );
+   {
+   MV_ReverbLevel = max( 0, min( 16, reverb ) );
+   MV_ReverbTable = NULL;
    }
 
 
 /*---------------------------------------------------------------------
-   Function: MV_VoicePlaying
+   Function: MV_GetMaxReverbDelay
 
-   Checks if the voice associated with the specified handle is
-   playing.
+   Returns the maximum delay time for reverb.
 ---------------------------------------------------------------------*/
 
-int MV_VoicePlaying
+int MV_GetMaxReverbDelay
    (
-   int handle
+   void
    )
 
    {
-   VoiceNode *voice;
-
-   if ( !MV_Installed )
-      {
-      MV_SetErrorCode( MV_NotInstalled );
-      return( FALSE );
-      }
-
-   voice = MV_GetVoice( handle );
+   int maxdelay;
 
-   if ( voice == NULL )
-      {
-      return( FALSE );
-      }
+   maxdelay = MixBufferSize * MV_NumberOfBuffers;
 
-   return( TRUE );
+   return maxdelay;
    }
 
 
 /*---------------------------------------------------------------------
-Function: MV_VoicePaused
+   Function: MV_GetReverbDelay
 
-Checks if the voice associated with the specified handle is
-paused.
+   Returns the current delay time for reverb.
 ---------------------------------------------------------------------*/
 
-int MV_VoicePaused
+int MV_GetReverbDelay
    (
-   int handle
+   void
    )
-
-   {
-   VoiceNode *voice;
-   
-   if ( !MV_Installed )
-      {
-      MV_SetErrorCode( MV_NotInstalled );
-      return( FALSE );
-      }
-   
-   voice = MV_GetVoice( handle );
-   
-   if ( voice == NULL )
-      {
-      return( FALSE );
-      }
-   
-   return voice->Paused;
+
+   {
+   return MV_ReverbDelay / MV_SampleSize;
    }
 
 
 /*---------------------------------------------------------------------
-   Function: MV_KillAllVoices
+   Function: MV_SetReverbDelay
 
-   Stops output of all currently active voices.
+   Sets the delay level of reverb to add to mix.
 ---------------------------------------------------------------------*/
 
-int MV_KillAllVoices
+void MV_SetReverbDelay
    (
-   void
+   int delay
    )
 
    {
-   VoiceNode * voice, * next;
-   int        flags;
-
-   if ( !MV_Installed )
-      {
-      MV_SetErrorCode( MV_NotInstalled );
-      return( MV_Error );
-      }
-
-   flags = DisableInterrupts();
-       
-   // Remove all the voices from the list
-   for( voice = VoiceList.next; voice != &VoiceList; voice = next )
-      {
-      next = voice->next;
-      if (voice->priority < MV_MUSIC_PRIORITY)
-         {
-         MV_Kill( voice->handle );
-         }
-      }
-
-   RestoreInterrupts(flags);
+   int maxdelay;
 
-   return( MV_Ok );
+   maxdelay = MV_GetMaxReverbDelay();
+   MV_ReverbDelay = max( MixBufferSize, min( delay, maxdelay ) );
+   MV_ReverbDelay *= MV_SampleSize;
    }
 
 
 /*---------------------------------------------------------------------
-   Function: MV_Kill
+   Function: MV_SetMixRateDivisor
 
-   Stops output of the voice associated with the specified handle.
+   Mixes voices at the device rate divided by 1, 2 or 4, bringing each
+   block up to the device rate afterwards. Per voice mixing costs drop
+   in proportion while the highest frequency kept drops with them.
 ---------------------------------------------------------------------*/
 
-int MV_Kill
+int MV_SetMixRateDivisor
    (
-   int handle
+   int divisor
    )
 
    {
    VoiceNode *voice;
-   int        flags;
-   unsigned int callbackval;
 
-   if ( !MV_Installed )
+   if ( divisor != 1 && divisor != 2 && divisor != 4 )
       {
-      MV_SetErrorCode( MV_NotInstalled );
+      MV_SetErrorCode( MV_InvalidMixMode );
       return( MV_Error );
       }
 
-   flags = DisableInterrupts();
-
-   voice = MV_GetVoice( handle );
-   if ( voice == NULL )
-      {
-      RestoreInterrupts( flags );
-      MV_SetErrorCode( MV_VoiceNotFound );
-      return( MV_Error );
-      }
+   MV_Lock();
 
-   callbackval = voice->callbackval;
+   MV_MixDivisor = divisor;
+   MV_MixLength  = MixBufferSize / divisor;
 
-   MV_StopVoice( voice );
+   if ( MV_Installed && MV_RequestedMixRate > 0 )
+      {
+      MV_MixRate = MV_RequestedMixRate / divisor;
 
-   RestoreInterrupts( flags );
+      for( voice = VoiceList.next; voice != &VoiceList; voice = voice->next )
+         {
+         voice->RateScale = RATE_SCALE( voice->SamplingRate, voice->PitchScale );
+         }
 
-   if ( MV_CallBackFunc )
-      {
-      MV_CallBackFunc( callbackval );
+      MV_ResetUpsampler( &MV_LowRateUpsample );
+      MV_ResetUpsampler( &MV_LODUpsample );
       }
 
+   MV_Unlock();
+
    return( MV_Ok );
    }
 
 
 /*---------------------------------------------------------------------
-   Function: MV_PauseVoice
+   Function: MV_GetMixRateDivisor
 
-   Pauses or resumes output of the voice associated with the specified handle.
+   Returns what the device rate is divided by for mixing.
 ---------------------------------------------------------------------*/
 
-int MV_PauseVoice
-(
- int handle,
- int pauseon
- )
+int MV_GetMixRateDivisor
+   (
+   void
+   )
 
-{
-   VoiceNode *voice;
-   int        flags;
-   
-   if ( !MV_Installed )
    {
-      MV_SetErrorCode( MV_NotInstalled );
-      return( MV_Error );
-   }
-   
-   flags = DisableInterrupts();
-   
-   voice = MV_GetVoice( handle );
-   if ( voice == NULL )
-   {
-      RestoreInterrupts( flags );
-      MV_SetErrorCode( MV_VoiceNotFound );
-      return( MV_Error );
+   return( MV_MixDivisor );
    }
-   
-   voice->Paused = pauseon;
-   
-   RestoreInterrupts( flags );
-   
-   return( MV_Ok );
-}
 
 
 /*---------------------------------------------------------------------
-   Function: MV_VoicesPlaying
+   Function: MV_SetVoiceLOD
 
-   Determines the number of currently active voices.
+   Mixes voices whose louder side is below the threshold volume (0-255)
+   at the mixing rate divided by 2 or 4. A threshold of 0 turns this
+   off.
 ---------------------------------------------------------------------*/
 
-int MV_VoicesPlaying
+int MV_SetVoiceLOD
    (
-   void
+   int threshold,
+   int divisor
    )
 
    {
-   VoiceNode   *voice;
-   int         NumVoices = 0;
-   int         flags;
-
-   if ( !MV_Installed )
+   if ( divisor != 2 && divisor != 4 )
       {
-      MV_SetErrorCode( MV_NotInstalled );
-      return( 0 );
+      MV_SetErrorCode( MV_InvalidMixMode );
+      return( MV_Error );
       }
 
-   flags = DisableInterrupts();
+   MV_Lock();
 
-   for( voice = VoiceList.next; voice != &VoiceList; voice = voice->next )
-      {
-      NumVoices++;
-      }
+   MV_LODThreshold = max( 0, min( threshold, 256 ) );
+   MV_LODDivisor   = divisor;
+   MV_LODPending   = FALSE;
+   MV_ResetUpsampler( &MV_LODUpsample );
 
-   RestoreInterrupts( flags );
+   MV_Unlock();
 
-   return( NumVoices );
+   return( MV_Ok );
    }
 
 
 /*---------------------------------------------------------------------
-   Function: MV_AllocVoice
+   Function: MV_GetVoiceLOD
 
-   Retrieve an inactive or lower priority voice for output.
+   Returns the volume below which voices are mixed at a reduced rate.
 ---------------------------------------------------------------------*/
 
-VoiceNode *MV_AllocVoice
+int MV_GetVoiceLOD
    (
-   int priority
+   void
    )
 
    {
-   VoiceNode   *voice;
-   VoiceNode   *node;
-   int          flags;
-
-//return( NULL );
-   if ( MV_Recording )
-      {
-      return( NULL );
-      }
-
-   flags = DisableInterrupts();
-
-   // Check if we have any free voices
-   if ( LL_Empty( &VoicePool, next, prev ) )
-      {
-      // check if we have a higher priority than a voice that is playing.
-      voice = VoiceList.next;
-      for( node = voice->next; node != &VoiceList; node = node->next )
-         {
-         if ( node->priority < voice->priority )
-            {
-            voice = node;
-            }
-         }
-
-      if ( priority >= voice->priority )
-         {
-         MV_Kill( voice->handle );
-         }
-      }
-
-   // Check if any voices are in the voice pool
-   if ( LL_Empty( &VoicePool, next, prev ) )
-      {
-      // No free voices
-      RestoreInterrupts( flags );
-      return( NULL );
-      }
-
-   voice = VoicePool.next;
-   LL_Remove( voice, next, prev );
-   RestoreInterrupts( flags );
-
-   // Find a free voice handle
-   do
-      {
-      MV_VoiceHandle++;
-      if ( MV_VoiceHandle < MV_MinVoiceHandle )
-         {
-         MV_VoiceHandle = MV_MinVoiceHandle;
-         }
-      }
-   while( MV_VoicePlaying( MV_VoiceHandle ) );
-
-   voice->handle = MV_VoiceHandle;
-
-   return( voice );
+   return( MV_LODThreshold );
    }
 
 
 /*---------------------------------------------------------------------
-   Function: MV_VoiceAvailable
+   Function: MV_GetStats
 
-   Checks if a voice can be play at the specified priority.
+   Fills in the mixer statistics gathered since playback started or
+   they were last reset.
 ---------------------------------------------------------------------*/
 
-int MV_VoiceAvailable
+void MV_GetStats
    (
-   int priority
+   ASS_MixStats *stats
    )
 
    {
-   VoiceNode   *voice;
-   VoiceNode   *node;
-   int          flags;
+   unsigned int count;
+   unsigned int target;
+   int          bucket;
 
-   // Check if we have any free voices
-   if ( !LL_Empty( &VoicePool, next, prev ) )
-      {
-      return( TRUE );
-      }
+   MV_Lock();
 
-   flags = DisableInterrupts();
+   *stats = MV_Stats;
 
-   // check if we have a higher priority than a voice that is playing.
-   voice = VoiceList.next;
-   for( node = VoiceList.next; node != &VoiceList; node = node->next )
+   if ( MV_Stats.blocks > 0 )
       {
-      if ( node->priority < voice->priority )
+      stats->avgtime = ( unsigned int )( MV_StatsTotalTime / MV_Stats.blocks );
+
+      target = MV_Stats.blocks - MV_Stats.blocks / 100;
+      count  = 0;
+      for( bucket = 0; bucket < MV_StatsBuckets - 1; bucket++ )
          {
-         voice = node;
+         count += MV_StatsHistogram[ bucket ];
+         if ( count >= target )
+            {
+            break;
+            }
          }
+      stats->p99time = min( MV_StatsBucketLimit( bucket ), MV_Stats.maxtime );
       }
 
-   RestoreInterrupts( flags );
-
-   if ( ( voice != &VoiceList ) && ( priority >= voice->priority ) )
-      {
-      return( TRUE );
-      }
-
-   return( FALSE );
+   MV_Unlock();
    }
 
 
 /*---------------------------------------------------------------------
-   Function: MV_SetVoicePitch
+   Function: MV_ResetStats
 
-   Sets the pitch for the specified voice.
+   Clears the mixer statistics.
 ---------------------------------------------------------------------*/
 
-static void MV_SetVoicePitch
+void MV_ResetStats
    (
-   VoiceNode *voice,
-   unsigned int rate,
-   int pitchoffset
+   void
    )
 
    {
-   voice->SamplingRate = rate;
-   voice->PitchScale   = PITCH_GetScale( pitchoffset );
-   voice->RateScale    = ( rate * voice->PitchScale ) / MV_MixRate;
+   MV_Lock();
 
-   // Multiply by MixBufferSize - 1
-   voice->FixedPointBufferSize = ( voice->RateScale * MixBufferSize ) -
-      voice->RateScale;
+   memset( &MV_Stats, 0, sizeof( MV_Stats ) );
+   memset( MV_StatsHistogram, 0, sizeof( MV_StatsHistogram ) );
+   MV_StatsTotalTime    = 0;
+   MV_StatsClockRunning = FALSE;
+
+   MV_Unlock();
    }
 
 
 /*---------------------------------------------------------------------
-   Function: MV_SetPitch
+   Function: MV_LatencyPercentile
 
-   Sets the pitch for the voice associated with the specified handle.
+   Reads a percentile of start latency off its histogram.
 ---------------------------------------------------------------------*/
 
-int MV_SetPitch
+static unsigned int MV_LatencyPercentile
    (
-   int handle,
-   int pitchoffset
+   unsigned int *histogram,
+   int           percent,
+   unsigned int  maximum
    )
 
    {
-   VoiceNode *voice;
-
-   if ( !MV_Installed )
-      {
-      MV_SetErrorCode( MV_NotInstalled );
-      return( MV_Error );
-      }
+   unsigned int count;
+   unsigned int target;
+   int          bucket;
 
-   voice = MV_GetVoice( handle );
-   if ( voice == NULL )
+   target = MV_Latency.starts - MV_Latency.starts * ( 100 - percent ) / 100;
+   count  = 0;
+   for( bucket = 0; bucket < MV_StatsBuckets - 1; bucket++ )
       {
-      MV_SetErrorCode( MV_VoiceNotFound );
-      return( MV_Error );
+      count += histogram[ bucket ];
+      if ( count >= target )
+         {
+         break;
+         }
       }
 
-   MV_SetVoicePitch( voice, voice->SamplingRate, pitchoffset );
-
-   return( MV_Ok );
+   return( min( MV_StatsBucketLimit( bucket ), maximum ) );
    }
 
 
 /*---------------------------------------------------------------------
-   Function: MV_SetFrequency
+   Function: MV_GetLatency
 
-   Sets the frequency for the voice associated with the specified handle.
+   Fills in how long voices took from the play call to being mixed and
+   to reaching the driver.
 ---------------------------------------------------------------------*/
 
-int MV_SetFrequency
+void MV_GetLatency
    (
-   int handle,
-   int frequency
+   ASS_StartLatency *latency
    )
 
    {
-   VoiceNode *voice;
+   MV_Lock();
 
-   if ( !MV_Installed )
-      {
-      MV_SetErrorCode( MV_NotInstalled );
-      return( MV_Error );
-      }
+   *latency = MV_Latency;
 
-   voice = MV_GetVoice( handle );
-   if ( voice == NULL )
+   if ( MV_Latency.starts > 0 )
       {
-      MV_SetErrorCode( MV_VoiceNotFound );
-      return( MV_Error );
+      latency->avgmixed = ( unsigned int )( MV_LatencyTotal[ 0 ] / MV_Latency.starts );
+      latency->avgout   = ( unsigned int )( MV_LatencyTotal[ 1 ] / MV_Latency.starts );
+      latency->p50mixed = MV_LatencyPercentile( MV_LatencyHistogram[ 0 ], 50,
+         MV_Latency.maxmixed );
+      latency->p99mixed = MV_LatencyPercentile( MV_LatencyHistogram[ 0 ], 99,
+         MV_Latency.maxmixed );
+      latency->p50out   = MV_LatencyPercentile( MV_LatencyHistogram[ 1 ], 50,
+         MV_Latency.maxout );
+      latency->p99out   = MV_LatencyPercentile( MV_LatencyHistogram[ 1 ], 99,
+         MV_Latency.maxout );
       }
 
-   MV_SetVoicePitch( voice, frequency, 0 );
-
-   return( MV_Ok );
+   MV_Unlock();
    }
 
 
 /*---------------------------------------------------------------------
-   Function: MV_GetVolumeTable
+   Function: MV_ResetLatency
 
-   Returns a pointer to the volume table associated with the specified
-   volume.
+   Clears the start latency statistics and the recent starts.
 ---------------------------------------------------------------------*/
 
-static short *MV_GetVolumeTable
+void MV_ResetLatency
    (
-   int vol,
-   int is_bgm
+   void
    )
 
    {
-   int volume;
-   short *table;
-
-   volume = MIX_VOLUME( vol );
+   MV_Lock();
 
-   if (is_bgm)
-	  table = (short *) &volume_bgm.volume_table[ volume ];
-   else
-      table = (short *) &volume_sfx.volume_table[ volume ];
+   memset( &MV_Latency, 0, sizeof( MV_Latency ) );
+   memset( MV_LatencyTotal, 0, sizeof( MV_LatencyTotal ) );
+   memset( MV_LatencyHistogram, 0, sizeof( MV_LatencyHistogram ) );
+   MV_NumRecent = 0;
 
-   return( table );
+   MV_Unlock();
    }
 
 
 /*---------------------------------------------------------------------
-   Function: MV_SetVoiceMixMode
-
-   Selects which method should be used to mix the voice.
-
- 8Bit  16Bit  8Bit  16Bit |  8Bit  16Bit  8Bit  16Bit |
- Mono  Mono   Ster  Ster  |  Mono  Mono   Ster  Ster  |  Mixer
- Out   Out    Out   Out   |  In    In     In    In    |
---------------------------+---------------------------+-------------
-  X                       |         X                 | Mix8BitMono16
-  X                       |   X                       | Mix8BitMono
-               X          |         X                 | Mix8BitStereo16
-               X          |   X                       | Mix8BitStereo
-        X                 |         X                 | Mix16BitMono16
-        X                 |   X                       | Mix16BitMono
-                     X    |         X                 | Mix16BitStereo16
-                     X    |   X                       | Mix16BitStereo
---------------------------+---------------------------+-------------
-                     X    |                      X    | Mix16BitStereo16Stereo
-                     X    |                X          | Mix16BitStereo8Stereo
-					X          |                      X    | Mix8BitStereo16Stereo
-               X          |                X          | Mix8BitStereo8Stereo
-		  X                 |                      X    | Mix16BitMono16Stereo
-        X                 |                X          | Mix16BitMono8Stereo
-  X                       |                      X    | Mix8BitMono16Stereo
-  X                       |                X          | Mix8BitMono8Stereo
+   Function: MV_GetRecentStarts
 
+   Copies out the last voice starts to reach the driver, newest first,
+   and returns how many there were.
 ---------------------------------------------------------------------*/
 
-void MV_SetVoiceMixMode
+int MV_GetRecentStarts
    (
-   VoiceNode *voice
+   ASS_VoiceStart *starts,
+   int             count
    )
 
    {
-   //int flags;
-   int test;
+   int i;
 
-   //flags = DisableInterrupts();
+   MV_Lock();
 
-   test = T_DEFAULT;
-   if ( MV_Bits == 8 )
+   count = min( count, ( int )min( MV_NumRecent, MV_RecentStarts ) );
+   for( i = 0; i < count; i++ )
       {
-      test |= T_8BITS;
+      starts[ i ] = MV_Recent[ ( MV_NumRecent - 1 - i ) & ( MV_RecentStarts - 1 ) ];
       }
 
-   if ( MV_Channels == 1 )
-      {
-      test |= T_MONO;
-      }
-   else
-      {
-      if ( IS_QUIET( voice->RightVolume ) )
-         {
-         test |= T_RIGHTQUIET;
-         }
-      else if ( IS_QUIET( voice->LeftVolume ) )
-         {
-         test |= T_LEFTQUIET;
-         }
-      }
-	
-   if ( voice->bits == 16 )
-      {
-      test |= T_16BITSOURCE;
-      }
-	
-	if ( voice->channels == 2 )
-      {
-      test |= T_STEREOSOURCE;
-		test &= ~(T_RIGHTQUIET | T_LEFTQUIET);
-      }
+   MV_Unlock();
 
-   switch( test )
-      {
-      case T_8BITS | T_MONO | T_16BITSOURCE :
-         voice->mix = MV_Mix8BitMono16;
-         break;
+   return( max( count, 0 ) );
+   }
 
-      case T_8BITS | T_MONO :
-         voice->mix = MV_Mix8BitMono;
-         break;
 
-      case T_8BITS | T_16BITSOURCE | T_LEFTQUIET :
-         MV_LeftVolume = MV_RightVolume;
-         voice->mix = MV_Mix8BitMono16;
-         break;
+/*---------------------------------------------------------------------
+   Function: MV_GetMemoryUsage
 
-      case T_8BITS | T_LEFTQUIET :
-         MV_LeftVolume = MV_RightVolume;
-         voice->mix = MV_Mix8BitMono;
-         break;
+   Fills in the memory held by the sound code, by what it is for.
+---------------------------------------------------------------------*/
 
-      case T_8BITS | T_16BITSOURCE | T_RIGHTQUIET :
-         voice->mix = MV_Mix8BitMono16;
-         break;
+void MV_GetMemoryUsage
+   (
+   ASS_MemoryUsage *usage
+   )
 
-      case T_8BITS | T_RIGHTQUIET :
-         voice->mix = MV_Mix8BitMono;
-         break;
+   {
+   unsigned int tables;
 
-      case T_8BITS | T_16BITSOURCE :
-         voice->mix = MV_Mix8BitStereo16;
-         break;
+   ASS_GetMemoryUsage( usage );
 
-      case T_8BITS :
-         voice->mix = MV_Mix8BitStereo;
-         break;
+   tables = sizeof( volume_sfx ) + sizeof( volume_bgm );
+   usage->current[ ASS_MemVolumeTables ] = tables;
+   usage->peak[ ASS_MemVolumeTables ]    = tables;
+   usage->total     += tables;
+   usage->totalpeak += tables;
+   }
 
-      case T_MONO | T_16BITSOURCE :
-         voice->mix = MV_Mix16BitMono16;
-         break;
 
-      case T_MONO :
-         voice->mix = MV_Mix16BitMono;
-         break;
+/*---------------------------------------------------------------------
+   Function: MV_SetMemoryBudget
 
-      case T_16BITSOURCE | T_LEFTQUIET :
-         MV_LeftVolume = MV_RightVolume;
-         voice->mix = MV_Mix16BitMono16;
-         break;
+   Limits the heap memory the sound code may hold, with 0 for no limit.
+   Allocations past it fail as though memory had run out, so a play
+   call returns MV_NoMem rather than the system paging.
+---------------------------------------------------------------------*/
 
-      case T_LEFTQUIET :
-         MV_LeftVolume = MV_RightVolume;
-         voice->mix = MV_Mix16BitMono;
-         break;
+void MV_SetMemoryBudget
+   (
+   unsigned int bytes
+   )
 
-      case T_16BITSOURCE | T_RIGHTQUIET :
-         voice->mix = MV_Mix16BitMono16;
-         break;
+   {
+   ASS_SetMemoryBudget( bytes );
+   }
 
-      case T_RIGHTQUIET :
-         voice->mix = MV_Mix16BitMono;
-         break;
 
-      case T_16BITSOURCE :
-         voice->mix = MV_Mix16BitStereo16;
-         break;
+/*---------------------------------------------------------------------
+   Function: MV_ResetMemoryPeaks
 
-      case T_SIXTEENBIT_STEREO :
-         voice->mix = MV_Mix16BitStereo;
-         break;
-			
-		case T_16BITSOURCE | T_STEREOSOURCE:
-			voice->mix = MV_Mix16BitStereo16Stereo;
-			break;
+   Brings the peak memory figures down to what is held now.
+---------------------------------------------------------------------*/
 
-		case T_16BITSOURCE | T_STEREOSOURCE | T_8BITS:
-			voice->mix = MV_Mix8BitStereo16Stereo;
-			break;
-			
-		case T_16BITSOURCE | T_STEREOSOURCE | T_MONO:
-			voice->mix = MV_Mix16BitMono16Stereo;
-			break;
-			
-		case T_16BITSOURCE | T_STEREOSOURCE | T_8BITS | T_MONO:
-			voice->mix = MV_Mix8BitMono16Stereo;
-			break;
-			
-		case T_STEREOSOURCE:
-			voice->mix = MV_Mix16BitStereo8Stereo;
-			break;
-         
-		case T_STEREOSOURCE | T_8BITS:
-			voice->mix = MV_Mix8BitStereo8Stereo;
-			break;
-			
-		case T_STEREOSOURCE | T_MONO:
-			voice->mix = MV_Mix16BitMono8Stereo;
-			break;
-			
-		case T_STEREOSOURCE | T_8BITS | T_MONO:
-			voice->mix = MV_Mix8BitMono8Stereo;
-			break;
-			
-      default :
-         voice->mix = 0;
-      }
+void MV_ResetMemoryPeaks
+   (
+   void
+   )
 
-   //RestoreInterrupts( flags );
+   {
+   ASS_ResetMemoryPeaks();
    }
 
 
 /*---------------------------------------------------------------------
-   Function: MV_SetVoiceVolume
+   Function: MV_GetMixedFrames
 
-   Sets the stereo and mono volume level of the voice associated
-   with the specified handle.
+   Returns how many output frames have been mixed, counting the block
+   being mixed. The count carries on across restarts, so differences
+   between readings stay meaningful.
 ---------------------------------------------------------------------*/
 
-void MV_SetVoiceVolume
+unsigned int MV_GetMixedFrames
    (
-   VoiceNode *voice,
-   int vol,
-   int left,
-   int right
+   void
    )
 
    {
-   if ( MV_Channels == 1 )
-      {
-      left  = vol;
-      right = vol;
-      }
-
-   int bgm = ( voice->callbackval == -65536 );
-
-   if ( MV_SwapLeftRight )
-      {
-      // SBPro uses reversed panning
-      voice->LeftVolume  = MV_GetVolumeTable( right, bgm );
-      voice->RightVolume = MV_GetVolumeTable( left, bgm );
-      }
-   else
-      {
-      voice->LeftVolume  = MV_GetVolumeTable( left, bgm );
-      voice->RightVolume = MV_GetVolumeTable( right, bgm );
-      }
-
-   MV_SetVoiceMixMode( voice );
+   return( MV_MixedFrames );
    }
 
 
 /*---------------------------------------------------------------------
-   Function: MV_EndLooping
+   Function: MV_GetLevels
 
-   Stops the voice associated with the specified handle from looping
-   without stoping the sound.
+   Fills in the peak, RMS and clipping of the output, for the last
+   block and since playback started or the levels were last reset.
 ---------------------------------------------------------------------*/
 
-int MV_EndLooping
+void MV_GetLevels
    (
-   int handle
+   ASS_OutputLevels *levels
    )
 
    {
-   VoiceNode *voice;
-   int        flags;
+   int channel;
 
-   if ( !MV_Installed )
-      {
-      MV_SetErrorCode( MV_NotInstalled );
-      return( MV_Error );
-      }
+   MV_Lock();
 
-   flags = DisableInterrupts();
+   *levels = MV_Levels;
 
-   voice = MV_GetVoice( handle );
-   if ( voice == NULL )
+   if ( MV_LevelsSamples > 0 )
       {
-      RestoreInterrupts( flags );
-      MV_SetErrorCode( MV_VoiceNotFound );
-      return( MV_Warning );
+      for( channel = 0; channel < 2; channel++ )
+         {
+         levels->avgrms[ channel ] = ( int )sqrt( ( double )
+            MV_LevelsSquares[ channel ] / MV_LevelsSamples );
+         }
       }
 
-   voice->LoopCount = 0;
-   voice->LoopStart = NULL;
-   voice->LoopEnd   = NULL;
-
-   RestoreInterrupts( flags );
-
-   return( MV_Ok );
+   MV_Unlock();
    }
 
 
 /*---------------------------------------------------------------------
-   Function: MV_SetPan
+   Function: MV_ResetLevels
 
-   Sets the stereo and mono volume level of the voice associated
-   with the specified handle.
+   Clears the output levels.
 ---------------------------------------------------------------------*/
 
-int MV_SetPan
+void MV_ResetLevels
    (
-   int handle,
-   int vol,
-   int left,
-   int right
+   void
    )
 
    {
-   VoiceNode *voice;
-
-   if ( !MV_Installed )
-      {
-      MV_SetErrorCode( MV_NotInstalled );
-      return( MV_Error );
-      }
-
-   voice = MV_GetVoice( handle );
-   if ( voice == NULL )
-      {
-      MV_SetErrorCode( MV_VoiceNotFound );
-      return( MV_Warning );
-      }
+   MV_Lock();
 
-   MV_SetVoiceVolume( voice, vol, left, right );
+   memset( &MV_Levels, 0, sizeof( MV_Levels ) );
+   memset( MV_LevelsSquares, 0, sizeof( MV_LevelsSquares ) );
+   MV_LevelsSamples = 0;
 
-   return( MV_Ok );
+   MV_Unlock();
    }
 
 
 /*---------------------------------------------------------------------
-   Function: MV_Pan3D
-
-   Set the angle and distance from the listener of the voice associated
-   with the specified handle.
----------------------------------------------------------------------*/
-
-int MV_Pan3D
-   (
-   int handle,
-   int angle,
-   int distance
-   )
+   Function: MV_SetVoiceProfiling
 
-   {
-   int left;
-   int right;
-   int mid;
-   int volume;
-   int status;
+   Turns the accounting of mixing time to voices on or off, and chooses
+   whether it is gathered by callback value or registered sound ID.
+   Changing the mode starts a new window.
+---------------------------------------------------------------------*/
 
-   if ( distance < 0 )
+int MV_SetVoiceProfiling
+   (
+   int mode
+   )
+
+   {
+   if ( mode < MV_ProfileOff || mode >= MV_NumProfileModes )
       {
-      distance  = -distance;
-      angle    += MV_NumPanPositions / 2;
+      MV_SetErrorCode( MV_InvalidMixMode );
+      return( MV_Error );
       }
 
-   volume = MIX_VOLUME( distance );
-
-   // Ensure angle is within 0 - 31
-   angle &= MV_MaxPanPosition;
+   MV_Lock();
 
-   left  = MV_PanTable[ angle ][ volume ].left;
-   right = MV_PanTable[ angle ][ volume ].right;
-   mid   = max( 0, 255 - distance );
+   if ( mode != MV_ProfileMode )
+      {
+      memset( MV_Profile, 0, sizeof( MV_Profile ) );
+      MV_ProfileMode = mode;
+      }
 
-   status = MV_SetPan( handle, mid, left, right );
+   MV_Unlock();
 
-   return( status );
+   return( MV_Ok );
    }
 
 
 /*---------------------------------------------------------------------
-   Function: MV_SetReverb
+   Function: MV_GetVoiceProfiling
 
-   Sets the level of reverb to add to mix.
+   Returns how mixing time is being accounted to voices.
 ---------------------------------------------------------------------*/
 
-void MV_SetReverb
+int MV_GetVoiceProfiling
    (
-   int reverb
+   void
    )
 
    {
-   MV_ReverbLevel = MIX_VOLUME( reverb );
-   MV_ReverbTable = &volume_sfx.volume_table[ MV_ReverbLevel ];
+   return( MV_ProfileMode );
    }
 
 
 /*---------------------------------------------------------------------
-   Function: MV_SetFastReverb
+   Function: MV_GetVoiceProfile
 
-   Sets the level of reverb to add to mix.
+   Fills in up to count of the most expensive keys since the last call,
+   costliest first, and starts a new window. Returns how many were
+   filled in.
 ---------------------------------------------------------------------*/
 
-void MV_SetFastReverb
+int MV_GetVoiceProfile
    (
-   int reverb
+   ASS_VoiceProfile *top,
+   int               count
    )
 
    {
-   MV_ReverbLevel = max( 0, min( 16, reverb ) );
-   MV_ReverbTable = NULL;
+   MV_ProfileEntry *entry;
+   MV_ProfileEntry *best;
+   uint64_t         cost;
+   uint64_t         bestcost;
+   int              filled;
+   int              i;
+
+   MV_Lock();
+
+   for( filled = 0; filled < count; filled++ )
+      {
+      best     = NULL;
+      bestcost = 0;
+      for( i = 0; i < MV_ProfileEntries; i++ )
+         {
+         entry = &MV_Profile[ i ];
+         cost  = entry->mixtime + entry->refilltime;
+         if ( entry->used && ( best == NULL || cost > bestcost ) )
+            {
+            best     = entry;
+            bestcost = cost;
+            }
+         }
+
+      if ( best == NULL )
+         {
+         break;
+         }
+
+      top[ filled ] = best->profile;
+      top[ filled ].mixtime    = ( unsigned int )( best->mixtime / 1000 );
+      top[ filled ].refilltime = ( unsigned int )( best->refilltime / 1000 );
+
+      // so the next pass finds the next costliest
+      best->used = FALSE;
+      }
+
+   memset( MV_Profile, 0, sizeof( MV_Profile ) );
+
+   MV_Unlock();
+
+   return( filled );
    }
 
 
 /*---------------------------------------------------------------------
-   Function: MV_GetMaxReverbDelay
+   Function: MV_StartTrace
 
-   Returns the maximum delay time for reverb.
+   Begins recording a timeline of mixing, decoding, driver callbacks
+   and lock waits, dropping what an earlier trace recorded.
 ---------------------------------------------------------------------*/
 
-int MV_GetMaxReverbDelay
+void MV_StartTrace
    (
    void
    )
 
    {
-   int maxdelay;
+   TRACE_Start();
+   }
 
-   maxdelay = MixBufferSize * MV_NumberOfBuffers;
 
-   return maxdelay;
+/*---------------------------------------------------------------------
+   Function: MV_StopTrace
+
+   Stops recording the timeline, keeping what was recorded.
+---------------------------------------------------------------------*/
+
+void MV_StopTrace
+   (
+   void
+   )
+
+   {
+   TRACE_Stop();
    }
 
 
 /*---------------------------------------------------------------------
-   Function: MV_GetReverbDelay
+   Function: MV_TraceMark
 
-   Returns the current delay time for reverb.
+   Puts a named instant on the timeline, such as the start of a game
+   frame, to line the audio up against. The name is not copied.
 ---------------------------------------------------------------------*/
 
-int MV_GetReverbDelay
+void MV_TraceMark
    (
-   void
+   const char *name
    )
 
    {
-   return MV_ReverbDelay / MV_SampleSize;
+   TRACE_Mark( name, 0 );
    }
 
 
 /*---------------------------------------------------------------------
-   Function: MV_SetReverbDelay
+   Function: MV_WriteTrace
 
-   Sets the delay level of reverb to add to mix.
+   Saves the recorded timeline as Chrome trace JSON. Tracing may carry
+   on meanwhile.
 ---------------------------------------------------------------------*/
 
-void MV_SetReverbDelay
+int MV_WriteTrace
    (
-   int delay
+   const char *filename
    )
 
    {
-   int maxdelay;
+   if ( TRACE_Write( filename ) < 0 )
+      {
+      MV_SetErrorCode( MV_FileError );
+      return( MV_Error );
+      }
 
-   maxdelay = MV_GetMaxReverbDelay();
-   MV_ReverbDelay = max( MixBufferSize, min( delay, maxdelay ) );
-   MV_ReverbDelay *= MV_SampleSize;
+   return( MV_Ok );
    }
 
 
@@ -1954,6 +3381,17 @@ int MV_StartPlayback
    MV_MixPage = 1;
 
    MV_MixFunction = MV_Mix;
+   MV_ResetUpsampler( &MV_LowRateUpsample );
+   MV_ResetUpsampler( &MV_LODUpsample );
+   MV_LODPending = FALSE;
+   MV_RenderLeft = 0;
+
+   MV_BlockTime = ( unsigned int )( ( uint64_t )MixBufferSize * 1000000 /
+      MV_RequestedMixRate );
+   MV_ResetStats();
+   MV_ResetLevels();
+   MV_ResetLatency();
+   MV_NumPending = 0;
 
 //JIM
 //   MV_MixRate = MV_RequestedMixRate;
@@ -1967,7 +3405,7 @@ int MV_StartPlayback
       return MV_Error;
    }
 	
-   MV_MixRate = MV_RequestedMixRate;
+   MV_MixRate = MV_RequestedMixRate / MV_MixDivisor;
 
    return( MV_Ok );
    }
@@ -2011,6 +3449,120 @@ void MV_StopPlayback
    }
 
 
+/*---------------------------------------------------------------------
+   Function: MV_Render
+
+   Mixes the next frames of output into the caller's buffer, in the
+   given format, for hosts that own the audio device. Initialise with
+   ASS_NoSound so no driver mixes at the same time. Frames are mixed a
+   block at a time and any left over are handed out on the next call.
+---------------------------------------------------------------------*/
+
+int MV_Render
+   (
+   void *buffer,
+   int   frames,
+   int   numchannels,
+   int   samplebits
+   )
+
+   {
+   char  *dest;
+   char  *source;
+   int    count;
+   int    i;
+   int    left;
+   int    right;
+
+   if ( !MV_Installed )
+      {
+      MV_SetErrorCode( MV_NotInstalled );
+      return( MV_Error );
+      }
+
+   if ( ( numchannels != 1 && numchannels != 2 ) ||
+      ( samplebits != 8 && samplebits != 16 ) || frames < 0 )
+      {
+      MV_SetErrorCode( MV_InvalidMixMode );
+      return( MV_Error );
+      }
+
+   DisableInterrupts();
+
+   dest = ( char * )buffer;
+   while( frames > 0 )
+      {
+      if ( MV_RenderLeft == 0 )
+         {
+         // Streams are read as the mix reaches them, so the output
+         // does not depend on how fast the caller pulls it
+         MV_Rendering = TRUE;
+         MV_ServiceVoc();
+         MV_Rendering = FALSE;
+         MV_HandOffStarts( 0 );
+         MV_RenderLeft = MixBufferSize;
+         }
+
+      count  = min( frames, MV_RenderLeft );
+      source = MV_MixBuffer[ MV_MixPage ] +
+         ( MixBufferSize - MV_RenderLeft ) * MV_SampleSize;
+
+      if ( numchannels == MV_Channels && samplebits == MV_Bits )
+         {
+         memcpy( dest, source, count * MV_SampleSize );
+         dest += count * MV_SampleSize;
+         }
+      else
+         {
+         for( i = 0; i < count * MV_Channels; i += MV_Channels )
+            {
+            if ( MV_Bits == 16 )
+               {
+               left  = ( ( short * )source )[ i ];
+               right = ( ( short * )source )[ i + MV_Channels - 1 ];
+               }
+            else
+               {
+               left  = ( ( ( unsigned char * )source )[ i ] - 128 ) << 8;
+               right = ( ( ( unsigned char * )source )[ i + MV_Channels - 1 ] - 128 ) << 8;
+               }
+
+            if ( numchannels == 1 )
+               {
+               left = ( left + right ) >> 1;
+               }
+
+            if ( samplebits == 16 )
+               {
+               *( short * )dest = ( short )left;
+               dest += 2;
+               if ( numchannels == 2 )
+                  {
+                  *( short * )dest = ( short )right;
+                  dest += 2;
+                  }
+               }
+            else
+               {
+               *dest++ = ( char )( ( left >> 8 ) + 128 );
+               if ( numchannels == 2 )
+                  {
+                  *dest++ = ( char )( ( right >> 8 ) + 128 );
+                  }
+               }
+            }
+         }
+
+      MV_RenderLeft -= count;
+      frames        -= count;
+      }
+
+   RestoreInterrupts( 0 );
+
+   return( MV_Ok );
+   }
+
+
 /*---------------------------------------------------------------------
    Function: MV_StartRecording
 
@@ -2341,6 +3893,24 @@ int MV_PlayLoopedWAV
 	memcpy(&data, ptr + sizeof(riff_header) + riff.format_size, sizeof(data_header));
 	data.size = LITTLE32(data.size);
 
+   // ADPCM data is decoded as it plays
+   if ( format.wFormatTag == WAVE_FORMAT_ADPCM ||
+      format.wFormatTag == WAVE_FORMAT_IMA_ADPCM )
+      {
+      DecodeState adpcm;
+      int status;
+
+      status = MV_ParseADPCMWAV( ptr, ptrlength, &adpcm );
+      if ( status != MV_Ok )
+         {
+         MV_SetErrorCode( status );
+         return( MV_Error );
+         }
+
+      return( MV_PlayLoopedADPCM( &adpcm, loopstart, loopend, pitchoffset,
+         vol, left, right, priority, callbackval ) );
+      }
+
    // Check if it's PCM data.
    if ( format.wFormatTag != 1 )
       {
@@ -2417,6 +3987,131 @@ int MV_PlayLoopedWAV
    }
 
 
+/*---------------------------------------------------------------------
+   Function: MV_PlayLoopedPCM
+
+   Begin playback of PCM data whose format is already known, such as
+   a sound bank entry. Length and loop points are in sample frames;
+   a loopstart of -1 plays the sound once.
+---------------------------------------------------------------------*/
+
+int MV_PlayLoopedPCM
+   (
+   char *ptr,
+   unsigned int length,
+   int   loopstart,
+   int   loopend,
+   unsigned int rate,
+   int   bits,
+   int   channels,
+   int   pitchoffset,
+   int   vol,
+   int   left,
+   int   right,
+   int   priority,
+   unsigned int callbackval
+   )
+
+   {
+   VoiceNode *voice;
+
+   if ( !MV_Installed )
+      {
+      MV_SetErrorCode( MV_NotInstalled );
+      return( MV_Error );
+      }
+
+   // Request a voice from the voice pool
+   voice = MV_AllocVoice( priority );
+   if ( voice == NULL )
+      {
+      MV_SetErrorCode( MV_NoVoices );
+      return( MV_Error );
+      }
+
+   voice->wavetype    = WAV;
+   voice->bits        = bits;
+   voice->channels    = channels;
+   voice->GetSound    = MV_GetNextWAVBlock;
+
+   voice->Playing     = TRUE;
+   voice->Paused      = FALSE;
+   voice->DemandFeed  = NULL;
+   voice->LoopCount   = 0;
+   voice->position    = 0;
+   voice->length      = 0;
+   voice->NextBlock   = ptr;
+   voice->next        = NULL;
+   voice->prev        = NULL;
+   voice->priority    = priority;
+   voice->callbackval = callbackval;
+   voice->LoopEnd     = NULL;
+
+   if ( ( loopstart >= 0 ) && ( ( unsigned )loopstart < length ) )
+      {
+      if ( ( loopend <= loopstart ) || ( ( unsigned )loopend > length ) )
+         {
+         loopend = length;
+         }
+
+      // Play up to the loop end, then repeat the loop
+      voice->BlockLength = loopend;
+      voice->LoopStart   = ptr + loopstart * ( channels * bits / 8 );
+      voice->LoopSize    = loopend - loopstart;
+      }
+   else
+      {
+      voice->BlockLength = length;
+      voice->LoopStart   = NULL;
+      voice->LoopSize    = 0;
+      }
+
+   MV_SetVoicePitch( voice, rate, pitchoffset );
+   MV_SetVoiceVolume( voice, vol, left, right );
+   MV_PlayVoice( voice );
+
+   return( voice->handle );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: MV_KillVoicesInRange
+
+   Stops every voice playing from the given block of memory, so that
+   it may be released.
+---------------------------------------------------------------------*/
+
+void MV_KillVoicesInRange
+   (
+   const char *start,
+   const char *end
+   )
+
+   {
+   VoiceNode * voice, * next;
+   int        flags;
+
+   if ( !MV_Installed )
+      {
+      return;
+      }
+
+   flags = DisableInterrupts();
+
+   for( voice = VoiceList.next; voice != &VoiceList; voice = next )
+      {
+      next = voice->next;
+      if ( ( voice->NextBlock >= start && voice->NextBlock <= end ) ||
+         ( voice->sound >= start && voice->sound < end ) )
+         {
+         MV_Kill( voice->handle );
+         }
+      }
+
+   RestoreInterrupts( flags );
+   }
+
+
 /*---------------------------------------------------------------------
    Function: MV_PlayVOC3D
 
@@ -2555,6 +4250,8 @@ int MV_PlayLoopedVOC
    voice->LoopStart   = NULL;
    voice->LoopCount   = 0;
    voice->BlockLength = 0;
+   voice->decode.format    = DecodePCM;
+   voice->decode.remaining = 0;
    voice->PitchScale  = PITCH_GetScale( pitchoffset );
    voice->length      = 0;
    voice->next        = NULL;
@@ -2816,8 +4513,11 @@ int MV_Init
 
    MV_SetErrorCode( MV_Ok );
 
-   MV_TotalMemory = Voices * sizeof( VoiceNode ) + sizeof( HARSH_CLIP_TABLE_8 ) + TotalBufferSize;
-	ptr = (char *) malloc( MV_TotalMemory );
+   MV_InitResamplers();
+
+   MV_TotalMemory = Voices * ( sizeof( VoiceNode ) + MV_DecodeBufferSize ) +
+      TotalBufferSize;
+   ptr = (char *) ASS_Alloc( ASS_MemMixer, MV_TotalMemory );
    if ( !ptr )
       {
       MV_SetErrorCode( MV_NoMem );
@@ -2828,9 +4528,17 @@ int MV_Init
 
    MV_Voices = ( VoiceNode * )ptr;
 	ptr += Voices * sizeof( VoiceNode );
+
+   // Give each voice room to decode compressed sources into
+   for( index = 0; index < Voices; index++ )
+      {
+      MV_Voices[ index ].decode.buffer = ptr;
+      ptr += MV_DecodeBufferSize;
+      }
 	
-   MV_HarshClipTable = ptr;
-	ptr += sizeof(HARSH_CLIP_TABLE_8);
+   // MV_CalcVolume fills this in; a separate block was left all zero,
+   // which clamped every 8-bit output sample to the bottom rail
+   MV_HarshClipTable = volume_sfx.harshclip_table;
 	
    // Set number of voices before calculating volume table
    MV_MaxVoices = Voices;
@@ -2857,7 +4565,7 @@ int MV_Init
       {
       status = MV_ErrorCode;
 
-      free( MV_Voices );
+      ASS_Free( MV_Voices );
       MV_Voices      = NULL;
       MV_HarshClipTable = NULL;
       MV_TotalMemory = 0;
@@ -2943,8 +4651,16 @@ int MV_Shutdown
    // Shutdown the sound card
 	SoundDriver_PCM_Shutdown();
 
+   // Close any streams, now that nothing is mixing them
+   MV_ShutdownStreams();
+
+   #ifdef HAVE_VORBIS
+   // Drop the cached Vorbis seek indexes
+   MV_FlushVorbisIndexes();
+   #endif
+
    // Free any voices we allocated
-   free( MV_Voices );
+   ASS_Free( MV_Voices );
    MV_Voices      = NULL;
    MV_TotalMemory = 0;
 
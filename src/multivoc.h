@@ -31,6 +31,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #ifndef __MULTIVOC_H
 #define __MULTIVOC_H
 
+#include "sndcards.h"
+
 #define MV_MinVoiceHandle  1
 
 extern int MV_ErrorCode;
@@ -50,7 +52,28 @@ enum MV_Errors
    MV_InvalidWAVFile,
 	MV_InvalidVorbisFile,
    MV_InvalidMixMode,
-   MV_NullRecordFunction
+   MV_NullRecordFunction,
+   MV_FileError,
+   MV_InvalidBank,
+   MV_UnknownFormat,
+   MV_InvalidSoundID
+   };
+
+enum MV_Resamplers
+   {
+   MV_ResampleNearest,
+   MV_ResampleLinear,
+   MV_ResampleCubic,
+   MV_ResampleSinc,
+   MV_NumResamplers
+   };
+
+enum MV_VoiceProfiling
+   {
+   MV_ProfileOff,
+   MV_ProfileByCallback,
+   MV_ProfileBySound,
+   MV_NumProfileModes
    };
 
 typedef struct Volume_LUT
@@ -72,6 +95,9 @@ int   MV_PauseVoice( int handle, int pauseon );
 int   MV_VoicesPlaying( void );
 int   MV_VoiceAvailable( int priority );
 int   MV_SetPitch( int handle, int pitchoffset );
+int   MV_SetVoiceResampler( int handle, int resampler );
+int   MV_SetDefaultResampler( int resampler );
+int   MV_GetDefaultResampler( void );
 int   MV_SetFrequency( int handle, int frequency );
 int   MV_EndLooping( int handle );
 int   MV_SetPan( int handle, int vol, int left, int right );
@@ -81,9 +107,32 @@ void  MV_SetFastReverb( int reverb );
 int   MV_GetMaxReverbDelay( void );
 int   MV_GetReverbDelay( void );
 void  MV_SetReverbDelay( int delay );
+int   MV_SetMixRateDivisor( int divisor );
+int   MV_GetMixRateDivisor( void );
+int   MV_SetVoiceLOD( int threshold, int divisor );
+int   MV_GetVoiceLOD( void );
+void  MV_GetStats( ASS_MixStats *stats );
+void  MV_ResetStats( void );
+unsigned int MV_GetMixedFrames( void );
+void  MV_GetLevels( ASS_OutputLevels *levels );
+void  MV_ResetLevels( void );
+void  MV_GetLatency( ASS_StartLatency *latency );
+void  MV_ResetLatency( void );
+int   MV_GetRecentStarts( ASS_VoiceStart *starts, int count );
+void  MV_GetMemoryUsage( ASS_MemoryUsage *usage );
+void  MV_SetMemoryBudget( unsigned int bytes );
+void  MV_ResetMemoryPeaks( void );
+int   MV_SetVoiceProfiling( int mode );
+int   MV_GetVoiceProfiling( void );
+int   MV_GetVoiceProfile( ASS_VoiceProfile *top, int count );
+void  MV_StartTrace( void );
+void  MV_StopTrace( void );
+void  MV_TraceMark( const char *name );
+int   MV_WriteTrace( const char *filename );
 int   MV_SetMixMode( int numchannels, int samplebits );
 int   MV_StartPlayback( void );
 void  MV_StopPlayback( void );
+int   MV_Render( void *buffer, int frames, int numchannels, int samplebits );
 int   MV_StartRecording( int MixRate, void ( *function )( char *ptr, int length ) );
 void  MV_StopRecord( void );
 int   MV_StartDemandFeedPlayback( void ( *function )( char **ptr, unsigned int *length ),
@@ -117,6 +166,37 @@ int   MV_PlayVorbis( char *ptr, unsigned int length, int pitchoffset, int vol, i
 int   MV_PlayLoopedVorbis( char *ptr, unsigned int length, int loopstart, int loopend,
                         int pitchoffset, int vol, int left, int right, int priority,
                         unsigned int callbackval );
+int   MV_PlayLoopedVorbisFrom( char *ptr, unsigned int length, int startpos, int loopstart,
+                        int loopend, int pitchoffset, int vol, int left, int right,
+                        int priority, unsigned int callbackval );
+int   MV_SetVorbisPosition( int handle, int position );
+int   MV_PlayStream( const char *filename, int pitchoffset, int vol, int left, int right,
+         int priority, unsigned int callbackval );
+int   MV_PlayLoopedStream( const char *filename, int loopstart, int loopend,
+         int pitchoffset, int vol, int left, int right, int priority,
+         unsigned int callbackval );
+int   MV_OpenSoundBank( const char *filename );
+int   MV_CloseSoundBank( int bank );
+int   MV_SoundBankEntries( int bank );
+int   MV_PlayBankSound( int bank, int entry, int pitchoffset, int vol, int left,
+         int right, int priority, unsigned int callbackval );
+int   MV_PlayLoopedBankSound( int bank, int entry, int pitchoffset, int vol, int left,
+         int right, int priority, unsigned int callbackval );
+int   MV_PlayBankSound3D( int bank, int entry, int pitchoffset, int angle, int distance,
+         int priority, unsigned int callbackval );
+void  MV_SetSoundResampling( unsigned int maxbytes );
+unsigned int MV_GetResampledMemory( void );
+void  MV_SetSoundTranscoding( unsigned int threshold );
+int   MV_SoundIsTranscoded( int id );
+unsigned int MV_GetTranscodeSavings( void );
+int   MV_RegisterSound( char *ptr, unsigned int length );
+int   MV_UnregisterSound( int id );
+int   MV_PlayID( int id, int pitchoffset, int vol, int left, int right, int priority,
+         unsigned int callbackval );
+int   MV_PlayLoopedID( int id, int loopstart, int loopend, int pitchoffset, int vol,
+         int left, int right, int priority, unsigned int callbackval );
+int   MV_PlayID3D( int id, int pitchoffset, int angle, int distance, int priority,
+         unsigned int callbackval );
 void  MV_CreateVolumeTable( int index, int volume, int MaxVolume, Volume_LUT *vol );
 void  MV_SetVolume( int volume );
 int   MV_GetVolume( void );
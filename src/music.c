@@ -36,6 +36,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "midi.h"
 #include "ll_man.h"
 #include "multivoc.h"
+#include "journal.h"
 
 #define TRUE  ( 1 == 1 )
 #define FALSE ( !TRUE )
@@ -236,6 +237,7 @@ void MUSIC_SetVolume
 
    // Calculate volume table
    MV_CalcVolume( volume, &volume_bgm );
+   JOURNAL_Call( JOURNAL_MusicSetVolume, 0, 1, volume );
 
    /*if ( MUSIC_SoundDevice != -1 )
       {
@@ -258,6 +260,7 @@ void MUSIC_SetMidiChannelVolume
 
    {
    MIDI_SetUserChannelVolume( channel, volume );
+   JOURNAL_Call( JOURNAL_MusicSetChannelVolume, 0, 2, channel, volume );
    }
 
 
@@ -274,6 +277,7 @@ void MUSIC_ResetMidiChannelVolumes
 
    {
    MIDI_ResetUserChannelVolume();
+   JOURNAL_Call( JOURNAL_MusicResetChannelVolumes, 0, 0 );
    }
 
 
@@ -311,6 +315,7 @@ void MUSIC_SetLoopFlag
 
    {
    MIDI_SetLoopFlag( loopflag );
+   JOURNAL_Call( JOURNAL_MusicSetLoopFlag, 0, 1, loopflag );
    }
 
 
@@ -343,6 +348,7 @@ void MUSIC_Continue
 
    {
    MIDI_ContinueSong();
+   JOURNAL_Call( JOURNAL_MusicContinue, 0, 0 );
    }
 
 
@@ -359,6 +365,7 @@ void MUSIC_Pause
 
    {
    MIDI_PauseSong();
+   JOURNAL_Call( JOURNAL_MusicPause, 0, 0 );
    }
 
 
@@ -376,6 +383,7 @@ int MUSIC_StopSong
    {
    MUSIC_StopFade();
    MIDI_StopSong();
+   JOURNAL_Call( JOURNAL_MusicStopSong, MUSIC_Ok, 0 );
    MUSIC_SetErrorCode( MUSIC_Ok );
    return( MUSIC_Ok );
    }
@@ -399,6 +407,8 @@ int MUSIC_PlaySong
 
    MIDI_StopSong();
    status = MIDI_PlaySong( song, loopflag );
+   JOURNAL_CallAsset( JOURNAL_MusicPlaySong, status == MIDI_Ok ? MUSIC_Ok : MUSIC_Warning,
+      song, length, 1, loopflag );
    if ( status != MIDI_Ok )
       {
       MUSIC_SetErrorCode( MUSIC_MidiError );
@@ -422,6 +432,7 @@ void MUSIC_SetContext
 
    {
    MIDI_SetContext( context );
+   JOURNAL_Call( JOURNAL_MusicSetContext, 0, 1, context );
    }
 
 
@@ -454,6 +465,7 @@ void MUSIC_SetSongTick
 
    {
    MIDI_SetSongTick( PositionInTicks );
+   JOURNAL_Call( JOURNAL_MusicSetSongTick, 0, 1, PositionInTicks );
    }
 
 
@@ -470,6 +482,7 @@ void MUSIC_SetSongTime
 
    {
    MIDI_SetSongTime( milliseconds );
+   JOURNAL_Call( JOURNAL_MusicSetSongTime, 0, 1, milliseconds );
    }
 
 
@@ -488,6 +501,7 @@ void MUSIC_SetSongPosition
 
    {
    MIDI_SetSongPosition( measure, beat, tick );
+   JOURNAL_Call( JOURNAL_MusicSetSongPosition, 0, 3, measure, beat, tick );
    }
 
 
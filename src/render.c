@@ -0,0 +1,572 @@
+/*
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+ */
+
+/**
+ * Renders scripts of timed sound effect events to WAV files
+ *
+ *   render [-j jobs] [-r rate] [-c channels] [-b bits] [-v voices] script ...
+ *
+ * Each script renders to a WAV file of the same name with its extension
+ * replaced. Mixing is pulled with FX_Render, so no sound device is needed
+ * and it runs as fast as the mixer can go. The library keeps its state in
+ * globals, so scripts render in parallel as separate processes.
+ *
+ * Scripts are one command per line, # starting a comment:
+ *
+ *   load <name> <file>            read a WAV, VOC or Ogg Vorbis file
+ *   length <ms>                   stop rendering here
+ *   at <ms> play <slot> <name> [pitch <n>] [vol <n>] [pan <left> <right>]
+ *                                 [3d <angle> <distance>] [loop]
+ *   at <ms> pan <slot> <vol> <left> <right>
+ *   at <ms> pan3d <slot> <angle> <distance>
+ *   at <ms> pitch <slot> <offset>
+ *   at <ms> stop <slot>
+ *   at <ms> stopall
+ *   at <ms> reverb <amount>
+ *   at <ms> volume <volume>
+ *
+ * Slots are numbered 0 to 255 and name the voice started by a play
+ * command for the later commands. Without a length, rendering stops once
+ * the last event has passed and nothing is left playing, so a script
+ * that plays anything looped must give one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+# include <process.h>
+#else
+# include <sys/types.h>
+# include <sys/wait.h>
+# include <unistd.h>
+#endif
+
+#include "fx_man.h"
+#include "sndcards.h"
+#include "tools.h"
+#include "asssys.h"
+
+#ifdef __POWERPC__
+# define BIGENDIAN
+#endif
+
+#define MAXSLOTS 256
+#define BLOCKFRAMES 1024
+
+enum {
+    EV_PLAY,
+    EV_PAN,
+    EV_PAN3D,
+    EV_PITCH,
+    EV_STOP,
+    EV_STOPALL,
+    EV_REVERB,
+    EV_VOLUME
+};
+
+typedef struct {
+    char * name;
+    char * data;
+    unsigned int length;
+} asset;
+
+typedef struct {
+    unsigned int time;      // milliseconds
+    int line;
+    int type;
+    int slot;
+    int asset;
+    int pitch;
+    int vol, left, right;
+    int angle, distance;
+    int use3d;
+    int loop;
+} event;
+
+typedef struct {
+    asset * assets;
+    int numassets;
+    event * events;
+    int numevents;
+    int length;             // milliseconds, or -1 to run until silent
+} script;
+
+static int MixRate = 44100;
+static int NumChannels = 2;
+static int NumBits = 16;
+static int NumVoices = 32;
+
+
+static int findasset(script * s, const char * name)
+{
+    int i;
+
+    for (i = 0; i < s->numassets; i++) {
+        if (!strcmp(s->assets[i].name, name)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int parseevent(script * s, event * ev, char ** words, int numwords)
+{
+    int i;
+
+    if (numwords < 3) {
+        return 0;
+    }
+
+    ev->time = strtoul(words[1], 0, 10);
+    ev->slot = numwords > 3 ? atoi(words[3]) : 0;
+
+    if (!strcmp(words[2], "play") && numwords >= 5) {
+        ev->type = EV_PLAY;
+        ev->asset = findasset(s, words[4]);
+        if (ev->asset < 0) {
+            return 0;
+        }
+        ev->vol = ev->left = ev->right = 255;
+        for (i = 5; i < numwords; i++) {
+            if (!strcmp(words[i], "pitch") && i + 1 < numwords) {
+                ev->pitch = atoi(words[++i]);
+            } else if (!strcmp(words[i], "vol") && i + 1 < numwords) {
+                ev->vol = atoi(words[++i]);
+            } else if (!strcmp(words[i], "pan") && i + 2 < numwords) {
+                ev->left = atoi(words[++i]);
+                ev->right = atoi(words[++i]);
+            } else if (!strcmp(words[i], "3d") && i + 2 < numwords) {
+                ev->use3d = 1;
+                ev->angle = atoi(words[++i]);
+                ev->distance = atoi(words[++i]);
+            } else if (!strcmp(words[i], "loop")) {
+                ev->loop = 1;
+            } else {
+                return 0;
+            }
+        }
+    } else if (!strcmp(words[2], "pan") && numwords == 7) {
+        ev->type = EV_PAN;
+        ev->vol = atoi(words[4]);
+        ev->left = atoi(words[5]);
+        ev->right = atoi(words[6]);
+    } else if (!strcmp(words[2], "pan3d") && numwords == 6) {
+        ev->type = EV_PAN3D;
+        ev->angle = atoi(words[4]);
+        ev->distance = atoi(words[5]);
+    } else if (!strcmp(words[2], "pitch") && numwords == 5) {
+        ev->type = EV_PITCH;
+        ev->pitch = atoi(words[4]);
+    } else if (!strcmp(words[2], "stop") && numwords == 4) {
+        ev->type = EV_STOP;
+    } else if (!strcmp(words[2], "stopall") && numwords == 3) {
+        ev->type = EV_STOPALL;
+    } else if (!strcmp(words[2], "reverb") && numwords == 4) {
+        ev->type = EV_REVERB;
+        ev->vol = atoi(words[3]);
+        ev->slot = 0;
+    } else if (!strcmp(words[2], "volume") && numwords == 4) {
+        ev->type = EV_VOLUME;
+        ev->vol = atoi(words[3]);
+        ev->slot = 0;
+    } else {
+        return 0;
+    }
+
+    if (ev->slot < 0 || ev->slot >= MAXSLOTS) {
+        return 0;
+    }
+
+    return 1;
+}
+
+static void freescript(script * s)
+{
+    int i;
+
+    for (i = 0; i < s->numassets; i++) {
+        free(s->assets[i].name);
+        free(s->assets[i].data);
+    }
+    free(s->assets);
+    free(s->events);
+}
+
+static int compareevents(const void * a, const void * b)
+{
+    const event * ea = (const event *) a;
+    const event * eb = (const event *) b;
+
+    if (ea->time != eb->time) {
+        return ea->time < eb->time ? -1 : 1;
+    }
+    return ea->line - eb->line;     // keep same-time events in script order
+}
+
+static int loadscript(script * s, const char * filename)
+{
+    FILE * fp;
+    char buf[1024], * words[16], * p;
+    int numwords, line = 0, i;
+    unsigned int length;
+
+    memset(s, 0, sizeof(script));
+    s->length = -1;
+
+    fp = fopen(filename, "r");
+    if (!fp) {
+        fprintf(stderr, "%s: could not read\n", filename);
+        return 0;
+    }
+
+    while (fgets(buf, sizeof(buf), fp)) {
+        line++;
+
+        p = strchr(buf, '#');
+        if (p) {
+            *p = 0;
+        }
+
+        numwords = 0;
+        for (p = strtok(buf, " \t\r\n"); p && numwords < 16; p = strtok(0, " \t\r\n")) {
+            words[numwords++] = p;
+        }
+        if (numwords == 0) {
+            continue;
+        }
+
+        if (!strcmp(words[0], "load") && numwords == 3) {
+            asset * a;
+
+            a = (asset *) realloc(s->assets, (s->numassets + 1) * sizeof(asset));
+            if (!a) {
+                break;
+            }
+            s->assets = a;
+            a = &s->assets[s->numassets];
+            a->data = loadfile(words[2], &length);
+            if (!a->data) {
+                fprintf(stderr, "%s:%d: could not read %s\n", filename, line, words[2]);
+                break;
+            }
+            a->length = length;
+            a->name = strdup(words[1]);
+            s->numassets++;
+        } else if (!strcmp(words[0], "length") && numwords == 2) {
+            s->length = atoi(words[1]);
+        } else if (!strcmp(words[0], "at")) {
+            event * ev;
+
+            ev = (event *) realloc(s->events, (s->numevents + 1) * sizeof(event));
+            if (!ev) {
+                break;
+            }
+            s->events = ev;
+            ev = &s->events[s->numevents];
+            memset(ev, 0, sizeof(event));
+            ev->line = line;
+            if (!parseevent(s, ev, words, numwords)) {
+                fprintf(stderr, "%s:%d: bad event\n", filename, line);
+                break;
+            }
+            s->numevents++;
+        } else {
+            fprintf(stderr, "%s:%d: unknown command %s\n", filename, line, words[0]);
+            break;
+        }
+    }
+
+    if (!feof(fp)) {
+        fclose(fp);
+        freescript(s);
+        return 0;
+    }
+    fclose(fp);
+
+    if (s->length < 0) {
+        for (i = 0; i < s->numevents; i++) {
+            if (s->events[i].loop) {
+                fprintf(stderr, "%s:%d: a looped play needs a length to stop at\n",
+                        filename, s->events[i].line);
+                freescript(s);
+                return 0;
+            }
+        }
+    }
+
+    qsort(s->events, s->numevents, sizeof(event), compareevents);
+
+    return 1;
+}
+
+static void runevent(script * s, event * ev, int * handles)
+{
+    asset * a;
+
+    switch (ev->type) {
+        case EV_PLAY:
+            a = &s->assets[ev->asset];
+            if (ev->use3d && ev->loop) {
+                // there's no looped 3D play, so pan it once started
+                handles[ev->slot] = FX_PlayLoopedAuto(a->data, a->length, 0, -1, ev->pitch,
+                                                      255, 255, 255, 1, 0);
+                FX_Pan3D(handles[ev->slot], ev->angle, ev->distance);
+            } else if (ev->use3d) {
+                handles[ev->slot] = FX_PlayAuto3D(a->data, a->length, ev->pitch,
+                                                  ev->angle, ev->distance, 1, 0);
+            } else if (ev->loop) {
+                handles[ev->slot] = FX_PlayLoopedAuto(a->data, a->length, 0, -1, ev->pitch,
+                                                      ev->vol, ev->left, ev->right, 1, 0);
+            } else {
+                handles[ev->slot] = FX_PlayAuto(a->data, a->length, ev->pitch,
+                                                ev->vol, ev->left, ev->right, 1, 0);
+            }
+            break;
+        case EV_PAN:
+            FX_SetPan(handles[ev->slot], ev->vol, ev->left, ev->right);
+            break;
+        case EV_PAN3D:
+            FX_Pan3D(handles[ev->slot], ev->angle, ev->distance);
+            break;
+        case EV_PITCH:
+            FX_SetPitch(handles[ev->slot], ev->pitch);
+            break;
+        case EV_STOP:
+            FX_StopSound(handles[ev->slot]);
+            break;
+        case EV_STOPALL:
+            FX_StopAllSounds();
+            break;
+        case EV_REVERB:
+            FX_SetReverb(ev->vol);
+            break;
+        case EV_VOLUME:
+            FX_SetVolume(ev->vol);
+            break;
+    }
+}
+
+#ifdef BIGENDIAN
+static void swapsamples(char * buf, int bytes)
+{
+    char t;
+    int i;
+
+    for (i = 0; i < bytes; i += 2) {
+        t = buf[i];
+        buf[i] = buf[i + 1];
+        buf[i + 1] = t;
+    }
+}
+#endif
+
+static int renderscript(const char * filename, const char * outname)
+{
+    script s;
+    FILE * fp;
+    char * buf;
+    int handles[MAXSLOTS];
+    int framesize = NumChannels * NumBits / 8;
+    unsigned int frame = 0, endframe, nextframe;
+    unsigned int ticks;
+    int count, i, ev = 0;
+
+    if (!loadscript(&s, filename)) {
+        return 0;
+    }
+
+    fp = fopen(outname, "wb");
+    if (!fp) {
+        fprintf(stderr, "%s: could not create\n", outname);
+        freescript(&s);
+        return 0;
+    }
+    writewavheader(fp, MixRate, NumChannels, NumBits, 0);
+
+    if (FX_Init(ASS_NoSound, NumVoices, &NumChannels, &NumBits, &MixRate, 0) != FX_Ok) {
+        fprintf(stderr, "%s: FX_Init failed: %s\n", filename, FX_ErrorString(FX_Error));
+        fclose(fp);
+        freescript(&s);
+        return 0;
+    }
+
+    buf = (char *) malloc(BLOCKFRAMES * framesize);
+    for (i = 0; i < MAXSLOTS; i++) {
+        handles[i] = FX_Warning;
+    }
+
+    endframe = s.length >= 0 ? (unsigned int) ((unsigned long long) s.length * MixRate / 1000) : ~0u;
+    ticks = ASS_GetTicks();
+
+    while (frame < endframe) {
+        while (ev < s.numevents &&
+               (unsigned long long) s.events[ev].time * MixRate / 1000 <= frame) {
+            runevent(&s, &s.events[ev++], handles);
+        }
+
+        if (s.length < 0 && ev == s.numevents && !FX_SoundsPlaying()) {
+            break;
+        }
+
+        // stop short at the next event so it starts on its own frame
+        nextframe = endframe;
+        if (ev < s.numevents) {
+            nextframe = (unsigned int) ((unsigned long long) s.events[ev].time * MixRate / 1000);
+        }
+        count = BLOCKFRAMES;
+        if (nextframe - frame < (unsigned int) count) {
+            count = nextframe - frame;
+        }
+
+        FX_Render(buf, count, NumChannels, NumBits);
+#ifdef BIGENDIAN
+        if (NumBits == 16) {
+            swapsamples(buf, count * framesize);
+        }
+#endif
+        fwrite(buf, 1, count * framesize, fp);
+        frame += count;
+    }
+
+    ticks = ASS_GetTicks() - ticks;
+
+    FX_Shutdown();
+    free(buf);
+    freescript(&s);
+
+    writewavheader(fp, MixRate, NumChannels, NumBits, frame * framesize);
+    if (fclose(fp)) {
+        fprintf(stderr, "%s: write failed\n", outname);
+        return 0;
+    }
+
+    printf("%s: %.2fs of audio in %.2fs", outname, (double) frame / MixRate, ticks / 1000.0);
+    if (ticks) {
+        printf(" (%.1fx realtime)", (double) frame * 1000 / MixRate / ticks);
+    }
+    printf("\n");
+
+    return 1;
+}
+
+static char * outputname(const char * filename)
+{
+    char * name, * dot;
+
+    name = (char *) malloc(strlen(filename) + 5);
+    strcpy(name, filename);
+
+    dot = strrchr(name, '.');
+    if (dot && !strpbrk(dot, "/\\")) {
+        *dot = 0;
+    }
+    strcat(name, ".wav");
+
+    return name;
+}
+
+static int renderfile(const char * filename)
+{
+    char * outname = outputname(filename);
+    int ok;
+
+    ok = renderscript(filename, outname);
+    free(outname);
+
+    return ok;
+}
+
+int main(int argc, char ** argv)
+{
+    int jobs = 1, failed = 0;
+    unsigned int ticks;
+    int i;
+#ifndef _WIN32
+    int running = 0, status;
+    pid_t pid;
+#endif
+
+    for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+        if (i + 1 >= argc) {
+            break;
+        }
+        switch (argv[i][1]) {
+            case 'j': jobs = atoi(argv[++i]); break;
+            case 'r': MixRate = atoi(argv[++i]); break;
+            case 'c': NumChannels = atoi(argv[++i]); break;
+            case 'b': NumBits = atoi(argv[++i]); break;
+            case 'v': NumVoices = atoi(argv[++i]); break;
+            default: i = argc; break;
+        }
+    }
+
+    if (i >= argc || jobs < 1) {
+        fprintf(stderr, "usage: %s [-j jobs] [-r rate] [-c channels] [-b bits] "
+                        "[-v voices] script ...\n", argv[0]);
+        return 1;
+    }
+
+    ticks = ASS_GetTicks();
+
+#ifdef _WIN32
+    for (; i < argc; i++) {
+        if (!renderfile(argv[i])) {
+            failed++;
+        }
+    }
+#else
+    while (i < argc || running > 0) {
+        if (i < argc && running < jobs) {
+            fflush(stdout);
+            pid = fork();
+            if (pid == 0) {
+                return renderfile(argv[i]) ? 0 : 1;
+            } else if (pid > 0) {
+                running++;
+                i++;
+                continue;
+            }
+            // fall back to rendering it here
+            if (!renderfile(argv[i])) {
+                failed++;
+            }
+            i++;
+            continue;
+        }
+
+        if (wait(&status) > 0) {
+            running--;
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                failed++;
+            }
+        } else {
+            break;
+        }
+    }
+#endif
+
+    printf("%.2fs in total", (ASS_GetTicks() - ticks) / 1000.0);
+    if (failed) {
+        printf(", %d failed", failed);
+    }
+    printf("\n");
+
+    return failed ? 1 : 0;
+}
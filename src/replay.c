@@ -0,0 +1,460 @@
+/*
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+ */
+
+/**
+ * Plays back a journal written by FX_StartJournal
+ *
+ *   replay [-o out.wav] [-t seconds] journal
+ *
+ * The calls in the journal are made again on the NoSound driver, each
+ * once the mixer has produced as many frames as it had when the call
+ * was first made, and mixing is pulled with FX_Render in between. So a
+ * session played in a game can be mixed again offline, under a profiler
+ * or after a change to the mixer, and give the same output. Files
+ * played from disk are read as the mix reaches them rather than by the
+ * filler thread, so they come out the same however fast this runs.
+ * Voice handles, registered sound ids and sound banks are mapped to the
+ * ones made here. The mix can be written to a WAV file, with -t seconds
+ * more after the last call, and the timing of the mixer is printed at
+ * the end along with any calls that came out differently to the
+ * recording.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fx_man.h"
+#include "music.h"
+#include "sndcards.h"
+#include "journal.h"
+#include "tools.h"
+
+#define BLOCKFRAMES 256     // one MultiVoc mix block at a time
+#define MAPSIZE 1024        // a power of two
+
+typedef struct {
+    int valid;
+    int recorded;
+    int replayed;
+} mapping;
+
+static mapping Handles[MAPSIZE];
+static mapping SoundIDs[MAPSIZE];
+static mapping Banks[MAPSIZE];
+
+static char ** Assets;
+static unsigned int * AssetLengths;
+static unsigned int NumAssets;
+
+static FILE * Output;
+static unsigned int OutputBytes;
+static int MixRate, NumChannels, NumBits;
+static int Installed, MusicInstalled;
+
+static ASS_MixStats Stats;
+static double StatsTotal;
+
+
+// Sound banks count from 0, and every failure is negative
+static void remember(mapping * map, int recorded, int replayed)
+{
+    mapping * m = &map[recorded & (MAPSIZE - 1)];
+
+    if (recorded >= 0) {
+        m->valid = replayed >= 0;
+        m->recorded = recorded;
+        m->replayed = replayed;
+    }
+}
+
+// Unknown or long gone ones become -1, which the library refuses
+static int lookup(mapping * map, int recorded)
+{
+    mapping * m = &map[recorded & (MAPSIZE - 1)];
+
+    return (m->valid && m->recorded == recorded) ? m->replayed : -1;
+}
+
+// Keeps the sound data of an asset record, numbered by its result
+static int addasset(const JournalRecord * rec)
+{
+    unsigned int id = (unsigned int) rec->result;
+
+    if (id == 0 || id > NumAssets + 1) {
+        return 0;
+    }
+    if (id > NumAssets) {
+        Assets = (char **) realloc(Assets, (id + 1) * sizeof(char *));
+        AssetLengths = (unsigned int *) realloc(AssetLengths, (id + 1) * sizeof(unsigned int));
+        NumAssets = id;
+    }
+
+    // a copy of its own so 16-bit samples are aligned
+    Assets[id] = (char *) malloc(rec->length ? rec->length : 1);
+    memcpy(Assets[id], rec->string, rec->length);
+    AssetLengths[id] = rec->length;
+    return 1;
+}
+
+static void gatherstats(void)
+{
+    ASS_MixStats s;
+
+    FX_GetStats(&s);
+    if (!s.blocks) {
+        return;
+    }
+
+    StatsTotal += (double) s.avgtime * s.blocks;
+    if (!Stats.blocks || s.mintime < Stats.mintime) {
+        Stats.mintime = s.mintime;
+    }
+    if (s.maxtime > Stats.maxtime) {
+        Stats.maxtime = s.maxtime;
+    }
+    if (s.p99time > Stats.p99time) {
+        Stats.p99time = s.p99time;
+    }
+    if (s.peakvoices > Stats.peakvoices) {
+        Stats.peakvoices = s.peakvoices;
+    }
+    Stats.blocks += s.blocks;
+    Stats.voicesstolen += s.voicesstolen;
+}
+
+static void renderblock(void)
+{
+    short buf[BLOCKFRAMES * 2];
+    int bytes = BLOCKFRAMES * NumChannels * NumBits / 8;
+
+    FX_Render(buf, BLOCKFRAMES, NumChannels, NumBits);
+    if (Output) {
+        fwrite(buf, 1, bytes, Output);
+        OutputBytes += bytes;
+    }
+}
+
+static void startup(const JournalRecord * rec)
+{
+    int voices = rec->args[0], channels = rec->args[1];
+    int bits = rec->args[2], rate = rec->args[3];
+
+    if (FX_Init(ASS_NoSound, voices, &channels, &bits, &rate, 0) != FX_Ok) {
+        fprintf(stderr, "FX_Init failed: %s\n", FX_ErrorString(FX_Error));
+        return;
+    }
+    Installed = 1;
+
+    // the WAV keeps the format of the first session
+    if (!NumBits) {
+        MixRate = rate;
+        NumChannels = channels;
+        NumBits = bits;
+        if (Output) {
+            writewavheader(Output, MixRate, NumChannels, NumBits, 0);
+        }
+    }
+
+    if (!MusicInstalled && MUSIC_Init(ASS_NoSound, 0) == MUSIC_Ok) {
+        MusicInstalled = 1;
+    }
+}
+
+// Makes a recorded call again, returning what it returned this time
+static int replaycall(const JournalRecord * rec)
+{
+    const int * a = rec->args;
+    char * data = 0;
+    unsigned int len = 0;
+    char filename[1024];
+    int result = 0;
+
+    if (rec->asset) {
+        if (rec->asset > NumAssets || !Assets[rec->asset]) {
+            return FX_Error;
+        }
+        data = Assets[rec->asset];
+        len = AssetLengths[rec->asset];
+    }
+    if (rec->string) {
+        len = rec->length < sizeof(filename) - 1 ? rec->length : sizeof(filename) - 1;
+        memcpy(filename, rec->string, len);
+        filename[len] = 0;
+    }
+
+    switch (rec->op) {
+        case JOURNAL_Init:
+            startup(rec);
+            return Installed ? FX_Ok : FX_Error;
+        case JOURNAL_Shutdown:
+            gatherstats();
+            Installed = 0;
+            return FX_Shutdown();
+
+        case JOURNAL_SetVolume:           FX_SetVolume(a[0]); break;
+        case JOURNAL_SetReverseStereo:    FX_SetReverseStereo(a[0]); break;
+        case JOURNAL_SetReverb:           FX_SetReverb(a[0]); break;
+        case JOURNAL_SetFastReverb:       FX_SetFastReverb(a[0]); break;
+        case JOURNAL_SetReverbDelay:      FX_SetReverbDelay(a[0]); break;
+        case JOURNAL_SetSoundResampling:  FX_SetSoundResampling(a[0]); break;
+        case JOURNAL_SetSoundTranscoding: FX_SetSoundTranscoding(a[0]); break;
+        case JOURNAL_SetDefaultResampler: return FX_SetDefaultResampler(a[0]);
+        case JOURNAL_SetMixRateDivisor:   return FX_SetMixRateDivisor(a[0]);
+        case JOURNAL_SetVoiceLOD:         return FX_SetVoiceLOD(a[0], a[1]);
+
+        case JOURNAL_EndLooping:
+            return FX_EndLooping(lookup(Handles, a[0]));
+        case JOURNAL_SetPan:
+            return FX_SetPan(lookup(Handles, a[0]), a[1], a[2], a[3]);
+        case JOURNAL_SetPitch:
+            return FX_SetPitch(lookup(Handles, a[0]), a[1]);
+        case JOURNAL_SetVoiceResampler:
+            return FX_SetVoiceResampler(lookup(Handles, a[0]), a[1]);
+        case JOURNAL_SetFrequency:
+            return FX_SetFrequency(lookup(Handles, a[0]), a[1]);
+        case JOURNAL_SetVorbisPosition:
+            return FX_SetVorbisPosition(lookup(Handles, a[0]), a[1]);
+        case JOURNAL_Pan3D:
+            return FX_Pan3D(lookup(Handles, a[0]), a[1], a[2]);
+        case JOURNAL_StopSound:
+            return FX_StopSound(lookup(Handles, a[0]));
+        case JOURNAL_PauseSound:
+            return FX_PauseSound(lookup(Handles, a[0]), a[1]);
+        case JOURNAL_StopAllSounds:
+            return FX_StopAllSounds();
+
+        case JOURNAL_PlayVOC:
+            result = FX_PlayVOC(data, len, a[0], a[1], a[2], a[3], a[4], a[5]);
+            break;
+        case JOURNAL_PlayLoopedVOC:
+            result = FX_PlayLoopedVOC(data, len, a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]);
+            break;
+        case JOURNAL_PlayWAV:
+            result = FX_PlayWAV(data, len, a[0], a[1], a[2], a[3], a[4], a[5]);
+            break;
+        case JOURNAL_PlayLoopedWAV:
+            result = FX_PlayLoopedWAV(data, len, a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]);
+            break;
+        case JOURNAL_PlayVOC3D:
+            result = FX_PlayVOC3D(data, len, a[0], a[1], a[2], a[3], a[4]);
+            break;
+        case JOURNAL_PlayWAV3D:
+            result = FX_PlayWAV3D(data, len, a[0], a[1], a[2], a[3], a[4]);
+            break;
+        case JOURNAL_PlayAuto:
+            result = FX_PlayAuto(data, len, a[0], a[1], a[2], a[3], a[4], a[5]);
+            break;
+        case JOURNAL_PlayLoopedAuto:
+            result = FX_PlayLoopedAuto(data, len, a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]);
+            break;
+        case JOURNAL_PlayAuto3D:
+            result = FX_PlayAuto3D(data, len, a[0], a[1], a[2], a[3], a[4]);
+            break;
+        case JOURNAL_PlayLoopedVorbisFrom:
+            result = FX_PlayLoopedVorbisFrom(data, len, a[0], a[1], a[2], a[3], a[4], a[5],
+                                             a[6], a[7], a[8]);
+            break;
+        case JOURNAL_PlayRaw:
+            result = FX_PlayRaw(data, len, a[0], a[1], a[2], a[3], a[4], a[5], a[6]);
+            break;
+        case JOURNAL_PlayLoopedRaw:
+            result = FX_PlayLoopedRaw(data, len, data + a[0], data + a[1], a[2], a[3], a[4],
+                                      a[5], a[6], a[7], a[8]);
+            break;
+        case JOURNAL_PlayFile:
+            result = FX_PlayFile(filename, a[0], a[1], a[2], a[3], a[4], a[5]);
+            break;
+        case JOURNAL_PlayLoopedFile:
+            result = FX_PlayLoopedFile(filename, a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]);
+            break;
+
+        case JOURNAL_OpenSoundBank:
+            result = FX_OpenSoundBank(filename);
+            remember(Banks, rec->result, result);
+            return result;
+        case JOURNAL_CloseSoundBank:
+            return FX_CloseSoundBank(lookup(Banks, a[0]));
+        case JOURNAL_PlayBankSound:
+            result = FX_PlayBankSound(lookup(Banks, a[0]), a[1], a[2], a[3], a[4], a[5],
+                                      a[6], a[7]);
+            break;
+        case JOURNAL_PlayLoopedBankSound:
+            result = FX_PlayLoopedBankSound(lookup(Banks, a[0]), a[1], a[2], a[3], a[4], a[5],
+                                            a[6], a[7]);
+            break;
+        case JOURNAL_PlayBankSound3D:
+            result = FX_PlayBankSound3D(lookup(Banks, a[0]), a[1], a[2], a[3], a[4], a[5], a[6]);
+            break;
+
+        case JOURNAL_RegisterSound:
+            result = FX_RegisterSound(data, len);
+            remember(SoundIDs, rec->result, result);
+            return result;
+        case JOURNAL_UnregisterSound:
+            return FX_UnregisterSound(lookup(SoundIDs, a[0]));
+        case JOURNAL_PlayID:
+            result = FX_PlayID(lookup(SoundIDs, a[0]), a[1], a[2], a[3], a[4], a[5], a[6]);
+            break;
+        case JOURNAL_PlayLoopedID:
+            result = FX_PlayLoopedID(lookup(SoundIDs, a[0]), a[1], a[2], a[3], a[4], a[5],
+                                     a[6], a[7], a[8]);
+            break;
+        case JOURNAL_PlayID3D:
+            result = FX_PlayID3D(lookup(SoundIDs, a[0]), a[1], a[2], a[3], a[4], a[5]);
+            break;
+
+        case JOURNAL_MusicPlaySong:
+            return MUSIC_PlaySong(data, len, a[0]);
+        case JOURNAL_MusicStopSong:          return MUSIC_StopSong();
+        case JOURNAL_MusicPause:             MUSIC_Pause(); break;
+        case JOURNAL_MusicContinue:          MUSIC_Continue(); break;
+        case JOURNAL_MusicSetVolume:         MUSIC_SetVolume(a[0]); break;
+        case JOURNAL_MusicSetLoopFlag:       MUSIC_SetLoopFlag(a[0]); break;
+        case JOURNAL_MusicSetContext:        MUSIC_SetContext(a[0]); break;
+        case JOURNAL_MusicSetSongTick:       MUSIC_SetSongTick(a[0]); break;
+        case JOURNAL_MusicSetSongTime:       MUSIC_SetSongTime(a[0]); break;
+        case JOURNAL_MusicSetSongPosition:   MUSIC_SetSongPosition(a[0], a[1], a[2]); break;
+        case JOURNAL_MusicSetChannelVolume:  MUSIC_SetMidiChannelVolume(a[0], a[1]); break;
+        case JOURNAL_MusicResetChannelVolumes: MUSIC_ResetMidiChannelVolumes(); break;
+
+        default:
+            return rec->result;
+    }
+
+    // a voice was started
+    if (rec->op >= JOURNAL_PlayVOC && rec->op <= JOURNAL_PlayID3D) {
+        remember(Handles, rec->result, result);
+    }
+    return result;
+}
+
+int main(int argc, char ** argv)
+{
+    const char * journal = 0, * outfile = 0;
+    const unsigned char * p, * end;
+    unsigned char * data;
+    unsigned int length, target = 0, base = 0;
+    double tail = 0;
+    int i, result, calls = 0, differed = 0, started = 0;
+    JournalRecord rec;
+    clock_t start;
+    double cpu;
+
+    for (i = 1; i < argc; i++) {
+        if (i + 1 < argc && !strcmp(argv[i], "-o")) {
+            outfile = argv[++i];
+        } else if (i + 1 < argc && !strcmp(argv[i], "-t")) {
+            tail = atof(argv[++i]);
+        } else if (argv[i][0] != '-' && !journal) {
+            journal = argv[i];
+        } else {
+            journal = 0;
+            break;
+        }
+    }
+
+    if (!journal) {
+        fprintf(stderr, "usage: %s [-o out.wav] [-t seconds] journal\n", argv[0]);
+        return 1;
+    }
+
+    data = (unsigned char *) loadfile(journal, &length);
+    if (!data) {
+        fprintf(stderr, "%s: could not read\n", journal);
+        return 1;
+    }
+    end = data + length;
+
+    p = JOURNAL_ReadHeader(data, end);
+    if (!p) {
+        fprintf(stderr, "%s: not a journal this version can read\n", journal);
+        return 1;
+    }
+
+    if (outfile) {
+        Output = fopen(outfile, "wb");
+        if (!Output) {
+            fprintf(stderr, "%s: could not create\n", outfile);
+            return 1;
+        }
+    }
+
+    start = clock();
+
+    while ((p = JOURNAL_Read(p, end, &rec)) != 0) {
+        if (rec.op == JOURNAL_Asset) {
+            if (!addasset(&rec)) {
+                fprintf(stderr, "%s: sound data out of order\n", journal);
+                return 1;
+            }
+            continue;
+        }
+
+        // catch the mixer up to where it was when the call was made
+        target += rec.frame;
+        if (!started) {
+            base = FX_GetMixedFrames() - target;
+            started = 1;
+        }
+        while (Installed && (int) (target - (FX_GetMixedFrames() - base)) > 0) {
+            renderblock();
+        }
+
+        result = replaycall(&rec);
+        calls++;
+        if ((result < 0) != (rec.result < 0)) {
+            printf("call %d (op %d) returned %d, was recorded as %d\n",
+                   calls, rec.op, result, rec.result);
+            differed++;
+        }
+    }
+
+    for (i = 0; Installed && i < (int) (tail * MixRate / BLOCKFRAMES); i++) {
+        renderblock();
+    }
+
+    cpu = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+    if (Installed) {
+        gatherstats();
+        FX_Shutdown();
+    }
+    if (MusicInstalled) {
+        MUSIC_Shutdown();
+    }
+
+    if (Output) {
+        writewavheader(Output, MixRate, NumChannels, NumBits, OutputBytes);
+        fclose(Output);
+    }
+
+    printf("%d calls replayed, %d came out differently\n", calls, differed);
+    if (Stats.blocks && MixRate) {
+        printf("%u blocks mixed, %.2f s of audio in %.3f s, %.1fx real time\n",
+               Stats.blocks, (double) Stats.blocks * BLOCKFRAMES / MixRate, cpu,
+               cpu > 0 ? (double) Stats.blocks * BLOCKFRAMES / MixRate / cpu : 0);
+        printf("per block: min %u us, avg %.1f us, p99 %u us, max %u us\n",
+               Stats.mintime, StatsTotal / Stats.blocks, Stats.p99time, Stats.maxtime);
+        printf("most voices at once %d, voices stolen %u\n",
+               Stats.peakvoices, Stats.voicesstolen);
+    }
+
+    return differed ? 2 : 0;
+}
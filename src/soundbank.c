@@ -0,0 +1,347 @@
+/*
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+ */
+
+/**
+ * Memory-mapped sound banks for MultiVoc
+ *
+ * The entry table is checked once when the bank is opened. Playing
+ * an entry then hands the mapped sample data straight to a voice.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "asssys.h"
+#include "soundbank.h"
+#include "multivoc.h"
+#include "_multivc.h"
+
+#define min(x,y) ((x) < (y) ? (x) : (y))
+#define max(x,y) ((x) > (y) ? (x) : (y))
+
+#define MaxSoundBanks 16
+
+typedef struct {
+   char * data;
+   unsigned int length;
+   int loopstart;
+   int loopend;
+   unsigned int rate;
+   int bits;
+   int channels;
+} soundbank_entry;
+
+typedef struct {
+   ASS_MappedFile * file;
+   const char * base;
+   size_t size;
+   int numentries;
+   soundbank_entry * entries;
+} soundbank;
+
+static soundbank SoundBanks[ MaxSoundBanks ];
+
+
+static soundbank_entry * MV_GetBankEntry(int bank, int entry)
+{
+   if (bank < 0 || bank >= MaxSoundBanks || !SoundBanks[bank].file ||
+       entry < 0 || entry >= SoundBanks[bank].numentries) {
+      return 0;
+   }
+
+   return &SoundBanks[bank].entries[entry];
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_OpenSoundBank
+
+Maps a sound bank file and checks its entry table. Returns a bank
+number for the other sound bank functions.
+---------------------------------------------------------------------*/
+
+int MV_OpenSoundBank
+(
+ const char *filename
+ )
+
+{
+   soundbank * sb = 0;
+   soundbank_entry * e;
+   const unsigned char * p;
+   const void * data;
+   size_t size;
+   unsigned int offset, loopstart, loopend, framesize;
+   int bank, i;
+
+   for (bank = 0; bank < MaxSoundBanks; bank++) {
+      if (!SoundBanks[bank].file) {
+         sb = &SoundBanks[bank];
+         break;
+      }
+   }
+   if (!sb) {
+      MV_SetErrorCode( MV_NoMem );
+      return( MV_Error );
+   }
+
+   memset(sb, 0, sizeof(soundbank));
+
+   sb->file = ASS_MapFile(filename, &data, &size);
+   if (!sb->file) {
+      MV_SetErrorCode( MV_FileError );
+      return( MV_Error );
+   }
+   sb->base = (const char *) data;
+   sb->size = size;
+
+   p = (const unsigned char *) sb->base;
+   if (size < SOUNDBANK_HEADER_SIZE ||
+       memcmp(p, SOUNDBANK_MAGIC, 4) != 0 ||
+       read_le32(p + 4) != SOUNDBANK_VERSION) {
+      goto invalid;
+   }
+
+   sb->numentries = read_le32(p + 8);
+   if (sb->numentries < 0 ||
+       (size - SOUNDBANK_HEADER_SIZE) / SOUNDBANK_ENTRY_SIZE < (size_t) sb->numentries) {
+      goto invalid;
+   }
+
+   sb->entries = (soundbank_entry *) ASS_Alloc(ASS_MemStreams,
+                                              max(1, sb->numentries) * sizeof(soundbank_entry));
+   if (!sb->entries) {
+      ASS_UnmapFile(sb->file);
+      sb->file = 0;
+      MV_SetErrorCode( MV_NoMem );
+      return( MV_Error );
+   }
+
+   for (i = 0; i < sb->numentries; i++) {
+      p = (const unsigned char *) sb->base + SOUNDBANK_HEADER_SIZE + i * SOUNDBANK_ENTRY_SIZE;
+      e = &sb->entries[i];
+
+      offset      = read_le32(p + SOUNDBANK_OFFSET);
+      e->length   = read_le32(p + SOUNDBANK_LENGTH);
+      e->rate     = read_le32(p + SOUNDBANK_RATE);
+      loopstart   = read_le32(p + SOUNDBANK_LOOPSTART);
+      loopend     = read_le32(p + SOUNDBANK_LOOPEND);
+      e->bits     = p[SOUNDBANK_BITS];
+      e->channels = p[SOUNDBANK_CHANNELS];
+
+      if ((e->bits != 8 && e->bits != 16) ||
+          (e->channels != 1 && e->channels != 2) ||
+          e->rate == 0 || e->length > 0x7fffffff ||
+          offset % SOUNDBANK_ALIGN != 0 || offset > size) {
+         goto invalid;
+      }
+
+      framesize = e->channels * e->bits / 8;
+      if ((size - offset) / framesize < e->length) {
+         goto invalid;
+      }
+      e->data = (char *) sb->base + offset;
+
+      if (loopstart == SOUNDBANK_NOLOOP || loopstart >= e->length) {
+         e->loopstart = -1;
+         e->loopend   = 0;
+      } else {
+         e->loopstart = loopstart;
+         e->loopend   = (loopend > loopstart && loopend <= e->length) ? (int) loopend : (int) e->length;
+      }
+   }
+
+   return bank;
+
+invalid:
+   ASS_Free(sb->entries);
+   sb->entries = 0;
+   ASS_UnmapFile(sb->file);
+   sb->file = 0;
+   MV_SetErrorCode( MV_InvalidBank );
+   return( MV_Error );
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_CloseSoundBank
+
+Stops any voices playing from the bank and unmaps it.
+---------------------------------------------------------------------*/
+
+int MV_CloseSoundBank
+(
+ int bank
+ )
+
+{
+   soundbank * sb;
+
+   if (bank < 0 || bank >= MaxSoundBanks || !SoundBanks[bank].file) {
+      MV_SetErrorCode( MV_InvalidBank );
+      return( MV_Error );
+   }
+
+   sb = &SoundBanks[bank];
+
+   MV_KillVoicesInRange(sb->base, sb->base + sb->size);
+
+   ASS_Free(sb->entries);
+   ASS_UnmapFile(sb->file);
+   memset(sb, 0, sizeof(soundbank));
+
+   return( MV_Ok );
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_SoundBankEntries
+
+Returns the number of sounds in the bank.
+---------------------------------------------------------------------*/
+
+int MV_SoundBankEntries
+(
+ int bank
+ )
+
+{
+   if (bank < 0 || bank >= MaxSoundBanks || !SoundBanks[bank].file) {
+      MV_SetErrorCode( MV_InvalidBank );
+      return( MV_Error );
+   }
+
+   return SoundBanks[bank].numentries;
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_PlayBankSound
+
+Begin playback of a sound bank entry, once through.
+---------------------------------------------------------------------*/
+
+int MV_PlayBankSound
+(
+ int   bank,
+ int   entry,
+ int   pitchoffset,
+ int   vol,
+ int   left,
+ int   right,
+ int   priority,
+ unsigned int callbackval
+ )
+
+{
+   soundbank_entry * e;
+
+   e = MV_GetBankEntry(bank, entry);
+   if (!e) {
+      MV_SetErrorCode( MV_InvalidBank );
+      return( MV_Error );
+   }
+
+   return MV_PlayLoopedPCM(e->data, e->length, -1, 0, e->rate, e->bits, e->channels,
+                           pitchoffset, vol, left, right, priority, callbackval);
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_PlayLoopedBankSound
+
+Begin playback of a sound bank entry, repeating its loop. An entry
+without loop points repeats in whole.
+---------------------------------------------------------------------*/
+
+int MV_PlayLoopedBankSound
+(
+ int   bank,
+ int   entry,
+ int   pitchoffset,
+ int   vol,
+ int   left,
+ int   right,
+ int   priority,
+ unsigned int callbackval
+ )
+
+{
+   soundbank_entry * e;
+
+   e = MV_GetBankEntry(bank, entry);
+   if (!e) {
+      MV_SetErrorCode( MV_InvalidBank );
+      return( MV_Error );
+   }
+
+   return MV_PlayLoopedPCM(e->data, e->length, max(0, e->loopstart), e->loopend,
+                           e->rate, e->bits, e->channels,
+                           pitchoffset, vol, left, right, priority, callbackval);
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_PlayBankSound3D
+
+Begin playback of a sound bank entry with 3D angle and distance
+attenuation.
+---------------------------------------------------------------------*/
+
+int MV_PlayBankSound3D
+(
+ int   bank,
+ int   entry,
+ int   pitchoffset,
+ int   angle,
+ int   distance,
+ int   priority,
+ unsigned int callbackval
+ )
+
+{
+   int left;
+   int right;
+   int mid;
+   int volume;
+
+   if ( !MV_Installed )
+   {
+      MV_SetErrorCode( MV_NotInstalled );
+      return( MV_Error );
+   }
+
+   if ( distance < 0 )
+   {
+      distance  = -distance;
+      angle    += MV_NumPanPositions / 2;
+   }
+
+   volume = MIX_VOLUME( distance );
+
+   // Ensure angle is within 0 - 31
+   angle &= MV_MaxPanPosition;
+
+   left  = MV_PanTable[ angle ][ volume ].left;
+   right = MV_PanTable[ angle ][ volume ].right;
+   mid   = max( 0, 255 - distance );
+
+   return MV_PlayBankSound( bank, entry, pitchoffset, mid, left, right, priority,
+                            callbackval );
+}
+
+// vim:ts=3:expandtab:
@@ -0,0 +1,52 @@
+/*
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+ */
+
+/**
+ * Sound bank file layout, shared by the loader and mkbank
+ *
+ * All fields are little-endian.
+ *
+ *   header   16 bytes   magic "JFSB", version, entry count, reserved
+ *   entries  32 bytes each, directly after the header
+ *   data     sample data, each entry aligned to SOUNDBANK_ALIGN
+ *
+ * Sample data is stored ready to mix: 8-bit unsigned or 16-bit
+ * signed, mono or interleaved stereo.
+ */
+
+#ifndef __SOUNDBANK_H
+#define __SOUNDBANK_H
+
+#define SOUNDBANK_MAGIC       "JFSB"
+#define SOUNDBANK_VERSION     1
+#define SOUNDBANK_HEADER_SIZE 16
+#define SOUNDBANK_ENTRY_SIZE  32
+#define SOUNDBANK_ALIGN       4
+#define SOUNDBANK_NOLOOP      0xffffffff
+
+// Byte offsets of the fields within an entry
+#define SOUNDBANK_OFFSET      0     // u32 file offset of the sample data
+#define SOUNDBANK_LENGTH      4     // u32 length in sample frames
+#define SOUNDBANK_RATE        8     // u32 sampling rate
+#define SOUNDBANK_LOOPSTART   12    // u32 first frame of the loop, or SOUNDBANK_NOLOOP
+#define SOUNDBANK_LOOPEND     16    // u32 frame after the loop, or 0 for the end
+#define SOUNDBANK_BITS        20    // u8  8 or 16
+#define SOUNDBANK_CHANNELS    21    // u8  1 or 2
+                                    // 22..31 reserved, zero
+
+#endif
@@ -0,0 +1,995 @@
+/*
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+ */
+
+/**
+ * Registered sounds for MultiVoc
+ *
+ * A sound is checked and its headers parsed once, when registered.
+ * WAV and VOC data become a list of PCM blocks that a voice walks
+ * directly. Playing by ID then only has to set up the voice.
+ *
+ * With transcoding switched on, large PCM sounds are encoded to IMA
+ * ADPCM as they are registered, trading a little mixing time for a
+ * quarter of the memory of 16-bit data. With resampling switched on,
+ * PCM sounds are converted to 16-bit at the mixing rate instead, so
+ * their voices step through the data one frame at a time.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "asssys.h"
+#include "pitch.h"
+#include "multivoc.h"
+#include "_multivc.h"
+
+#define min(x,y) ((x) < (y) ? (x) : (y))
+#define max(x,y) ((x) > (y) ? (x) : (y))
+
+#ifdef __POWERPC__
+# define BIGENDIAN
+#endif
+
+enum {
+   SoundFree,
+   SoundPCM,
+   SoundADPCM,
+   SoundVOC,
+   SoundVorbis
+};
+
+typedef struct {
+   char * data;
+   unsigned int frames;
+   unsigned int rate;
+   int bits;
+   int channels;
+} sound_block;
+
+typedef struct {
+   int format;
+   char * ptr;
+   unsigned int length;
+   int numblocks;
+   sound_block * blocks;
+   DecodeState * adpcm;
+   int transcoded;         // adpcm->data is ours, ptr is not used
+   unsigned int saved;     // bytes saved by transcoding
+   char * converted;       // resampled copy, ptr is not used
+   unsigned int convertedsize;
+   unsigned int srcrate;   // rate loop points are given at, if resampled
+   unsigned int dstrate;
+} registered_sound;
+
+static registered_sound * Sounds = 0;
+static int NumSounds = 0;
+
+static unsigned int TranscodeThreshold = 0;
+static unsigned int TranscodeSavings = 0;
+
+static unsigned int ResampleLimit = 0;
+static unsigned int ResampledMemory = 0;
+
+
+static registered_sound * MV_GetSound(int id)
+{
+   if (id < 1 || id > NumSounds || Sounds[id - 1].format == SoundFree) {
+      return 0;
+   }
+
+   return &Sounds[id - 1];
+}
+
+
+static int MV_AddSoundBlock(registered_sound * snd, char * data, unsigned int bytes,
+                            unsigned int rate, int bits, int channels)
+{
+   sound_block * block;
+   unsigned int frames;
+
+   frames = bytes / (channels * bits / 8);
+   if (frames == 0 || rate == 0) {
+      return 1;
+   }
+
+   if ((snd->numblocks & (snd->numblocks - 1)) == 0) {
+      // Grow at powers of two
+      block = (sound_block *) ASS_Realloc(ASS_MemSounds, snd->blocks,
+                                          max(1, 2 * snd->numblocks) * sizeof(sound_block));
+      if (!block) {
+         return 0;
+      }
+      snd->blocks = block;
+   }
+
+   block = &snd->blocks[snd->numblocks++];
+   block->data = data;
+   block->frames = frames;
+   block->rate = rate;
+   block->bits = bits;
+   block->channels = channels;
+
+   return 1;
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_ParseWAV
+
+Finds the format and sample data of a PCM WAV file. ADPCM files
+keep a decoder template instead.
+---------------------------------------------------------------------*/
+
+static int MV_ParseWAV
+(
+ registered_sound * snd
+ )
+
+{
+   const unsigned char * p = (const unsigned char *) snd->ptr;
+   unsigned int pos = 12;
+   unsigned int chunklength;
+   unsigned int rate = 0;
+   int bits = 0;
+   int channels = 0;
+
+   while (pos + 8 <= snd->length) {
+      chunklength = min(read_le32(p + pos + 4), snd->length - pos - 8);
+
+      if (!memcmp(p + pos, "fmt ", 4)) {
+         if (chunklength >= 16 && (read_le16(p + pos + 8) == WAVE_FORMAT_ADPCM ||
+                                   read_le16(p + pos + 8) == WAVE_FORMAT_IMA_ADPCM)) {
+            snd->adpcm = (DecodeState *) ASS_Alloc(ASS_MemSounds, sizeof(DecodeState));
+            if (!snd->adpcm) {
+               return MV_NoMem;
+            }
+            return MV_ParseADPCMWAV(snd->ptr, snd->length, snd->adpcm);
+         }
+         if (chunklength < 16 || read_le16(p + pos + 8) != 1) {
+            return MV_InvalidWAVFile;
+         }
+         channels = read_le16(p + pos + 10);
+         rate     = read_le32(p + pos + 12);
+         bits     = read_le16(p + pos + 22);
+      } else if (!memcmp(p + pos, "data", 4)) {
+         if ((bits != 8 && bits != 16) || (channels != 1 && channels != 2)) {
+            return MV_InvalidWAVFile;
+         }
+         if (!MV_AddSoundBlock(snd, snd->ptr + pos + 8, chunklength, rate, bits, channels)) {
+            return MV_NoMem;
+         }
+         return snd->numblocks ? MV_Ok : MV_InvalidWAVFile;
+      }
+
+      pos += 8 + chunklength + (chunklength & 1);
+   }
+
+   return MV_InvalidWAVFile;
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_ParseVOC
+
+Builds the list of sound data blocks of a VOC file, unrolling any
+counted repeats. Silence is skipped, as it is when MV_PlayVOC walks
+the file. An endless repeat plays once. A file holding compressed
+data is left for MV_PlayVOC to decode as it plays.
+---------------------------------------------------------------------*/
+
+static int MV_ParseVOC
+(
+ registered_sound * snd
+ )
+
+{
+   const unsigned char * p = (const unsigned char *) snd->ptr;
+   unsigned int pos;
+   unsigned int blocklength;
+   unsigned int tc = 0;
+   unsigned int packtype = 0;
+   unsigned int voicemode = 0;
+   unsigned int rate;
+   int bits = 0;
+   int channels = 0;
+   int blocktype;
+   int lastblocktype = 0;
+   int repeatblock = -1;
+   unsigned int repeatcount = 0;
+   int count, i;
+
+   pos = read_le16(p + 20);
+
+   while (pos + 4 <= snd->length && p[pos] != 0) {
+      blocktype = p[pos];
+      blocklength = min(p[pos + 1] | (p[pos + 2] << 8) | (p[pos + 3] << 16),
+                        snd->length - pos - 4);
+      pos += 4;
+
+      switch (blocktype) {
+         case 1:
+            // Sound data block
+            if (blocklength < 2) {
+               break;
+            }
+            if (lastblocktype != 8) {
+               tc = p[pos] << 8;
+               packtype = p[pos + 1];
+               voicemode = 0;
+            }
+            if (packtype != 0 && packtype <= 3 && voicemode == 0) {
+               snd->format = SoundVOC;
+               return MV_Ok;
+            }
+            if (packtype != 0 || voicemode > 1) {
+               // Continuation blocks of packed data are skipped too
+               bits = 0;
+               break;
+            }
+
+            bits = 8;
+            channels = voicemode + 1;
+            rate = 256000000L / (channels * (65536 - tc));
+            if (!MV_AddSoundBlock(snd, snd->ptr + pos + 2, blocklength - 2, rate, bits, channels)) {
+               return MV_NoMem;
+            }
+            break;
+
+         case 2:
+            // Sound continuation block
+            if (bits && snd->numblocks > 0) {
+               rate = snd->blocks[snd->numblocks - 1].rate;
+               if (!MV_AddSoundBlock(snd, snd->ptr + pos, blocklength, rate, bits, channels)) {
+                  return MV_NoMem;
+               }
+            }
+            break;
+
+         case 6:
+            // Repeat begin
+            if (blocklength >= 2) {
+               repeatcount = read_le16(p + pos);
+               repeatblock = snd->numblocks;
+            }
+            break;
+
+         case 7:
+            // Repeat end
+            if (repeatblock >= 0 && repeatcount < 0xffff) {
+               count = snd->numblocks - repeatblock;
+               while (repeatcount-- > 0) {
+                  for (i = 0; i < count; i++) {
+                     sound_block block = snd->blocks[repeatblock + i];
+                     if (!MV_AddSoundBlock(snd, block.data, block.frames * block.channels * block.bits / 8,
+                                           block.rate, block.bits, block.channels)) {
+                        return MV_NoMem;
+                     }
+                  }
+               }
+            }
+            repeatblock = -1;
+            break;
+
+         case 8:
+            // Extended block
+            if (blocklength >= 4) {
+               tc = read_le16(p + pos);
+               packtype = p[pos + 2];
+               voicemode = p[pos + 3];
+            }
+            break;
+
+         case 9:
+            // New sound data block
+            if (blocklength < 12) {
+               break;
+            }
+            switch (read_le16(p + pos + 6)) {
+               case VOC_CT4_ADPCM:
+               case VOC_CT3_ADPCM:
+               case VOC_CT2_ADPCM:
+               case VOC_ALAW:
+               case VOC_MULAW:
+               case VOC_CREATIVE_ADPCM:
+                  snd->format = SoundVOC;
+                  return MV_Ok;
+            }
+            if (!((p[pos + 4] == 8 && read_le16(p + pos + 6) == VOC_8BIT) ||
+                  (p[pos + 4] == 16 && read_le16(p + pos + 6) == VOC_16BIT)) ||
+                (p[pos + 5] != 1 && p[pos + 5] != 2)) {
+               bits = 0;
+               break;
+            }
+
+            bits = p[pos + 4];
+            channels = p[pos + 5];
+            if (!MV_AddSoundBlock(snd, snd->ptr + pos + 12, blocklength - 12,
+                                  read_le32(p + pos), bits, channels)) {
+               return MV_NoMem;
+            }
+            break;
+
+         case 3:
+            // Silence
+         case 4:
+            // Marker
+         case 5:
+            // ASCII string
+            break;
+
+         default:
+            // Unknown data.  Probably not a VOC file.
+            return snd->numblocks ? MV_Ok : MV_InvalidVOCFile;
+      }
+
+      lastblocktype = blocktype;
+      pos += blocklength;
+   }
+
+   return snd->numblocks ? MV_Ok : MV_InvalidVOCFile;
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_GetNextSoundBlock
+
+Plays through the block list of a registered sound.
+---------------------------------------------------------------------*/
+
+static playbackstatus MV_GetNextSoundBlock
+(
+ VoiceNode *voice
+ )
+
+{
+   sound_block * block;
+
+   voice->position -= voice->length;
+
+   block = (sound_block *) voice->NextBlock;
+   if (block == (sound_block *) voice->LoopEnd) {
+      if (voice->LoopStart == NULL) {
+         voice->Playing = FALSE;
+         return( NoMoreData );
+      }
+      block = (sound_block *) voice->LoopStart;
+   }
+
+   voice->NextBlock = (char *) (block + 1);
+   voice->sound     = block->data;
+   voice->length    = (uint64_t) block->frames << 32;
+
+   if (block->rate != voice->SamplingRate) {
+      voice->SamplingRate = block->rate;
+      voice->RateScale    = RATE_SCALE( voice->SamplingRate, voice->PitchScale );
+   }
+
+   if (block->bits != voice->bits || block->channels != voice->channels) {
+      voice->bits     = block->bits;
+      voice->channels = block->channels;
+      MV_SetVoiceMixMode( voice );
+   }
+
+   return( KeepPlaying );
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_TranscodeSound
+
+Encodes a single-block PCM sound to IMA ADPCM. The sound is left as
+it was if there is not the memory to encode it.
+---------------------------------------------------------------------*/
+
+static void MV_TranscodeSound
+(
+ registered_sound * snd
+ )
+
+{
+   sound_block * block = &snd->blocks[0];
+   DecodeState * adpcm;
+   unsigned int bytes, encoded;
+
+   bytes = block->frames * block->channels * block->bits / 8;
+   adpcm = (DecodeState *) ASS_Alloc(ASS_MemSounds, sizeof(DecodeState));
+   if (!adpcm) {
+      return;
+   }
+
+   if (MV_EncodeADPCM(block->data, block->frames, block->rate, block->bits,
+                      block->channels, adpcm) != MV_Ok) {
+      ASS_Free(adpcm);
+      return;
+   }
+
+   encoded = adpcm->numblocks * adpcm->blockalign;
+
+   ASS_Free(snd->blocks);
+   snd->blocks = 0;
+   snd->numblocks = 0;
+
+   // A resampled copy is not needed once encoded
+   if (snd->converted) {
+      ASS_Free(snd->converted);
+      ResampledMemory -= snd->convertedsize;
+      snd->converted = 0;
+      snd->convertedsize = 0;
+   }
+
+   snd->adpcm = adpcm;
+   snd->transcoded = 1;
+   snd->saved = bytes > encoded ? bytes - encoded : 0;
+
+   TranscodeSavings += snd->saved;
+}
+
+
+static inline int MV_BlockSample(const sound_block * block, int frame, int ch)
+{
+   const unsigned char * p;
+
+   frame = max(0, min((int) block->frames - 1, frame));
+
+   if (block->bits == 8) {
+      return (((const unsigned char *) block->data)[frame * block->channels + ch] - 128) << 8;
+   }
+
+   p = (const unsigned char *) block->data + (frame * block->channels + ch) * 2;
+   return (short) (p[0] | (p[1] << 8));
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_ResampleSound
+
+Converts the blocks of a PCM sound to one run of 16-bit data at the
+mixing rate, using cubic interpolation. The sound is left as it was
+if its blocks differ in channel count, it is already at the mixing
+rate, or the copy would be larger than the limit.
+---------------------------------------------------------------------*/
+
+static void MV_ResampleSound
+(
+ registered_sound * snd
+ )
+
+{
+   sound_block * block;
+   unsigned int frames = 0;
+   unsigned int blockframes;
+   unsigned int size;
+   unsigned int i, j;
+   int channels = snd->blocks[0].channels;
+   int ch, n, changed = 0;
+   short * out;
+   double pos, step, t;
+   int p0, p1, p2, p3, y;
+
+   if (MV_MixRate <= 0) {
+      return;
+   }
+
+   for (i = 0; i < (unsigned int) snd->numblocks; i++) {
+      block = &snd->blocks[i];
+      if (block->channels != channels) {
+         return;
+      }
+      if (block->rate != (unsigned int) MV_MixRate) {
+         changed = 1;
+      }
+      frames += (unsigned int) ((double) block->frames * MV_MixRate / block->rate);
+   }
+
+   size = frames * channels * 2;
+   if (!changed || frames == 0 || size > ResampleLimit) {
+      return;
+   }
+
+   snd->converted = (char *) ASS_Alloc(ASS_MemSounds, size);
+   if (!snd->converted) {
+      return;
+   }
+
+   out = (short *) snd->converted;
+   for (i = 0; i < (unsigned int) snd->numblocks; i++) {
+      block = &snd->blocks[i];
+      blockframes = (unsigned int) ((double) block->frames * MV_MixRate / block->rate);
+      step = (double) block->rate / MV_MixRate;
+
+      for (j = 0, pos = 0; j < blockframes; j++, pos += step) {
+         n = (int) pos;
+         t = pos - n;
+         for (ch = 0; ch < channels; ch++) {
+            p0 = MV_BlockSample(block, n - 1, ch);
+            p1 = MV_BlockSample(block, n, ch);
+            p2 = MV_BlockSample(block, n + 1, ch);
+            p3 = MV_BlockSample(block, n + 2, ch);
+
+            // Catmull-Rom spline through the four neighbours
+            y = p1 + (int) (0.5 * t * (p2 - p0 + t * (2 * p0 - 5 * p1 + 4 * p2 - p3 +
+                                                    t * (3 * (p1 - p2) + p3 - p0))));
+            y = max(-32768, min(32767, y));
+#ifdef BIGENDIAN
+            y = ((y & 255) << 8) | ((y >> 8) & 255);
+#endif
+            *out++ = (short) y;
+         }
+      }
+   }
+
+   snd->srcrate = snd->blocks[0].rate;
+   snd->dstrate = MV_MixRate;
+   snd->convertedsize = size;
+   ResampledMemory += size;
+
+   snd->numblocks = 1;
+   block = &snd->blocks[0];
+   block->data = snd->converted;
+   block->frames = frames;
+   block->rate = MV_MixRate;
+   block->bits = 16;
+   block->channels = channels;
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_SetSoundResampling
+
+Sets the most memory in bytes a sound's converted copy may take when
+PCM sounds are resampled to the mixing rate as they are registered.
+Zero, the default, turns resampling off and leaves voices to step
+through the data at its own rate. Sounds already registered, and
+those registered before MV_Init, are not affected.
+---------------------------------------------------------------------*/
+
+void MV_SetSoundResampling
+(
+ unsigned int maxbytes
+ )
+
+{
+   ResampleLimit = maxbytes;
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_GetResampledMemory
+
+Returns the number of bytes held by resampled copies of the sounds
+registered now.
+---------------------------------------------------------------------*/
+
+unsigned int MV_GetResampledMemory
+(
+ void
+ )
+
+{
+   return ResampledMemory;
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_SetSoundTranscoding
+
+Sets the size in bytes above which PCM sounds are encoded to ADPCM as
+they are registered. Zero, the default, turns transcoding off.
+Sounds already registered are not affected.
+---------------------------------------------------------------------*/
+
+void MV_SetSoundTranscoding
+(
+ unsigned int threshold
+ )
+
+{
+   TranscodeThreshold = threshold;
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_SoundIsTranscoded
+
+Returns TRUE if a registered sound was resampled or encoded to ADPCM,
+in which case the memory it was registered from is no longer used and
+may be freed.
+---------------------------------------------------------------------*/
+
+int MV_SoundIsTranscoded
+(
+ int id
+ )
+
+{
+   registered_sound * snd;
+
+   snd = MV_GetSound(id);
+   return snd != 0 && (snd->transcoded || snd->converted);
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_GetTranscodeSavings
+
+Returns the number of bytes transcoding saves across the sounds
+registered now.
+---------------------------------------------------------------------*/
+
+unsigned int MV_GetTranscodeSavings
+(
+ void
+ )
+
+{
+   return TranscodeSavings;
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_RegisterSound
+
+Checks a WAV, VOC or OggVorbis sound held in memory and parses its
+headers ahead of play. The memory must stay valid until the sound is
+unregistered, unless MV_SoundIsTranscoded says otherwise. Returns an
+ID for MV_PlayID.
+---------------------------------------------------------------------*/
+
+int MV_RegisterSound
+(
+ char *ptr,
+ unsigned int length
+ )
+
+{
+   registered_sound * snd;
+   int status;
+   int id;
+
+   for (id = 0; id < NumSounds; id++) {
+      if (Sounds[id].format == SoundFree) {
+         break;
+      }
+   }
+
+   if (id == NumSounds) {
+      snd = (registered_sound *) ASS_Realloc(ASS_MemSounds, Sounds,
+                                             max(16, 2 * NumSounds) * sizeof(registered_sound));
+      if (!snd) {
+         MV_SetErrorCode( MV_NoMem );
+         return( MV_Error );
+      }
+      Sounds = snd;
+      memset(Sounds + NumSounds, 0, (max(16, 2 * NumSounds) - NumSounds) * sizeof(registered_sound));
+      NumSounds = max(16, 2 * NumSounds);
+   }
+
+   snd = &Sounds[id];
+   memset(snd, 0, sizeof(registered_sound));
+   snd->ptr = ptr;
+   snd->length = length;
+
+   if (length >= 22 && !memcmp("Creative Voice File\x1a", ptr, 20)) {
+      status = MV_ParseVOC(snd);
+   } else if (length >= 12 && !memcmp("RIFF", ptr, 4) && !memcmp("WAVE", ptr + 8, 4)) {
+      status = MV_ParseWAV(snd);
+#ifdef HAVE_VORBIS
+   } else if (length >= 4 && !memcmp("OggS", ptr, 4)) {
+      snd->format = SoundVorbis;
+      return id + 1;
+#endif
+   } else {
+      status = MV_UnknownFormat;
+   }
+
+   if (status != MV_Ok) {
+      ASS_Free(snd->blocks);
+      ASS_Free(snd->adpcm);
+      memset(snd, 0, sizeof(registered_sound));
+      MV_SetErrorCode( status );
+      return( MV_Error );
+   }
+
+   if (snd->format == SoundVOC) {
+      // MV_PlayLoopedVOC walks the file itself
+      ASS_Free(snd->blocks);
+      snd->blocks = 0;
+      snd->numblocks = 0;
+   } else if (snd->adpcm) {
+      snd->format = SoundADPCM;
+   } else {
+      snd->format = SoundPCM;
+
+      if (ResampleLimit > 0) {
+         MV_ResampleSound(snd);
+      }
+
+      if (TranscodeThreshold > 0 && snd->numblocks == 1 &&
+          snd->blocks[0].frames * snd->blocks[0].channels * snd->blocks[0].bits / 8 > TranscodeThreshold) {
+         MV_TranscodeSound(snd);
+         if (snd->transcoded) {
+            snd->format = SoundADPCM;
+         }
+      }
+   }
+   return id + 1;
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_UnregisterSound
+
+Stops any voices playing the sound and forgets it.
+---------------------------------------------------------------------*/
+
+int MV_UnregisterSound
+(
+ int id
+ )
+
+{
+   registered_sound * snd;
+
+   snd = MV_GetSound(id);
+   if (!snd) {
+      MV_SetErrorCode( MV_InvalidSoundID );
+      return( MV_Error );
+   }
+
+   MV_KillVoicesInRange(snd->ptr, snd->ptr + snd->length);
+   if (snd->blocks) {
+      MV_KillVoicesInRange((char *) snd->blocks, (char *) (snd->blocks + snd->numblocks));
+   }
+   if (snd->transcoded) {
+      MV_KillVoicesInRange(snd->adpcm->data, snd->adpcm->data + snd->adpcm->numblocks * snd->adpcm->blockalign);
+      ASS_Free(snd->adpcm->data);
+      TranscodeSavings -= snd->saved;
+   }
+   if (snd->converted) {
+      MV_KillVoicesInRange(snd->converted, snd->converted + snd->convertedsize);
+      ASS_Free(snd->converted);
+      ResampledMemory -= snd->convertedsize;
+   }
+
+   ASS_Free(snd->blocks);
+   ASS_Free(snd->adpcm);
+   memset(snd, 0, sizeof(registered_sound));
+
+   return( MV_Ok );
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_StartLoopedID
+
+Starts a voice for a registered sound with looping.
+---------------------------------------------------------------------*/
+
+static int MV_StartLoopedID
+(
+ int   id,
+ int   loopstart,
+ int   loopend,
+ int   pitchoffset,
+ int   vol,
+ int   left,
+ int   right,
+ int   priority,
+ unsigned int callbackval
+ )
+
+{
+   registered_sound * snd;
+   sound_block * block;
+   VoiceNode   *voice;
+
+   snd = MV_GetSound(id);
+   if (!snd) {
+      MV_SetErrorCode( MV_InvalidSoundID );
+      return( MV_Error );
+   }
+
+   // Loop points are given at the rate the sound was registered with
+   if (snd->srcrate) {
+      loopstart = loopstart > 0 ? (int) ((double) loopstart * snd->dstrate / snd->srcrate) : loopstart;
+      loopend   = loopend > 0 ? (int) ((double) loopend * snd->dstrate / snd->srcrate) : loopend;
+   }
+
+#ifdef HAVE_VORBIS
+   if (snd->format == SoundVorbis) {
+      return MV_PlayLoopedVorbis(snd->ptr, snd->length, loopstart, loopend,
+                                 pitchoffset, vol, left, right, priority, callbackval);
+   }
+#endif
+
+   if (snd->format == SoundVOC) {
+      return MV_PlayLoopedVOC(snd->ptr, snd->length, loopstart, loopend,
+                              pitchoffset, vol, left, right, priority, callbackval);
+   }
+
+   if (snd->format == SoundADPCM) {
+      return MV_PlayLoopedADPCM(snd->adpcm, loopstart, loopend,
+                                pitchoffset, vol, left, right, priority, callbackval);
+   }
+
+   block = &snd->blocks[0];
+   if (snd->numblocks == 1) {
+      return MV_PlayLoopedPCM(block->data, block->frames, loopstart, loopend,
+                              block->rate, block->bits, block->channels,
+                              pitchoffset, vol, left, right, priority, callbackval);
+   }
+
+   if ( !MV_Installed )
+   {
+      MV_SetErrorCode( MV_NotInstalled );
+      return( MV_Error );
+   }
+
+   // Request a voice from the voice pool
+   voice = MV_AllocVoice( priority );
+   if ( voice == NULL )
+   {
+      MV_SetErrorCode( MV_NoVoices );
+      return( MV_Error );
+   }
+
+   voice->wavetype    = VOC;
+   voice->bits        = block->bits;
+   voice->channels    = block->channels;
+   voice->GetSound    = MV_GetNextSoundBlock;
+   voice->NextBlock   = (char *) snd->blocks;
+   voice->LoopStart   = loopstart >= 0 ? (char *) snd->blocks : NULL;
+   voice->LoopEnd     = (char *) (snd->blocks + snd->numblocks);
+   voice->LoopSize    = 0;
+   voice->LoopCount   = 0;
+   voice->BlockLength = 0;
+   voice->DemandFeed  = NULL;
+   voice->sound       = block->data;
+   voice->length      = 0;
+   voice->position    = 0;
+   voice->next        = NULL;
+   voice->prev        = NULL;
+   voice->priority    = priority;
+   voice->callbackval = callbackval;
+   voice->Playing     = TRUE;
+   voice->Paused      = FALSE;
+
+   voice->PitchScale   = PITCH_GetScale( pitchoffset );
+   voice->SamplingRate = block->rate;
+   voice->RateScale    = RATE_SCALE( voice->SamplingRate, voice->PitchScale );
+
+   MV_SetVoiceVolume( voice, vol, left, right );
+   MV_PlayVoice( voice );
+
+   return( voice->handle );
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_PlayLoopedID
+
+Begin playback of a registered sound with looping. A sound made of
+a single block honours the loop points; a multi-block VOC loops in
+whole.
+---------------------------------------------------------------------*/
+
+int MV_PlayLoopedID
+(
+ int   id,
+ int   loopstart,
+ int   loopend,
+ int   pitchoffset,
+ int   vol,
+ int   left,
+ int   right,
+ int   priority,
+ unsigned int callbackval
+ )
+
+{
+   VoiceNode *voice;
+   int handle;
+
+   // Tag the voice for the profiler. A block mixed before this is
+   // charged to no sound, which is better than holding the mixer off
+   // while a Vorbis stream opens.
+   handle = MV_StartLoopedID(id, loopstart, loopend, pitchoffset, vol,
+                             left, right, priority, callbackval);
+   if (handle >= MV_Ok) {
+      MV_Lock();
+      voice = MV_GetVoice(handle);
+      if (voice) {
+         voice->soundid = id;
+      }
+      MV_Unlock();
+   }
+
+   return( handle );
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_PlayID
+
+Begin playback of a registered sound.
+---------------------------------------------------------------------*/
+
+int MV_PlayID
+(
+ int   id,
+ int   pitchoffset,
+ int   vol,
+ int   left,
+ int   right,
+ int   priority,
+ unsigned int callbackval
+ )
+
+{
+   return MV_PlayLoopedID(id, -1, -1, pitchoffset, vol, left, right, priority,
+                          callbackval);
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_PlayID3D
+
+Begin playback of a registered sound with 3D angle and distance
+attenuation.
+---------------------------------------------------------------------*/
+
+int MV_PlayID3D
+(
+ int   id,
+ int   pitchoffset,
+ int   angle,
+ int   distance,
+ int   priority,
+ unsigned int callbackval
+ )
+
+{
+   int left;
+   int right;
+   int mid;
+   int volume;
+
+   if ( !MV_Installed )
+   {
+      MV_SetErrorCode( MV_NotInstalled );
+      return( MV_Error );
+   }
+
+   if ( distance < 0 )
+   {
+      distance  = -distance;
+      angle    += MV_NumPanPositions / 2;
+   }
+
+   volume = MIX_VOLUME( distance );
+
+   // Ensure angle is within 0 - 31
+   angle &= MV_MaxPanPosition;
+
+   left  = MV_PanTable[ angle ][ volume ].left;
+   right = MV_PanTable[ angle ][ volume ].right;
+   mid   = max( 0, 255 - distance );
+
+   return MV_PlayID( id, pitchoffset, mid, left, right, priority, callbackval );
+}
+
+// vim:ts=3:expandtab:
@@ -0,0 +1,952 @@
+/*
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+ */
+
+/**
+ * Streaming file playback for MultiVoc
+ *
+ * Each stream owns a fixed ring of decoded PCM. A single I/O thread
+ * reads and decodes ahead into the rings; the mixer only ever plays
+ * from what is already there and never touches the disk. If the
+ * filler falls behind, the voice plays silence until it catches up.
+ *
+ * Mixing pulled through MV_Render is the exception. It runs as fast as
+ * the caller asks, far ahead of a filler that wakes every StreamPollTime,
+ * so there the mixer reads an empty ring itself and the output is the
+ * same however fast it is pulled.
+ */
+
+#ifdef HAVE_VORBIS
+# ifdef __APPLE__
+#  include <vorbis/vorbisfile.h>
+# else
+#  include "vorbis/vorbisfile.h"
+# endif
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "asssys.h"
+#include "trace.h"
+#include "pitch.h"
+#include "multivoc.h"
+#include "_multivc.h"
+
+#define min(x,y) ((x) < (y) ? (x) : (y))
+#define max(x,y) ((x) > (y) ? (x) : (y))
+
+#define StreamBufferSize  0x20000   // bytes of PCM held ahead, a power of two
+#define StreamFillSize    0x4000    // most bytes decoded in one filler step
+#define StreamPieceSize   0x4000    // most bytes handed to the mixer at once
+#define StreamPrimeSize   0x8000    // bytes decoded by the caller before playing
+#define StreamPollTime    10        // milliseconds the filler sleeps between passes
+
+enum {
+   StreamWAV,
+   StreamVOC,
+   StreamVorbis
+};
+
+typedef struct {
+   long filepos;
+   unsigned int blockleft;
+   unsigned int silenceleft;
+   long repeatpos;
+   unsigned int repeatcount;
+   unsigned int samplepos;
+} stream_mark;
+
+typedef struct stream_data {
+   struct stream_data * next;
+
+   FILE * fp;
+   int format;
+   unsigned int rate;
+   int bits;
+   int channels;
+   int framesize;
+
+   // PCM reader state for WAV and VOC
+   unsigned int blockleft;    // bytes left in the current sound block
+   unsigned int silenceleft;  // bytes of generated silence still to give
+   long repeatpos;            // VOC repeat block start, or -1
+   unsigned int repeatcount;
+
+#ifdef HAVE_VORBIS
+   OggVorbis_File vf;
+   int lastbitstream;
+#endif
+
+   int loopstart;             // sample position, or -1 if not looping
+   int loopend;               // sample position, or 0 for the end
+   unsigned int samplepos;
+   int looped;                // nothing produced since the last loop back
+   int marked;
+   stream_mark mark;          // reader state at loopstart, WAV and VOC
+
+   volatile unsigned int head;    // bytes written by the filler
+   volatile unsigned int tail;    // bytes released by the mixer
+   unsigned int piece;            // bytes given to the mixer but not released
+   volatile int eof;
+   volatile int released;
+
+   int buffer[ StreamBufferSize / sizeof(int) ];
+} stream_data;
+
+static ASS_Mutex * StreamMutex = 0;
+static ASS_Thread * StreamThread = 0;
+static volatile int StreamQuit = 0;
+static stream_data * StreamList = 0;
+
+static char StreamSilence8[ MixBufferSize * STEREO_8BIT_SAMPLE_SIZE ];
+static char StreamSilence16[ MixBufferSize * STEREO_16BIT_SAMPLE_SIZE ];
+
+
+static int MV_SetStreamFormat(stream_data * sd, unsigned int rate, int bits, int channels)
+{
+   if (sd->bits == 0) {
+      sd->rate = rate;
+      sd->bits = bits;
+      sd->channels = channels;
+      sd->framesize = channels * bits / 8;
+      return 1;
+   }
+
+   // The voice rate and mix mode are fixed once playing
+   return sd->rate == rate && sd->bits == bits && sd->channels == channels;
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_NextStreamVOCBlock
+
+Walks the VOC blocks from the file position up to the next block of
+sound data or silence.
+---------------------------------------------------------------------*/
+
+static int MV_NextStreamVOCBlock
+(
+ stream_data * sd
+ )
+
+{
+   unsigned char header[12];
+   unsigned int blocklength;
+   unsigned int tc = 0;
+   unsigned int packtype = 0;
+   unsigned int voicemode = 0;
+   unsigned int rate;
+   unsigned int count;
+   int blocktype;
+   int lastblocktype = 0;
+   int jumps = 0;
+
+   for (;;) {
+      if (fread(header, 1, 1, sd->fp) != 1 || header[0] == 0) {
+         return 0;
+      }
+      blocktype = header[0];
+
+      if (fread(header, 1, 3, sd->fp) != 3) {
+         return 0;
+      }
+      blocklength = header[0] | (header[1] << 8) | (header[2] << 16);
+
+      switch (blocktype) {
+         case 1:
+            // Sound data block
+            if (blocklength < 2 || fread(header, 1, 2, sd->fp) != 2) {
+               return 0;
+            }
+            blocklength -= 2;
+
+            if (lastblocktype != 8) {
+               tc = header[0] << 8;
+               packtype = header[1];
+               voicemode = 0;
+            }
+
+            if (packtype != 0 || voicemode > 1) {
+               // Skip packed or unknown data
+               fseek(sd->fp, blocklength, SEEK_CUR);
+               break;
+            }
+
+            rate = 256000000L / ((voicemode + 1) * (65536 - tc));
+            if (!MV_SetStreamFormat(sd, rate, 8, voicemode + 1)) {
+               return 0;
+            }
+            sd->blockleft = blocklength - blocklength % sd->framesize;
+            return 1;
+
+         case 2:
+            // Sound continuation block
+            if (sd->bits == 0) {
+               fseek(sd->fp, blocklength, SEEK_CUR);
+               break;
+            }
+            sd->blockleft = blocklength - blocklength % sd->framesize;
+            return 1;
+
+         case 3:
+            // Silence
+            if (blocklength < 3 || fread(header, 1, 3, sd->fp) != 3) {
+               return 0;
+            }
+            fseek(sd->fp, blocklength - 3, SEEK_CUR);
+            if (sd->bits == 0) {
+               break;
+            }
+            count = read_le16(header) + 1;
+            sd->silenceleft = count * sd->framesize;
+            return 1;
+
+         case 4:
+            // Marker
+         case 5:
+            // ASCII string
+            fseek(sd->fp, blocklength, SEEK_CUR);
+            break;
+
+         case 6:
+            // Repeat begin
+            if (blocklength < 2 || fread(header, 1, 2, sd->fp) != 2) {
+               return 0;
+            }
+            fseek(sd->fp, blocklength - 2, SEEK_CUR);
+            sd->repeatcount = read_le16(header);
+            sd->repeatpos = ftell(sd->fp);
+            break;
+
+         case 7:
+            // Repeat end
+            fseek(sd->fp, blocklength, SEEK_CUR);
+            if (sd->repeatpos >= 0 && sd->repeatcount > 0) {
+               if (++jumps > 1) {
+                  // The repeat holds no playable data
+                  return 0;
+               }
+               fseek(sd->fp, sd->repeatpos, SEEK_SET);
+               if (sd->repeatcount < 0xffff) {
+                  sd->repeatcount--;
+               }
+            }
+            break;
+
+         case 8:
+            // Extended block
+            if (blocklength < 4 || fread(header, 1, 4, sd->fp) != 4) {
+               return 0;
+            }
+            fseek(sd->fp, blocklength - 4, SEEK_CUR);
+            tc = read_le16(header);
+            packtype = header[2];
+            voicemode = header[3];
+            break;
+
+         case 9:
+            // New sound data block
+            if (blocklength < 12 || fread(header, 1, 12, sd->fp) != 12) {
+               return 0;
+            }
+            blocklength -= 12;
+
+            if (((header[4] == 8 && read_le16(header + 6) == VOC_8BIT) ||
+                 (header[4] == 16 && read_le16(header + 6) == VOC_16BIT)) &&
+                (header[5] == 1 || header[5] == 2)) {
+               if (!MV_SetStreamFormat(sd, read_le32(header), header[4], header[5])) {
+                  return 0;
+               }
+               sd->blockleft = blocklength - blocklength % sd->framesize;
+               return 1;
+            }
+
+            fseek(sd->fp, blocklength, SEEK_CUR);
+            break;
+
+         default:
+            // Unknown data.  Probably not a VOC file.
+            return 0;
+      }
+
+      lastblocktype = blocktype;
+   }
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_ReadStreamPCM
+
+Copies PCM from a WAV data chunk or VOC sound blocks, honouring the
+loop points.
+---------------------------------------------------------------------*/
+
+static int MV_ReadStreamPCM
+(
+ stream_data * sd,
+ char * dest,
+ int want
+ )
+
+{
+   int done = 0;
+   int count;
+   int atend;
+
+   while (done < want) {
+      if (sd->loopstart >= 0 && !sd->marked && sd->samplepos == (unsigned int) sd->loopstart) {
+         sd->mark.filepos     = ftell(sd->fp);
+         sd->mark.blockleft   = sd->blockleft;
+         sd->mark.silenceleft = sd->silenceleft;
+         sd->mark.repeatpos   = sd->repeatpos;
+         sd->mark.repeatcount = sd->repeatcount;
+         sd->mark.samplepos   = sd->samplepos;
+         sd->marked = 1;
+      }
+
+      if (sd->loopend > 0 && sd->samplepos >= (unsigned int) sd->loopend) {
+         atend = 1;
+      } else if (sd->blockleft == 0 && sd->silenceleft == 0) {
+         atend = sd->format == StreamWAV || !MV_NextStreamVOCBlock(sd);
+      } else {
+         atend = 0;
+      }
+
+      if (atend) {
+         if (!sd->marked || sd->looped) {
+            break;
+         }
+
+         fseek(sd->fp, sd->mark.filepos, SEEK_SET);
+         sd->blockleft   = sd->mark.blockleft;
+         sd->silenceleft = sd->mark.silenceleft;
+         sd->repeatpos   = sd->mark.repeatpos;
+         sd->repeatcount = sd->mark.repeatcount;
+         sd->samplepos   = sd->mark.samplepos;
+         sd->looped = 1;
+         continue;
+      }
+
+      count = want - done;
+      if (sd->samplepos < (unsigned int) sd->loopstart && sd->loopstart >= 0) {
+         count = min(count, (int) (sd->loopstart - sd->samplepos) * sd->framesize);
+      }
+      if (sd->loopend > 0) {
+         count = min(count, (int) (sd->loopend - sd->samplepos) * sd->framesize);
+      }
+
+      if (sd->silenceleft > 0) {
+         count = min(count, (int) sd->silenceleft);
+         memset(dest + done, sd->bits == 8 ? 0x80 : 0, count);
+         sd->silenceleft -= count;
+      } else {
+         count = min(count, (int) sd->blockleft);
+         count = (int) fread(dest + done, 1, count, sd->fp);
+         count -= count % sd->framesize;
+         if (count <= 0) {
+            // Truncated file
+            sd->blockleft = 0;
+            continue;
+         }
+         sd->blockleft -= count;
+      }
+
+      sd->samplepos += count / sd->framesize;
+      sd->looped = 0;
+      done += count;
+   }
+
+   return done;
+}
+
+
+#ifdef HAVE_VORBIS
+
+static size_t read_stream_vorbis(void * ptr, size_t size, size_t nmemb, void * datasource)
+{
+   return fread(ptr, size, nmemb, (FILE *) datasource);
+}
+
+static int seek_stream_vorbis(void * datasource, ogg_int64_t offset, int whence)
+{
+   return fseek((FILE *) datasource, (long) offset, whence);
+}
+
+static long tell_stream_vorbis(void * datasource)
+{
+   return ftell((FILE *) datasource);
+}
+
+static ov_callbacks stream_vorbis_callbacks = {
+   read_stream_vorbis,
+   seek_stream_vorbis,
+   0,    // the file is closed with the stream
+   tell_stream_vorbis
+};
+
+
+/*---------------------------------------------------------------------
+Function: MV_ReadStreamVorbis
+
+Decodes OggVorbis data, honouring the loop points. A chained file
+ends at the first link whose rate or channels differ.
+---------------------------------------------------------------------*/
+
+static int MV_ReadStreamVorbis
+(
+ stream_data * sd,
+ char * dest,
+ int want
+ )
+
+{
+   int done = 0;
+   int bytes;
+   int bitstream;
+   vorbis_info * vi;
+
+   while (done < want) {
+      bytes = want - done;
+      if (sd->loopend > 0) {
+         if (sd->samplepos >= (unsigned int) sd->loopend) {
+            bytes = 0;
+         } else {
+            bytes = min(bytes, (int) (sd->loopend - sd->samplepos) * sd->framesize);
+         }
+      }
+
+      if (bytes > 0) {
+         bytes = ov_read(&sd->vf, dest + done, bytes, 0, 2, 1, &bitstream);
+         if (bytes == OV_HOLE) {
+            continue;
+         }
+         if (bytes > 0 && bitstream != sd->lastbitstream) {
+            vi = ov_info(&sd->vf, -1);
+            if (vi && vi->channels == sd->channels && vi->rate == sd->rate) {
+               sd->lastbitstream = bitstream;
+            } else {
+               bytes = 0;
+            }
+         }
+      }
+
+      if (bytes <= 0) {
+         if (sd->loopstart < 0 || sd->looped) {
+            break;
+         }
+         if (ov_pcm_seek(&sd->vf, sd->loopstart) != 0) {
+            break;
+         }
+         sd->samplepos = sd->loopstart;
+         sd->looped = 1;
+         continue;
+      }
+
+      sd->samplepos += bytes / sd->framesize;
+      sd->looped = 0;
+      done += bytes;
+   }
+
+   return done;
+}
+
+#endif //HAVE_VORBIS
+
+
+/*---------------------------------------------------------------------
+Function: MV_FillStream
+
+Decodes into the free space at the head of the stream's ring. Returns
+the number of bytes added, or 0 if the ring is full or the stream has
+run out of data.
+---------------------------------------------------------------------*/
+
+static int MV_FillStream
+(
+ stream_data * sd
+ )
+
+{
+   unsigned int used;
+   unsigned int offset;
+   int count;
+   int bytes = 0;
+   TraceSpan span;
+
+   ASS_MemoryBarrier();
+   used   = sd->head - sd->tail;
+   offset = sd->head % StreamBufferSize;
+
+   count = min(StreamBufferSize - used, StreamBufferSize - offset);
+   count = min(count, StreamFillSize);
+   count -= count % sd->framesize;
+   if (count <= 0) {
+      return 0;
+   }
+
+   TRACE_BEGIN(span);
+   switch (sd->format) {
+      case StreamWAV:
+      case StreamVOC:
+         bytes = MV_ReadStreamPCM(sd, (char *) sd->buffer + offset, count);
+         break;
+#ifdef HAVE_VORBIS
+      case StreamVorbis:
+         bytes = MV_ReadStreamVorbis(sd, (char *) sd->buffer + offset, count);
+         break;
+#endif
+   }
+   TRACE_END(span, "stream fill", bytes);
+
+   // Publish the data before the new head or the end flag
+   ASS_MemoryBarrier();
+
+   if (bytes <= 0) {
+      sd->eof = 1;
+      return 0;
+   }
+
+   sd->head += bytes;
+   return bytes;
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_GetNextStreamBlock
+
+Hands the mixer the next contiguous run of decoded PCM, first giving
+the previous run back to the filler.
+---------------------------------------------------------------------*/
+
+static playbackstatus MV_GetNextStreamBlock
+(
+ VoiceNode *voice
+ )
+
+{
+   stream_data * sd = (stream_data *) voice->extra;
+   unsigned int avail;
+   unsigned int offset;
+   unsigned int length;
+   int eof;
+
+   voice->Playing = TRUE;
+
+   if (sd->piece > 0) {
+      // Finish reading the piece before the filler may reuse it
+      ASS_MemoryBarrier();
+      sd->tail += sd->piece;
+      sd->piece = 0;
+   }
+
+   // Read the end flag first: once set, the head is final
+   eof = sd->eof;
+   ASS_MemoryBarrier();
+   avail = sd->head - sd->tail;
+
+   if (avail == 0 && !eof && MV_Rendering) {
+      ASS_LockMutex(StreamMutex);
+      MV_FillStream(sd);
+      ASS_UnlockMutex(StreamMutex);
+
+      eof = sd->eof;
+      ASS_MemoryBarrier();
+      avail = sd->head - sd->tail;
+   }
+
+   if (avail == 0) {
+      if (eof) {
+         voice->Playing = FALSE;
+         return( NoMoreData );
+      }
+
+      // Underrun: play silence until the filler catches up
+      voice->sound    = voice->bits == 8 ? StreamSilence8 : StreamSilence16;
+      voice->position -= voice->length;
+      voice->length   = (uint64_t) MixBufferSize << 32;
+      return( KeepPlaying );
+   }
+
+   offset = sd->tail % StreamBufferSize;
+   length = min(avail, StreamBufferSize - offset);
+   length = min(length, StreamPieceSize);
+
+   sd->piece        = length;
+   voice->sound     = (char *) sd->buffer + offset;
+   voice->position -= voice->length;
+   voice->length    = (uint64_t) (length / sd->framesize) << 32;
+
+   return( KeepPlaying );
+}
+
+
+static void MV_CloseStream(stream_data * sd)
+{
+#ifdef HAVE_VORBIS
+   if (sd->format == StreamVorbis) {
+      ov_clear(&sd->vf);
+   }
+#endif
+   fclose(sd->fp);
+   ASS_Free(sd);
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_OpenStream
+
+Opens a WAV, VOC or OggVorbis file and reads its header.
+---------------------------------------------------------------------*/
+
+static stream_data * MV_OpenStream
+(
+ const char * filename,
+ int loopstart,
+ int loopend
+ )
+
+{
+   stream_data * sd;
+   unsigned char header[32];
+   unsigned int chunklength;
+   int error = MV_Ok;
+   size_t length;
+
+   sd = (stream_data *) ASS_Alloc(ASS_MemStreams, sizeof(stream_data));
+   if (!sd) {
+      MV_SetErrorCode( MV_NoMem );
+      return 0;
+   }
+
+   memset(sd, 0, sizeof(stream_data) - sizeof(sd->buffer));
+   sd->repeatpos = -1;
+   sd->loopstart = loopstart;
+   sd->loopend   = loopstart >= 0 ? max(0, loopend) : 0;
+
+   sd->fp = fopen(filename, "rb");
+   if (!sd->fp) {
+      ASS_Free(sd);
+      MV_SetErrorCode( MV_FileError );
+      return 0;
+   }
+
+   length = fread(header, 1, sizeof(header), sd->fp);
+
+   if (length >= 22 && !memcmp("Creative Voice File\x1a", header, 20)) {
+      sd->format = StreamVOC;
+      fseek(sd->fp, read_le16(header + 20), SEEK_SET);
+      if (!MV_NextStreamVOCBlock(sd)) {
+         error = MV_InvalidVOCFile;
+      }
+   } else if (length >= 12 && !memcmp("RIFF", header, 4) && !memcmp("WAVE", header + 8, 4)) {
+      sd->format = StreamWAV;
+      fseek(sd->fp, 12, SEEK_SET);
+
+      // Walk the chunks up to the sample data
+      error = MV_InvalidWAVFile;
+      while (fread(header, 1, 8, sd->fp) == 8) {
+         chunklength = read_le32(header + 4);
+
+         if (!memcmp("data", header, 4)) {
+            if (sd->bits) {
+               sd->blockleft = chunklength - chunklength % sd->framesize;
+               error = MV_Ok;
+            }
+            break;
+         }
+
+         if (!memcmp("fmt ", header, 4)) {
+            if (chunklength < 16 || fread(header, 1, 16, sd->fp) != 16) {
+               break;
+            }
+            chunklength -= 16;
+
+            // PCM only
+            if (read_le16(header) != 1 ||
+                (read_le16(header + 2) != 1 && read_le16(header + 2) != 2) ||
+                (read_le16(header + 14) != 8 && read_le16(header + 14) != 16)) {
+               break;
+            }
+            MV_SetStreamFormat(sd, read_le32(header + 4), read_le16(header + 14),
+                               read_le16(header + 2));
+         }
+
+         fseek(sd->fp, chunklength + (chunklength & 1), SEEK_CUR);
+      }
+#ifdef HAVE_VORBIS
+   } else if (length >= 4 && !memcmp("OggS", header, 4)) {
+      vorbis_info * vi;
+
+      sd->format = StreamVorbis;
+      fseek(sd->fp, 0, SEEK_SET);
+
+      error = MV_InvalidVorbisFile;
+      if (ov_open_callbacks((void *) sd->fp, &sd->vf, 0, 0, stream_vorbis_callbacks) == 0) {
+         vi = ov_info(&sd->vf, -1);
+         if (vi && (vi->channels == 1 || vi->channels == 2)) {
+            MV_SetStreamFormat(sd, vi->rate, 16, vi->channels);
+            sd->lastbitstream = -1;
+            error = MV_Ok;
+         }
+         if (error != MV_Ok) {
+            ov_clear(&sd->vf);
+         }
+      }
+#endif
+   } else {
+      error = MV_FileError;
+   }
+
+   if (error != MV_Ok) {
+      fclose(sd->fp);
+      ASS_Free(sd);
+      MV_SetErrorCode( error );
+      return 0;
+   }
+
+   return sd;
+}
+
+
+static int MV_StreamThreadFunc(void * arg)
+{
+   stream_data ** prev;
+   stream_data * sd;
+
+   while (!StreamQuit) {
+      ASS_LockMutex(StreamMutex);
+
+      for (prev = &StreamList; (sd = *prev); ) {
+         if (sd->released) {
+            *prev = sd->next;
+            MV_CloseStream(sd);
+            continue;
+         }
+
+         while (!sd->eof && MV_FillStream(sd) > 0) ;
+
+         prev = &sd->next;
+      }
+
+      ASS_UnlockMutex(StreamMutex);
+
+      ASS_Sleep(StreamPollTime);
+   }
+
+   return 0;
+}
+
+
+static int MV_StartStreaming(void)
+{
+   if (StreamThread) {
+      return 1;
+   }
+
+   if (!StreamMutex) {
+      StreamMutex = ASS_CreateMutex();
+      if (!StreamMutex) {
+         return 0;
+      }
+   }
+
+   memset(StreamSilence8, 0x80, sizeof(StreamSilence8));
+
+   StreamQuit = 0;
+   StreamThread = ASS_CreateThread(MV_StreamThreadFunc, 0);
+
+   return StreamThread != 0;
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_ShutdownStreams
+
+Stops the stream filler and closes every stream. Only to be called
+once playback has stopped.
+---------------------------------------------------------------------*/
+
+void MV_ShutdownStreams
+(
+ void
+ )
+
+{
+   stream_data * sd;
+
+   if (StreamThread) {
+      StreamQuit = 1;
+      ASS_WaitThread(StreamThread);
+      StreamThread = 0;
+   }
+
+   while (StreamList) {
+      sd = StreamList;
+      StreamList = sd->next;
+      MV_CloseStream(sd);
+   }
+
+   if (StreamMutex) {
+      ASS_DestroyMutex(StreamMutex);
+      StreamMutex = 0;
+   }
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_ReleaseStreamVoice
+
+Hands a finished stream back to the filler to be closed. Called with
+the mixer locked, or from within the mixer.
+---------------------------------------------------------------------*/
+
+void MV_ReleaseStreamVoice
+(
+ VoiceNode * voice
+ )
+
+{
+   stream_data * sd = (stream_data *) voice->extra;
+
+   if (voice->wavetype != Stream || !sd) {
+      return;
+   }
+
+   voice->extra = 0;
+
+   ASS_MemoryBarrier();
+   sd->released = 1;
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_PlayStream
+
+Begin playback of a sound file streamed from disk.
+---------------------------------------------------------------------*/
+
+int MV_PlayStream
+(
+ const char *filename,
+ int   pitchoffset,
+ int   vol,
+ int   left,
+ int   right,
+ int   priority,
+ unsigned int callbackval
+ )
+
+{
+   return MV_PlayLoopedStream( filename, -1, -1, pitchoffset, vol, left, right,
+                               priority, callbackval );
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_PlayLoopedStream
+
+Begin playback of a looped sound file streamed from disk. Loop points
+are in samples.
+---------------------------------------------------------------------*/
+
+int MV_PlayLoopedStream
+(
+ const char *filename,
+ int   loopstart,
+ int   loopend,
+ int   pitchoffset,
+ int   vol,
+ int   left,
+ int   right,
+ int   priority,
+ unsigned int callbackval
+ )
+
+{
+   VoiceNode   *voice;
+   stream_data * sd;
+
+   if ( !MV_Installed )
+   {
+      MV_SetErrorCode( MV_NotInstalled );
+      return( MV_Error );
+   }
+
+   if ( !MV_StartStreaming() )
+   {
+      MV_SetErrorCode( MV_NoMem );
+      return( MV_Error );
+   }
+
+   sd = MV_OpenStream( filename, loopstart, loopend );
+   if ( !sd )
+   {
+      return( MV_Error );
+   }
+
+   // Decode the first part here so the voice starts without a gap
+   while ( sd->head < StreamPrimeSize && MV_FillStream( sd ) > 0 ) ;
+
+   // Request a voice from the voice pool
+   voice = MV_AllocVoice( priority );
+   if ( voice == NULL )
+   {
+      MV_CloseStream( sd );
+      MV_SetErrorCode( MV_NoVoices );
+      return( MV_Error );
+   }
+
+   voice->wavetype    = Stream;
+   voice->bits        = sd->bits;
+   voice->channels    = sd->channels;
+   voice->extra       = (void *) sd;
+   voice->GetSound    = MV_GetNextStreamBlock;
+   voice->NextBlock   = 0;
+   voice->DemandFeed  = NULL;
+   voice->LoopCount   = 0;
+   voice->BlockLength = 0;
+   voice->PitchScale  = PITCH_GetScale( pitchoffset );
+   voice->length      = 0;
+   voice->position    = 0;
+   voice->next        = NULL;
+   voice->prev        = NULL;
+   voice->priority    = priority;
+   voice->callbackval = callbackval;
+   voice->LoopStart   = 0;
+   voice->LoopEnd     = 0;
+   voice->LoopSize    = 0;
+   voice->Playing     = TRUE;
+   voice->Paused      = FALSE;
+
+   voice->SamplingRate = sd->rate;
+   voice->RateScale    = RATE_SCALE( voice->SamplingRate, voice->PitchScale );
+   MV_SetVoiceMixMode( voice );
+
+   MV_SetVoiceVolume( voice, vol, left, right );
+
+   ASS_LockMutex( StreamMutex );
+   sd->next = StreamList;
+   StreamList = sd;
+   ASS_UnlockMutex( StreamMutex );
+
+   MV_PlayVoice( voice );
+
+   return( voice->handle );
+}
+
+// vim:ts=3:expandtab:
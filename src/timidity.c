@@ -31,6 +31,7 @@
 #include <errno.h>
 #include <timidity.h>
 #include "pitch.h"
+#include "asssys.h"
 #include "multivoc.h"
 #include "_multivc.h"
 #include "fx_man.h"
@@ -63,7 +64,7 @@ static playbackstatus MV_GetTimidityBlock
    read_buf /= (voice->bits >> 3) * voice->channels;
    voice->position = 0;
    voice->sound = voice->NextBlock;
-   voice->length = read_buf << 16;
+   voice->length = (uint64_t) read_buf << 32;
 
    return( KeepPlaying );
 }
@@ -167,9 +168,10 @@ int MV_PlayLoopedTimidity
       return( MV_Error );
    }
 
-   block = malloc(options.buffer_size);
+   block = ASS_Alloc(ASS_MemTimidity, options.buffer_size);
    if (!block)
    {
+      MV_SetErrorCode( MV_NoMem );
       return( MV_Error );
    }
 
@@ -179,7 +181,7 @@ int MV_PlayLoopedTimidity
 
    if (!song)
    {
-	   free(block);
+	   ASS_Free(block);
 	   return( MV_Error );
    }
 
@@ -188,6 +190,7 @@ int MV_PlayLoopedTimidity
 
    if ( voice == NULL )
    {
+	  ASS_Free(block);
 	  mid_song_free (song);
       return( MV_Error );
    }
@@ -217,9 +220,7 @@ int MV_PlayLoopedTimidity
    voice->Paused      = FALSE;
    
    voice->SamplingRate = options.rate;
-   voice->RateScale    = ( voice->SamplingRate * voice->PitchScale ) / MV_MixRate;
-   voice->FixedPointBufferSize = ( voice->RateScale * MixBufferSize ) -
-      voice->RateScale;
+   voice->RateScale    = RATE_SCALE( voice->SamplingRate, voice->PitchScale );
    MV_SetVoiceMixMode( voice );
 
    MV_SetVoiceVolume( voice, vol, left, right );
@@ -234,7 +235,7 @@ void MV_ReleaseTimidityVoice( VoiceNode * voice )
    MidSong* song = (MidSong* ) voice->extra;
    
    if (voice->wavetype != Timidity) {
-	  free(voice->NextBlock);
+	  ASS_Free(voice->NextBlock);
 	  mid_song_free (song);
       return;
    }
@@ -0,0 +1,119 @@
+/*
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+ */
+
+/**
+ * File helpers shared by the command line tools
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tools.h"
+
+unsigned int read_le16(const void * p)
+{
+    const unsigned char * b = (const unsigned char *) p;
+
+    return b[0] | (b[1] << 8);
+}
+
+unsigned int read_le32(const void * p)
+{
+    const unsigned char * b = (const unsigned char *) p;
+
+    return b[0] | (b[1] << 8) | (b[2] << 16) | ((unsigned int) b[3] << 24);
+}
+
+void write_le16(void * p, unsigned int v)
+{
+    unsigned char * b = (unsigned char *) p;
+
+    b[0] = v;
+    b[1] = v >> 8;
+}
+
+void write_le32(void * p, unsigned int v)
+{
+    unsigned char * b = (unsigned char *) p;
+
+    b[0] = v;
+    b[1] = v >> 8;
+    b[2] = v >> 16;
+    b[3] = v >> 24;
+}
+
+// A canonical 44 byte header for PCM data
+void makewavheader(void * header, unsigned int rate, int channels, int bits,
+                   unsigned int databytes)
+{
+    unsigned char * h = (unsigned char *) header;
+    int framesize = channels * bits / 8;
+
+    memcpy(h, "RIFF", 4);
+    write_le32(h + 4, 36 + databytes);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    write_le32(h + 16, 16);
+    write_le16(h + 20, 1);
+    write_le16(h + 22, channels);
+    write_le32(h + 24, rate);
+    write_le32(h + 28, rate * framesize);
+    write_le16(h + 32, framesize);
+    write_le16(h + 34, bits);
+    memcpy(h + 36, "data", 4);
+    write_le32(h + 40, databytes);
+}
+
+// Writes the header at the start of the file, to be called again with
+// the real length once the data is written
+void writewavheader(FILE * fp, unsigned int rate, int channels, int bits,
+                    unsigned int databytes)
+{
+    unsigned char header[WAVHEADER_SIZE];
+
+    makewavheader(header, rate, channels, bits, databytes);
+    fseek(fp, 0, SEEK_SET);
+    fwrite(header, 1, sizeof(header), fp);
+}
+
+char * loadfile(const char * filename, unsigned int * length)
+{
+    FILE * fp;
+    char * data;
+    long size;
+
+    fp = fopen(filename, "rb");
+    if (!fp) {
+        return 0;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    data = (char *) malloc(size > 0 ? size : 1);
+    if (!data || fread(data, 1, size, fp) != (size_t) size) {
+        free(data);
+        fclose(fp);
+        return 0;
+    }
+
+    fclose(fp);
+    *length = (unsigned int) size;
+    return data;
+}
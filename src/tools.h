@@ -0,0 +1,38 @@
+/*
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+ */
+
+#ifndef __TOOLS_H
+#define __TOOLS_H
+
+#include <stdio.h>
+
+#define WAVHEADER_SIZE 44
+
+unsigned int read_le16(const void * p);
+unsigned int read_le32(const void * p);
+void write_le16(void * p, unsigned int v);
+void write_le32(void * p, unsigned int v);
+
+void makewavheader(void * header, unsigned int rate, int channels, int bits,
+                   unsigned int databytes);
+void writewavheader(FILE * fp, unsigned int rate, int channels, int bits,
+                    unsigned int databytes);
+
+char * loadfile(const char * filename, unsigned int * length);
+
+#endif
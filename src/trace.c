@@ -0,0 +1,174 @@
+/*
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+ */
+
+/**
+ * Timeline tracing of the audio code
+ *
+ * Spans and marks go into a fixed ring that any thread may write to
+ * without taking a lock; a writer claims a slot by bumping the head
+ * and stamps it with its sequence number once the slot is filled in.
+ * When the ring wraps the oldest events are lost. TRACE_Write saves
+ * what is held as Chrome trace JSON, which chrome://tracing and
+ * Perfetto load, skipping any slot caught half written.
+ */
+
+#include <stdio.h>
+#include "asssys.h"
+#include "trace.h"
+
+#define TRACE_RingSize 32768     // a power of two
+
+typedef struct {
+	volatile unsigned int seq;  // index + 1 when filled in, 0 while writing
+	const char * name;
+	unsigned int start;         // microseconds
+	unsigned int duration;      // nanoseconds
+	unsigned int thread;
+	int arg;
+	int instant;
+} TraceEvent;
+
+volatile int TRACE_Enabled = 0;
+
+static TraceEvent Ring[TRACE_RingSize];
+static volatile unsigned int Head = 0;
+static unsigned int First = 0;      // the first event of this trace
+static unsigned int Origin = 0;     // when it started
+
+
+static void record(const char * name, unsigned int start, unsigned int duration,
+		int arg, int instant)
+{
+	unsigned int index;
+	TraceEvent * ev;
+
+	if (!TRACE_Enabled) {
+		return;
+	}
+
+	index = ASS_AtomicIncrement(&Head);
+	ev = &Ring[index & (TRACE_RingSize - 1)];
+
+	ev->seq = 0;
+	ASS_MemoryBarrier();
+
+	ev->name = name;
+	ev->start = start;
+	ev->duration = duration;
+	ev->thread = ASS_GetThreadID();
+	ev->arg = arg;
+	ev->instant = instant;
+
+	ASS_MemoryBarrier();
+	ev->seq = index + 1;
+}
+
+void TRACE_Start(void)
+{
+	Origin = ASS_GetMicroTicks();
+	First = Head;
+	ASS_MemoryBarrier();
+	TRACE_Enabled = 1;
+}
+
+void TRACE_Stop(void)
+{
+	TRACE_Enabled = 0;
+}
+
+void TRACE_Begin(TraceSpan * span)
+{
+	span->start = ASS_GetMicroTicks();
+	span->nstart = ASS_GetNanoTicks();
+}
+
+void TRACE_End(TraceSpan * span, const char * name, int arg)
+{
+	record(name, span->start, ASS_GetNanoTicks() - span->nstart, arg, 0);
+}
+
+void TRACE_Mark(const char * name, int arg)
+{
+	record(name, ASS_GetMicroTicks(), 0, arg, 1);
+}
+
+static void writeName(FILE * fp, const char * name)
+{
+	for (; *name; name++) {
+		if (*name == '"' || *name == '\\') {
+			fputc('\\', fp);
+			fputc(*name, fp);
+		} else if ((unsigned char) *name >= ' ') {
+			fputc(*name, fp);
+		}
+	}
+}
+
+int TRACE_Write(const char * filename)
+{
+	FILE * fp;
+	TraceEvent ev;
+	unsigned int head, index, seq;
+	int count = 0;
+
+	fp = fopen(filename, "w");
+	if (!fp) {
+		return -1;
+	}
+
+	head = Head;
+	index = head - First > TRACE_RingSize ? head - TRACE_RingSize : First;
+
+	fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+	for (; index != head; index++) {
+		TraceEvent * slot = &Ring[index & (TRACE_RingSize - 1)];
+
+		seq = slot->seq;
+		ASS_MemoryBarrier();
+		ev = *slot;
+		ASS_MemoryBarrier();
+		if (seq != index + 1 || slot->seq != seq) {
+			continue;
+		}
+		// begun before the trace started
+		if ((int) (ev.start - Origin) < 0) {
+			continue;
+		}
+
+		fprintf(fp, "%s\n{\"name\":\"", count ? "," : "");
+		writeName(fp, ev.name);
+		if (ev.instant) {
+			fprintf(fp, "\",\"cat\":\"audio\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%u",
+				ev.start - Origin);
+		} else {
+			fprintf(fp, "\",\"cat\":\"audio\",\"ph\":\"X\",\"ts\":%u,\"dur\":%u.%03u",
+				ev.start - Origin, ev.duration / 1000, ev.duration % 1000);
+		}
+		fprintf(fp, ",\"pid\":1,\"tid\":%u,\"args\":{\"arg\":%d}}", ev.thread, ev.arg);
+		count++;
+	}
+
+	fprintf(fp, "\n]}\n");
+
+	if (fclose(fp)) {
+		return -1;
+	}
+
+	return count;
+}
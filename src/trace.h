@@ -0,0 +1,52 @@
+/*
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ 
+ See the GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ 
+ */
+
+#ifndef __TRACE_H
+#define __TRACE_H
+
+// The start of a span being timed. Span and mark names must be strings
+// that outlive the trace, since only the pointer is kept.
+typedef struct {
+	int active;
+	unsigned int start;     // microseconds
+	unsigned int nstart;    // nanoseconds, for the duration
+} TraceSpan;
+
+extern volatile int TRACE_Enabled;
+
+void TRACE_Start(void);
+void TRACE_Stop(void);
+int  TRACE_Write(const char * filename);
+
+void TRACE_Begin(TraceSpan * span);
+void TRACE_End(TraceSpan * span, const char * name, int arg);
+void TRACE_Mark(const char * name, int arg);
+
+// Costs one test when tracing is off.
+#define TRACE_BEGIN(span) \
+	do { \
+		(span).active = TRACE_Enabled; \
+		if ((span).active) TRACE_Begin(&(span)); \
+	} while (0)
+
+#define TRACE_END(span, name, arg) \
+	do { \
+		if ((span).active) TRACE_End(&(span), (name), (arg)); \
+	} while (0)
+
+#endif
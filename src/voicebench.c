@@ -0,0 +1,231 @@
+/*
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+ */
+
+/**
+ * Measures the cost of mixing as the number of playing voices grows
+ *
+ *   voicebench [-s seconds] [-r rate] [-o file.ogg] [-x maxvoices]
+ *
+ * The library is started on the NoSound driver and mixing is pulled
+ * with FX_Render, so no sound hardware is needed. For each voice count
+ * the voices are started looping with random pans and pitches, cycling
+ * through 8-bit and 16-bit WAV, VOC and raw sounds made here. Vorbis
+ * joins the cycle when a file is given with -o. The CSV printed gives
+ * the time spent per mix block and per second of audio.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "fx_man.h"
+#include "sndcards.h"
+#include "tools.h"
+
+#define BLOCKFRAMES 256     // one MultiVoc mix block at a time
+#define SOUNDFRAMES 11025
+
+enum {
+    SND_WAV8,
+    SND_WAV16,
+    SND_VOC,
+    SND_RAW,
+    SND_VORBIS,
+    SND_NUM
+};
+
+static char * Sounds[SND_NUM];
+static unsigned int SoundLengths[SND_NUM];
+
+
+static char * makewav(int bits, int channels, unsigned int rate, unsigned int * length)
+{
+    int framesize = channels * bits / 8;
+    unsigned int databytes = SOUNDFRAMES * framesize;
+    char * wav, * p;
+    int i, c, v;
+
+    wav = (char *) malloc(WAVHEADER_SIZE + databytes);
+    makewavheader(wav, rate, channels, bits, databytes);
+
+    p = wav + WAVHEADER_SIZE;
+    for (i = 0; i < SOUNDFRAMES; i++) {
+        for (c = 0; c < channels; c++) {
+            v = (int) (12000 * sin(i * (c + 1) * 2 * M_PI * 220 / rate));
+            if (bits == 16) {
+                write_le16(p, v);
+                p += 2;
+            } else {
+                *p++ = (char) ((v >> 8) + 128);
+            }
+        }
+    }
+
+    *length = WAVHEADER_SIZE + databytes;
+    return wav;
+}
+
+static char * makevoc(unsigned int rate, unsigned int * length)
+{
+    unsigned int blocklength = SOUNDFRAMES + 2;
+    char * voc;
+    int i;
+
+    voc = (char *) malloc(26 + 4 + blocklength + 1);
+    memcpy(voc, "Creative Voice File\x1a", 20);
+    write_le16(voc + 20, 26);
+    write_le16(voc + 22, 0x010a);
+    write_le16(voc + 24, ~0x010a + 0x1234);
+
+    voc[26] = 1;
+    voc[27] = blocklength;
+    voc[28] = blocklength >> 8;
+    voc[29] = blocklength >> 16;
+    voc[30] = (char) (256 - 1000000 / rate);
+    voc[31] = 0;
+    for (i = 0; i < SOUNDFRAMES; i++) {
+        voc[32 + i] = (char) (128 + 40 * sin(i * 2 * M_PI * 330 / rate));
+    }
+    voc[32 + SOUNDFRAMES] = 0;
+
+    *length = 26 + 4 + blocklength + 1;
+    return voc;
+}
+
+static char * makeraw(unsigned int * length)
+{
+    char * raw;
+    int i;
+
+    raw = (char *) malloc(SOUNDFRAMES);
+    for (i = 0; i < SOUNDFRAMES; i++) {
+        raw[i] = (char) (128 + 50 * sin(i * 2 * M_PI * 440 / 11025));
+    }
+
+    *length = SOUNDFRAMES;
+    return raw;
+}
+
+static int startvoice(int type)
+{
+    int pitch = rand() % 2401 - 1200;
+    int left = rand() % 256;
+    int right = rand() % 256;
+    char * p = Sounds[type];
+    unsigned int len = SoundLengths[type];
+
+    switch (type) {
+        case SND_WAV8:
+        case SND_WAV16:
+            return FX_PlayLoopedWAV(p, len, 0, -1, pitch, 255, left, right, 1, 0);
+        case SND_VOC:
+            return FX_PlayLoopedVOC(p, len, 0, SOUNDFRAMES - 1, pitch, 255, left, right, 1, 0);
+        case SND_RAW:
+            return FX_PlayLoopedRaw(p, len, p, p + len - 1, 11025, pitch, 255, left, right, 1, 0);
+        default:
+            return FX_PlayLoopedAuto(p, len, 0, -1, pitch, 255, left, right, 1, 0);
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    static const int counts[] = { 1, 2, 4, 8, 16, 32, 48, 64, 96, 128, 192, 256 };
+    int seconds = 5, rate = 44100, maxvoices = 256;
+    int channels = 2, bits = 16;
+    int numtypes = SND_VORBIS;
+    const char * oggfile = 0;
+    short buf[BLOCKFRAMES * 2];
+    int i, n, v, blocks, playing;
+    clock_t start;
+    double cpu;
+
+    for (i = 1; i < argc; i++) {
+        if (i + 1 < argc && !strcmp(argv[i], "-s")) {
+            seconds = atoi(argv[++i]);
+        } else if (i + 1 < argc && !strcmp(argv[i], "-r")) {
+            rate = atoi(argv[++i]);
+        } else if (i + 1 < argc && !strcmp(argv[i], "-o")) {
+            oggfile = argv[++i];
+        } else if (i + 1 < argc && !strcmp(argv[i], "-x")) {
+            maxvoices = atoi(argv[++i]);
+        } else {
+            seconds = 0;
+            break;
+        }
+    }
+
+    if (seconds < 1 || maxvoices < 1) {
+        fprintf(stderr, "usage: %s [-s seconds] [-r rate] [-o file.ogg] [-x maxvoices]\n", argv[0]);
+        return 1;
+    }
+
+    Sounds[SND_WAV8] = makewav(8, 1, 11025, &SoundLengths[SND_WAV8]);
+    Sounds[SND_WAV16] = makewav(16, 2, 22050, &SoundLengths[SND_WAV16]);
+    Sounds[SND_VOC] = makevoc(11111, &SoundLengths[SND_VOC]);
+    Sounds[SND_RAW] = makeraw(&SoundLengths[SND_RAW]);
+    if (oggfile) {
+        Sounds[SND_VORBIS] = loadfile(oggfile, &SoundLengths[SND_VORBIS]);
+        if (!Sounds[SND_VORBIS]) {
+            fprintf(stderr, "%s: could not read\n", oggfile);
+            return 1;
+        }
+        numtypes = SND_NUM;
+    }
+
+    if (FX_Init(ASS_NoSound, maxvoices, &channels, &bits, &rate, 0) != FX_Ok) {
+        fprintf(stderr, "FX_Init failed: %s\n", FX_ErrorString(FX_Error));
+        return 1;
+    }
+
+    srand(1);
+    printf("voices,still_playing,us_per_block,cpu_ms_per_audio_sec,load_percent\n");
+
+    for (i = 0; i < (int) (sizeof(counts) / sizeof(counts[0])) && counts[i] <= maxvoices; i++) {
+        n = counts[i];
+
+        FX_StopAllSounds();
+        for (v = 0; v < n; v++) {
+            startvoice(v % numtypes);
+        }
+
+        // settle the voices in before timing
+        for (blocks = 0; blocks < 16; blocks++) {
+            FX_Render(buf, BLOCKFRAMES, channels, bits);
+        }
+
+        blocks = seconds * rate / BLOCKFRAMES;
+        start = clock();
+        for (v = 0; v < blocks; v++) {
+            FX_Render(buf, BLOCKFRAMES, channels, bits);
+        }
+        cpu = (double) (clock() - start) / CLOCKS_PER_SEC;
+        playing = FX_SoundsPlaying();
+
+        printf("%d,%d,%.2f,%.3f,%.2f\n", n, playing,
+               cpu * 1e6 / blocks,
+               cpu * 1e3 * rate / ((double) blocks * BLOCKFRAMES),
+               cpu * 100 * rate / ((double) blocks * BLOCKFRAMES));
+        fflush(stdout);
+    }
+
+    FX_Shutdown();
+
+    return 0;
+}
@@ -36,6 +36,8 @@
 #include <unistd.h>
 #include <errno.h>
 #include "pitch.h"
+#include "asssys.h"
+#include "trace.h"
 #include "multivoc.h"
 #include "_multivc.h"
 
@@ -43,17 +45,43 @@
 #define max(x,y) ((x) > (y) ? (x) : (y))
 
 
+#define MaxVorbisIndexes 16
+
+typedef struct {
+   ogg_int64_t granulepos;    // PCM position at the end of the page
+   unsigned int offset;       // byte offset of the start of the page
+} vorbis_seekpoint;
+
+typedef struct vorbis_index {
+   struct vorbis_index * next;
+   const char * ptr;
+   size_t length;
+   unsigned int serialno;
+   int refcount;
+   int cached;
+   int numpoints;
+   vorbis_seekpoint * points;
+} vorbis_index;
+
 typedef struct {
    void * ptr;
    size_t length;
    size_t pos;
    
    OggVorbis_File vf;
+   vorbis_index * index;
+   
+   ogg_int64_t loopstart;
+   ogg_int64_t loopend;
+   ogg_int64_t seekto;
    
    char block[0x8000];
    int lastbitstream;
 } vorbis_data;
 
+static vorbis_index * vorbis_indexes = 0;
+static int vorbis_numindexes = 0;
+
 static size_t read_vorbis(void * ptr, size_t size, size_t nmemb, void * datasource)
 {
    vorbis_data * vorb = (vorbis_data *) datasource;
@@ -125,6 +153,291 @@ static ov_callbacks vorbis_callbacks = {
 };
 
 
+/*---------------------------------------------------------------------
+Function: MV_BuildVorbisIndex
+
+Walks the Ogg pages of a single-stream file held in memory, recording
+the byte offset and ending granule position of every page that
+completes an audio packet.
+---------------------------------------------------------------------*/
+
+static vorbis_index * MV_BuildVorbisIndex
+(
+ const char *ptr,
+ size_t length
+ )
+
+{
+   const unsigned char * p = (const unsigned char *) ptr;
+   vorbis_index * index;
+   size_t offset = 0, pagelength;
+   ogg_int64_t granulepos;
+   int allocated = 0, segments, i;
+
+   index = (vorbis_index *) ASS_Alloc( ASS_MemVorbis, sizeof(vorbis_index) );
+   if (!index) {
+      return 0;
+   }
+   memset(index, 0, sizeof(vorbis_index));
+   index->ptr = ptr;
+   index->length = length;
+   index->refcount = 1;
+
+   while (offset + 27 <= length) {
+      if (memcmp(p + offset, "OggS", 4) != 0) {
+         break;
+      }
+
+      segments = p[offset + 26];
+      if (offset + 27 + segments > length) {
+         break;
+      }
+
+      pagelength = 27 + segments;
+      for (i = 0; i < segments; i++) {
+         pagelength += p[offset + 27 + i];
+      }
+      if (offset + pagelength > length) {
+         break;
+      }
+
+      if (offset == 0) {
+         index->serialno = read_le32(p + offset + 14);
+      } else if (read_le32(p + offset + 14) != index->serialno) {
+         break;
+      }
+
+      granulepos = (ogg_int64_t) read_le32(p + offset + 6) |
+                   ((ogg_int64_t) read_le32(p + offset + 10) << 32);
+
+      if (granulepos != -1 && (index->numpoints > 0 || granulepos > 0)) {
+         if (index->numpoints == allocated) {
+            vorbis_seekpoint * points;
+
+            allocated = allocated ? allocated * 2 : 256;
+            points = (vorbis_seekpoint *) ASS_Realloc(ASS_MemVorbis, index->points,
+                                                      allocated * sizeof(vorbis_seekpoint));
+            if (!points) {
+               break;
+            }
+            index->points = points;
+         }
+
+         index->points[index->numpoints].granulepos = granulepos;
+         index->points[index->numpoints].offset = (unsigned int) offset;
+         index->numpoints++;
+      }
+
+      offset += pagelength;
+   }
+
+   return index;
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_ReleaseVorbisIndex
+
+Drops a voice's reference to a seek index.  Must be called with the
+MultiVoc lock held.
+---------------------------------------------------------------------*/
+
+static void MV_ReleaseVorbisIndex
+(
+ vorbis_index * index
+ )
+
+{
+   if (!index || --index->refcount > 0 || index->cached) {
+      return;
+   }
+
+   ASS_Free(index->points);
+   ASS_Free(index);
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_GetVorbisIndex
+
+Returns the seek index for the given file, building it the first
+time the file is played.  Indexes are cached by buffer address,
+validated against the page headers, and evicted least recently used
+first once MaxVorbisIndexes are held.
+---------------------------------------------------------------------*/
+
+static vorbis_index * MV_GetVorbisIndex
+(
+ const char *ptr,
+ size_t length
+ )
+
+{
+   vorbis_index * index, * prev, * node, * victim, * victimprev;
+   const vorbis_seekpoint * last;
+
+   MV_Lock();
+
+   for (prev = 0, index = vorbis_indexes; index; prev = index, index = index->next) {
+      if (index->ptr != ptr || index->length != length) {
+         continue;
+      }
+
+      // Make sure the buffer still holds the file we indexed
+      last = index->numpoints ? &index->points[index->numpoints - 1] : 0;
+      if (memcmp(ptr, "OggS", 4) != 0 ||
+          read_le32((const unsigned char *) ptr + 14) != index->serialno ||
+          (last && (memcmp(ptr + last->offset, "OggS", 4) != 0 ||
+                    read_le32((const unsigned char *) ptr + last->offset + 6) !=
+                       (unsigned int) last->granulepos))) {
+         if (prev) {
+            prev->next = index->next;
+         } else {
+            vorbis_indexes = index->next;
+         }
+         vorbis_numindexes--;
+         index->cached = 0;
+         index->refcount++;
+         MV_ReleaseVorbisIndex(index);
+         break;
+      }
+
+      // Move to the front of the list
+      if (prev) {
+         prev->next = index->next;
+         index->next = vorbis_indexes;
+         vorbis_indexes = index;
+      }
+      index->refcount++;
+
+      MV_Unlock();
+      return index;
+   }
+
+   MV_Unlock();
+
+   index = MV_BuildVorbisIndex(ptr, length);
+   if (!index) {
+      return 0;
+   }
+
+   MV_Lock();
+
+   if (vorbis_numindexes >= MaxVorbisIndexes) {
+      // Evict the least recently used index no voice is referencing
+      victim = victimprev = 0;
+      for (prev = 0, node = vorbis_indexes; node; prev = node, node = node->next) {
+         if (node->refcount == 0) {
+            victim = node;
+            victimprev = prev;
+         }
+      }
+      if (victim) {
+         if (victimprev) {
+            victimprev->next = victim->next;
+         } else {
+            vorbis_indexes = victim->next;
+         }
+         vorbis_numindexes--;
+         victim->cached = 0;
+         victim->refcount++;
+         MV_ReleaseVorbisIndex(victim);
+      }
+   }
+
+   index->next = 0;
+   if (vorbis_numindexes < MaxVorbisIndexes) {
+      index->next = vorbis_indexes;
+      index->cached = 1;
+      vorbis_indexes = index;
+      vorbis_numindexes++;
+   }
+
+   MV_Unlock();
+
+   return index;
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_SeekVorbis
+
+Positions the decoder so the next sample read is the given PCM
+position.  With an index this is one raw seek to the page ending
+before the target plus decoding at most a page of discarded audio,
+rather than a bisection of the whole file.
+---------------------------------------------------------------------*/
+
+static int MV_SeekVorbis
+(
+ vorbis_data * vd,
+ ogg_int64_t pos
+ )
+
+{
+   vorbis_index * index = vd->index;
+   ogg_int64_t current;
+   int lo, hi, mid;
+   int bitstream, framesize, bytes, err;
+   vorbis_info * vi;
+
+   if (!index || index->numpoints == 0) {
+      return ov_pcm_seek(&vd->vf, pos);
+   }
+
+   // Find the last page ending before the target
+   lo = 0;
+   hi = index->numpoints - 1;
+   if (index->points[0].granulepos >= pos) {
+      hi = 0;
+   } else {
+      while (lo < hi) {
+         mid = (lo + hi + 1) >> 1;
+         if (index->points[mid].granulepos < pos) {
+            lo = mid;
+         } else {
+            hi = mid - 1;
+         }
+      }
+   }
+
+   err = ov_raw_seek(&vd->vf, index->points[hi].offset);
+   if (err != 0) {
+      return err;
+   }
+
+   vi = ov_info(&vd->vf, -1);
+   if (!vi) {
+      return OV_EINVAL;
+   }
+   framesize = 2 * vi->channels;
+
+   current = ov_pcm_tell(&vd->vf);
+   if (current > pos) {
+      return ov_pcm_seek(&vd->vf, pos);
+   }
+
+   // Decode up to the exact sample
+   while (current < pos) {
+      bytes = sizeof(vd->block);
+      if ((pos - current) * framesize < bytes) {
+         bytes = (int) (pos - current) * framesize;
+      }
+
+      bytes = ov_read(&vd->vf, vd->block, bytes, 0, 2, 1, &bitstream);
+      if (bytes == OV_HOLE) {
+         continue;
+      } else if (bytes <= 0) {
+         return bytes ? bytes : OV_EINVAL;
+      }
+
+      current = ov_pcm_tell(&vd->vf);
+   }
+
+   return 0;
+}
+
+
 /*---------------------------------------------------------------------
 Function: MV_GetNextVorbisBlock
 
@@ -140,22 +453,50 @@ static playbackstatus MV_GetNextVorbisBlock
    vorbis_data * vd = (vorbis_data *) voice->extra;
    int bytes = 0, bytesread = 0;
    int bitstream = 0, err = 0;
+   int framesize, looped = FALSE;
+   ogg_int64_t remaining;
+   TraceSpan span;
 
    voice->Playing = TRUE;
    
+   if (vd->seekto >= 0) {
+      err = MV_SeekVorbis(vd, vd->seekto);
+      if (err != 0) {
+         fprintf(stderr, "MV_GetNextVorbisBlock seek: err %d\n", err);
+      }
+      vd->seekto = -1;
+   }
+
+   framesize = 2 * voice->channels;
+
+   TRACE_BEGIN(span);
    bytesread = 0;
    do {
-      bytes = ov_read(&vd->vf, vd->block + bytesread, sizeof(vd->block) - bytesread, 0, 2, 1, &bitstream);
+      bytes = sizeof(vd->block) - bytesread;
+      if (voice->LoopStart && vd->loopend > 0) {
+         remaining = vd->loopend - ov_pcm_tell(&vd->vf);
+         if (remaining <= 0) {
+            bytes = 0;
+         } else if (remaining * framesize < bytes) {
+            bytes = (int) remaining * framesize;
+         }
+      }
+
+      if (bytes > 0) {
+         bytes = ov_read(&vd->vf, vd->block + bytesread, bytes, 0, 2, 1, &bitstream);
+      }
       //fprintf(stderr, "ov_read = %d\n", bytes);
       if (bytes == OV_HOLE) continue;
       if (bytes == 0) {
-         if (voice->LoopStart) {
-            err = ov_pcm_seek_page(&vd->vf, 0);
+         if (voice->LoopStart && !looped) {
+            err = MV_SeekVorbis(vd, vd->loopstart);
             if (err != 0) {
-               fprintf(stderr, "MV_GetNextVorbisBlock ov_pcm_seek_page_lap: err %d\n", err);
-            } else {
-               continue;
+               fprintf(stderr, "MV_GetNextVorbisBlock seek: err %d\n", err);
+               break;
             }
+            // Don't spin if the loop produces no audio
+            looped = TRUE;
+            continue;
          } else {
            break;
          }
@@ -166,7 +507,9 @@ static playbackstatus MV_GetNextVorbisBlock
       }
 
       bytesread += bytes;
+      looped = FALSE;
    } while (bytesread < sizeof(vd->block));
+   TRACE_END(span, "Vorbis decode", voice->handle);
 
    if (bytesread == 0) {
       voice->Playing = FALSE;
@@ -189,9 +532,7 @@ static playbackstatus MV_GetNextVorbisBlock
       
       voice->channels = vi->channels;
       voice->SamplingRate = vi->rate;
-      voice->RateScale    = ( voice->SamplingRate * voice->PitchScale ) / MV_MixRate;
-      voice->FixedPointBufferSize = ( voice->RateScale * MixBufferSize ) -
-         voice->RateScale;
+      voice->RateScale    = RATE_SCALE( voice->SamplingRate, voice->PitchScale );
       MV_SetVoiceMixMode( voice );
    }
    vd->lastbitstream = bitstream;
@@ -201,7 +542,7 @@ static playbackstatus MV_GetNextVorbisBlock
    voice->position    = 0;
    voice->sound       = vd->block;
    voice->BlockLength = 0;
-   voice->length      = bytesread << 16;
+   voice->length      = (uint64_t) bytesread << 32;
    
    return( KeepPlaying );
 }
@@ -310,11 +651,45 @@ int MV_PlayLoopedVorbis
  unsigned int callbackval
  )
 
+{
+   int status;
+   
+   status = MV_PlayLoopedVorbisFrom( ptr, ptrlength, 0, loopstart, loopend, pitchoffset,
+                                     vol, left, right, priority, callbackval );
+   
+   return( status );
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_PlayLoopedVorbisFrom
+
+Begin playback of sound data at the given sample position.  A
+loopstart of zero or more loops back to that sample on reaching
+loopend, or the end of the file if loopend is not past loopstart.
+---------------------------------------------------------------------*/
+
+int MV_PlayLoopedVorbisFrom
+(
+ char *ptr,
+ unsigned int ptrlength,
+ int   startpos,
+ int   loopstart,
+ int   loopend,
+ int   pitchoffset,
+ int   vol,
+ int   left,
+ int   right,
+ int   priority,
+ unsigned int callbackval
+ )
+
 {
    VoiceNode   *voice;
    int          status;
    vorbis_data * vd = 0;
    vorbis_info * vi = 0;
+   ogg_int64_t  total;
    
    if ( !MV_Installed )
    {
@@ -322,7 +697,7 @@ int MV_PlayLoopedVorbis
       return( MV_Error );
    }
    
-   vd = (vorbis_data *) malloc( sizeof(vorbis_data) );
+   vd = (vorbis_data *) ASS_Alloc( ASS_MemVorbis, sizeof(vorbis_data) );
    if (!vd) {
       MV_SetErrorCode( MV_InvalidVorbisFile );
       return MV_Error;
@@ -337,6 +712,7 @@ int MV_PlayLoopedVorbis
    status = ov_open_callbacks((void *) vd, &vd->vf, 0, 0, vorbis_callbacks);
    if (status < 0) {
       fprintf(stderr, "MV_PlayLoopedVorbis: err %d\n", status);
+      ASS_Free(vd);
       MV_SetErrorCode( MV_InvalidVorbisFile );
       return MV_Error;
    }
@@ -344,24 +720,37 @@ int MV_PlayLoopedVorbis
    vi = ov_info(&vd->vf, 0);
    if (!vi) {
       ov_clear(&vd->vf);
-      free(vd);
+      ASS_Free(vd);
       MV_SetErrorCode( MV_InvalidVorbisFile );
       return MV_Error;
    }
    
    if (vi->channels != 1 && vi->channels != 2) {
       ov_clear(&vd->vf);
-      free(vd);
+      ASS_Free(vd);
       MV_SetErrorCode( MV_InvalidVorbisFile );
       return MV_Error;
    }
    
+   // Chained files are left to libvorbisfile to seek
+   if (ov_streams(&vd->vf) == 1) {
+      vd->index = MV_GetVorbisIndex(ptr, ptrlength);
+   }
+
+   total = ov_pcm_total(&vd->vf, -1);
+   vd->loopstart = (loopstart > 0 && loopstart < total) ? loopstart : 0;
+   vd->loopend   = (loopend > vd->loopstart && loopend < total) ? loopend : 0;
+   vd->seekto    = (startpos > 0 && startpos < total) ? startpos : -1;
+   
    // Request a voice from the voice pool
    voice = MV_AllocVoice( priority );
    if ( voice == NULL )
    {
+      MV_Lock();
+      MV_ReleaseVorbisIndex(vd->index);
+      MV_Unlock();
       ov_clear(&vd->vf);
-      free(vd);
+      ASS_Free(vd);
       MV_SetErrorCode( MV_NoVoices );
       return( MV_Error );
    }
@@ -388,9 +777,7 @@ int MV_PlayLoopedVorbis
    voice->Paused      = FALSE;
    
    voice->SamplingRate = vi->rate;
-   voice->RateScale    = ( voice->SamplingRate * voice->PitchScale ) / MV_MixRate;
-   voice->FixedPointBufferSize = ( voice->RateScale * MixBufferSize ) -
-      voice->RateScale;
+   voice->RateScale    = RATE_SCALE( voice->SamplingRate, voice->PitchScale );
    MV_SetVoiceMixMode( voice );
 
    MV_SetVoiceVolume( voice, vol, left, right );
@@ -400,18 +787,107 @@ int MV_PlayLoopedVorbis
 }
 
 
+/*---------------------------------------------------------------------
+Function: MV_SetVorbisPosition
+
+Moves playback of the voice associated with the specified handle to
+the given sample position.
+---------------------------------------------------------------------*/
+
+int MV_SetVorbisPosition
+(
+ int handle,
+ int position
+ )
+
+{
+   VoiceNode * voice;
+   vorbis_data * vd;
+   
+   if ( !MV_Installed )
+   {
+      MV_SetErrorCode( MV_NotInstalled );
+      return( MV_Error );
+   }
+   
+   MV_Lock();
+   
+   voice = MV_GetVoice( handle );
+   if ( voice == NULL || voice->wavetype != Vorbis )
+   {
+      MV_Unlock();
+      MV_SetErrorCode( MV_VoiceNotFound );
+      return( MV_Error );
+   }
+   
+   vd = (vorbis_data *) voice->extra;
+   vd->seekto = max(0, position);
+   
+   // Discard the rest of the decoded block, and what the resampler
+   // kept of the last one
+   voice->position = 0;
+   voice->length   = 0;
+   voice->carry    = 0;
+   voice->historychannels = 0;
+   
+   MV_Unlock();
+   
+   return( MV_Ok );
+}
+
+
+/*---------------------------------------------------------------------
+Function: MV_ReleaseVorbisVoice
+
+Frees the decoder of a stopped voice.  Must be called with the
+MultiVoc lock held.
+---------------------------------------------------------------------*/
+
 void MV_ReleaseVorbisVoice( VoiceNode * voice )
 {
    vorbis_data * vd = (vorbis_data *) voice->extra;
    
-   if (voice->wavetype != Vorbis) {
+   if (voice->wavetype != Vorbis || !vd) {
       return;
    }
    
+   MV_ReleaseVorbisIndex(vd->index);
+   
    ov_clear(&vd->vf);
-   free(vd);
+   ASS_Free(vd);
    
    voice->extra = 0;
 }
 
+
+/*---------------------------------------------------------------------
+Function: MV_FlushVorbisIndexes
+
+Frees the cached seek indexes no voice is referencing. Only to be
+called once playback has stopped.
+---------------------------------------------------------------------*/
+
+void MV_FlushVorbisIndexes( void )
+{
+   vorbis_index * index, * prev, * next;
+   
+   for (prev = 0, index = vorbis_indexes; index; index = next) {
+      next = index->next;
+      if (index->refcount > 0) {
+         prev = index;
+         continue;
+      }
+      
+      if (prev) {
+         prev->next = next;
+      } else {
+         vorbis_indexes = next;
+      }
+      vorbis_numindexes--;
+      index->cached = 0;
+      index->refcount++;
+      MV_ReleaseVorbisIndex(index);
+   }
+}
+
 #endif //HAVE_VORBIS